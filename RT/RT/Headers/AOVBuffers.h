@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+
+#include "Texture2D.h"
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //Extra per-pixel information about the surfaces an image sees ("arbitrary output variables"),
+    //    for compositing and denoising.
+    //Filled in during the same pass as the image itself, from each camera ray's first hit.
+    class RT_API AOVBuffers
+    {
+    public:
+
+        //The object index of pixels that didn't see any object.
+        static const int NoObject = -1;
+
+        struct Pixel
+        {
+            //The color of the surface, averaged over the pixel's samples.
+            //Samples that hit the sky use the sky's color.
+            Vector3f Albedo;
+            //The surface normal, averaged over the pixel's samples.
+            //It isn't renormalized, so it's shorter along edges; samples that hit the sky count as zero.
+            Vector3f Normal;
+            //The distance from the camera to the surface seen by the pixel's first sample,
+            //    or infinity if it hit the sky.
+            float Depth = std::numeric_limits<float>::infinity();
+            //The index in "Tracer::Objects" of the object seen by the pixel's first sample, or "NoObject".
+            int ObjectIndex = NoObject;
+        };
+
+
+        AOVBuffers(size_t width = 0, size_t height = 0) { Resize(width, height); }
+
+
+        size_t GetWidth() const { return width; }
+        size_t GetHeight() const { return height; }
+
+        //Changes the size of these buffers and resets every pixel.
+        void Resize(size_t newWidth, size_t newHeight);
+
+        const Pixel& Get(size_t x, size_t y) const { return pixels[x + (y * width)]; }
+        Pixel& Get(size_t x, size_t y) { return pixels[x + (y * width)]; }
+
+        //The below functions write one of the buffers into the given texture, which must be the same size,
+        //    as colors that can be looked at or saved.
+        void CopyAlbedoTo(Texture2D& outTex) const;
+        //Normals are mapped from [-1, 1] to [0, 1].
+        void CopyNormalsTo(Texture2D& outTex) const;
+        //Depths are mapped so that the median depth is middle gray, and farther surfaces approach white.
+        //The sky is white.
+        void CopyDepthTo(Texture2D& outTex) const;
+        //Each object gets an arbitrary color of its own. Pixels that didn't see an object are black.
+        void CopyObjectIndicesTo(Texture2D& outTex) const;
+
+
+    private:
+
+        size_t width = 0, height = 0;
+        std::vector<Pixel> pixels;
+    };
+}
+
+#pragma warning(default: 4251)
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "BVHTree.h"
+#include "RTString.h"
+
+
+namespace RT
+{
+    //Saves built BVHs to files, so that geometry that hasn't changed since the last run
+    //    doesn't need its BVH rebuilt.
+    //Each BVH is identified by a hash of the data it was built from.
+    namespace BVHCache
+    {
+        //Builds up a 64-bit hash of some data, one piece at a time.
+        struct RT_API Hasher
+        {
+        public:
+
+            unsigned long long Value;
+
+            Hasher(unsigned long long seed = 0) : Value(seed ^ 0x9E3779B97F4A7C15ULL) { }
+
+            void AddBytes(const void* data, size_t nBytes);
+
+            template<typename T>
+            void Add(const T& value) { AddBytes(&value, sizeof(T)); }
+        };
+
+
+        //Sets the folder that cached BVH files are kept in. The folder must already exist.
+        //If set to the empty string (the default), nothing is ever loaded from or saved to the cache.
+        //Not thread-safe; call this before doing any precalculation.
+        void RT_API SetFolder(const String& folderPath);
+        const String& RT_API GetFolder();
+
+        //Tries to load a BVH with the given category and hash from the cache folder.
+        //"nPrims" is the number of primitives the BVH should contain.
+        //Returns whether it was found.
+        bool RT_API TryLoad(const String& category, unsigned long long hash, size_t nPrims,
+                            BVHTree& outTree);
+        //Saves the given BVH into the cache folder.
+        //Failures are ignored, since the BVH can always be rebuilt.
+        void RT_API Save(const String& category, unsigned long long hash, const BVHTree& tree);
+    }
+}
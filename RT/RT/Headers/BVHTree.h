@@ -0,0 +1,231 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <assert.h>
+
+#include "BoundingBox.h"
+#include "ThreadPool.h"
+#include "WideBVH.h"
+#include "CompressedBVH.h"
+
+
+//The number of children each node has when casting rays: 2, 4, or 8.
+//Trees are always built as binary trees; wider trees are collapsed from them afterwards.
+#ifndef RT_BVH_WIDTH
+    #define RT_BVH_WIDTH 4
+#endif
+//If 1, rays are cast through 4-wide nodes with quantized bounds instead, and "RT_BVH_WIDTH" is ignored.
+//This uses much less memory, which helps with very large scenes.
+#ifndef RT_BVH_COMPRESSED
+    #define RT_BVH_COMPRESSED 0
+#endif
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A bounding volume hierarchy over a set of primitives (triangles, shapes, etc).
+    //Only stores the indices of the primitives; the owner of this tree does the actual intersection tests.
+    class RT_API BVHTree
+    {
+    public:
+
+        struct Node
+        {
+            BoundingBox Bounds;
+
+            //If this is a leaf node, this is the index of its first primitive in "primIndices".
+            //Otherwise, this is the index of its first child node;
+            //    the second child node comes right after it.
+            unsigned int Offset;
+            //The number of primitives in this node. 0 if this node isn't a leaf.
+            unsigned int NPrims;
+
+            bool IsLeaf() const { return NPrims > 0; }
+        };
+
+
+        //Leaves with at most this many primitives may be made
+        //    when it's cheaper than splitting them further.
+        static const unsigned int MaxLeafPrims = 4;
+        //The deepest that a tree can get. Limits the size of the stack used when casting rays.
+        static const unsigned int MaxDepth = 96;
+
+
+        //Builds this tree from scratch, using the binned surface area heuristic.
+        //Large trees are built in parallel on the given thread pool.
+        void Build(const BoundingBox* primBounds, size_t nPrims,
+                   ThreadPool& pool = ThreadPool::GetGlobal());
+
+        //Gets the bounds of the part of a primitive that's between "min" and "max" along the given axis (0-2).
+        using PrimClipper = std::function<BoundingBox(unsigned int primIndex, int axis, float min, float max)>;
+        //Builds this tree from scratch like "Build()", but also considers splitting space itself,
+        //    which puts primitives that cross the split plane into both children with clipped bounds.
+        //This makes much tighter trees for long, thin primitives that would otherwise overlap each other's nodes,
+        //    at the cost of a primitive's index appearing in more than one leaf.
+        //"maxDuplication" caps the number of extra primitive references, as a fraction of "nPrims".
+        //Unlike "Build()", this runs on a single thread.
+        void BuildSpatial(const BoundingBox* primBounds, size_t nPrims, const PrimClipper& clipPrim,
+                          float maxDuplication = 0.5f);
+
+        //Recalculates every node's bounds after the primitives have moved, without changing the tree's structure.
+        //The number of primitives must be the same as when the tree was built.
+        //This is much faster than rebuilding, but the tree gets less efficient as primitives move farther.
+        void Refit(const BoundingBox* primBounds, ThreadPool& pool = ThreadPool::GetGlobal());
+        //Refits this tree to the given primitives if possible, or rebuilds it if the number of primitives changed
+        //    or refitting would make the tree's SAH cost more than "maxCostIncrease" times its cost when built.
+        //Returns whether the tree was rebuilt.
+        bool Update(const BoundingBox* primBounds, size_t nPrims,
+                    ThreadPool& pool = ThreadPool::GetGlobal(),
+                    float maxCostIncrease = 1.5f);
+
+        //Gets the expected cost of casting a ray through this tree, according to the surface area heuristic.
+        //Measured in primitive intersection tests; a traversal step is assumed to cost the same as one test.
+        float GetSAHCost() const;
+        //Gets whether this tree's SAH cost has grown to more than "maxCostIncrease" times its cost when built,
+        //    e.x. from being refit.
+        bool HasDegraded(float maxCostIncrease = 1.5f) const { return GetSAHCost() > builtCost * maxCostIncrease; }
+
+        //Gets the number of primitives this tree was built from.
+        //If it was built with spatial splits, there may be more primitive indices than this.
+        size_t GetNPrims() const { return nBuiltPrims; }
+
+        bool IsEmpty() const { return nodes.empty(); }
+        //Gets the bounds of every primitive in this tree.
+        const BoundingBox& GetBounds() const { return nodes[0].Bounds; }
+
+        const std::vector<Node>& GetNodes() const { return nodes; }
+        const std::vector<unsigned int>& GetPrimIndices() const { return primIndices; }
+
+        //Replaces this tree's data with the given nodes and primitive indices, e.x. from a file.
+        //Children must come after their parents in the node list.
+        //"newNPrims" is the number of primitives the tree was built from.
+        //If the data isn't a valid tree, returns false and leaves this tree unchanged.
+        bool SetData(std::vector<Node>&& newNodes, std::vector<unsigned int>&& newPrimIndices,
+                     size_t newNPrims);
+
+
+        //Finds every primitive whose bounds the given ray passes through within [tMin, tMax],
+        //    roughly in order from nearest to farthest.
+        //For each one, calls "testPrim(unsigned int primIndex, float& tMax)",
+        //    which should return whether the primitive was hit.
+        //When a primitive is hit, "testPrim" should shrink "tMax" to the hit distance
+        //    so that farther-away nodes get skipped.
+        //Returns whether any primitive was hit.
+        //Uses the node layout chosen by "RT_BVH_WIDTH" and "RT_BVH_COMPRESSED".
+        template<typename PrimTester>
+        bool CastRay(const Ray& ray, float tMin, float tMax, PrimTester testPrim) const
+        {
+#if RT_BVH_COMPRESSED
+            return compressedTree.CastRay(ray, tMin, tMax, primIndices.data(), testPrim);
+#elif RT_BVH_WIDTH == 2
+            return CastRayBinary(ray, tMin, tMax, testPrim);
+#else
+            return wideTree.CastRay(ray, tMin, tMax, primIndices.data(), testPrim);
+#endif
+        }
+
+        //The same as "CastRay()", but always goes through the binary nodes.
+        //If "outNBoxTests" isn't null, the number of node bounds the ray was tested against is added to it.
+        template<typename PrimTester>
+        bool CastRayBinary(const Ray& ray, float tMin, float tMax, PrimTester testPrim,
+                           size_t* outNBoxTests = nullptr) const
+        {
+            if (nodes.empty())
+                return false;
+
+            Vector3f rayPos = ray.GetPos(),
+                     invRayDir = ray.GetDir().Reciprocal();
+
+            //Nodes that still need to be checked, along with the distance where the ray enters them.
+            struct StackEntry { unsigned int Node; float TEnter; };
+            StackEntry stack[MaxDepth + 1];
+            size_t stackSize = 0;
+
+            if (outNBoxTests != nullptr)
+                *outNBoxTests += 1;
+            float tEnter;
+            if (!nodes[0].Bounds.RayIntersects(rayPos, invRayDir, tMin, tMax, tEnter))
+                return false;
+            stack[stackSize++] = { 0, tEnter };
+
+            bool hitAnything = false;
+            while (stackSize > 0)
+            {
+                StackEntry entry = stack[--stackSize];
+
+                //If something closer was hit since this node was found, skip it.
+                if (entry.TEnter > tMax)
+                    continue;
+
+                const Node& node = nodes[entry.Node];
+                if (node.IsLeaf())
+                {
+                    for (unsigned int i = 0; i < node.NPrims; ++i)
+                        if (testPrim(primIndices[node.Offset + i], tMax))
+                            hitAnything = true;
+                }
+                else
+                {
+                    if (outNBoxTests != nullptr)
+                        *outNBoxTests += 2;
+
+                    float tEnter1, tEnter2;
+                    bool hit1 = nodes[node.Offset].Bounds.RayIntersects(rayPos, invRayDir,
+                                                                        tMin, tMax, tEnter1),
+                         hit2 = nodes[node.Offset + 1].Bounds.RayIntersects(rayPos, invRayDir,
+                                                                            tMin, tMax, tEnter2);
+
+                    //Push the farther child first so that the nearer one gets checked first.
+                    if (hit1 && hit2)
+                    {
+                        assert(stackSize + 2 <= MaxDepth + 1);
+                        if (tEnter1 <= tEnter2)
+                        {
+                            stack[stackSize++] = { node.Offset + 1, tEnter2 };
+                            stack[stackSize++] = { node.Offset, tEnter1 };
+                        }
+                        else
+                        {
+                            stack[stackSize++] = { node.Offset, tEnter1 };
+                            stack[stackSize++] = { node.Offset + 1, tEnter2 };
+                        }
+                    }
+                    else if (hit1)
+                    {
+                        stack[stackSize++] = { node.Offset, tEnter1 };
+                    }
+                    else if (hit2)
+                    {
+                        stack[stackSize++] = { node.Offset + 1, tEnter2 };
+                    }
+                }
+            }
+
+            return hitAnything;
+        }
+
+
+    private:
+
+        std::vector<Node> nodes;
+        std::vector<unsigned int> primIndices;
+        size_t nBuiltPrims = 0;
+
+        //The SAH cost of this tree when it was last built.
+        float builtCost = 0.0f;
+
+#if RT_BVH_COMPRESSED
+        CompressedBVH<MaxDepth> compressedTree;
+#elif RT_BVH_WIDTH != 2
+        WideBVH<RT_BVH_WIDTH, MaxDepth> wideTree;
+#endif
+
+        //Rebuilds the wide or compressed version of this tree after the binary nodes changed.
+        void UpdateWideTree();
+    };
+}
+
+#pragma warning(default: 4251)
@@ -7,6 +7,9 @@
 
 namespace RT
 {
+    struct Transform;
+
+
     struct RT_API BoundingBox
     {
     public:
@@ -16,8 +19,72 @@ namespace RT
         BoundingBox() : Min(), Max() { }
         BoundingBox(const Vector3f& min, const Vector3f& max) : Min(min), Max(max) { }
 
+
+        //Gets a box that contains nothing, so that encapsulating anything into it yields that thing.
+        static BoundingBox Empty()
+        {
+            const float inf = std::numeric_limits<float>::infinity();
+            return BoundingBox(Vector3f(inf, inf, inf), Vector3f(-inf, -inf, -inf));
+        }
+
+
+        Vector3f GetCenter() const { return (Min + Max) * 0.5f; }
+        Vector3f GetSize() const { return Max - Min; }
+        //Returns 0 for an empty box.
+        float GetSurfaceArea() const
+        {
+            Vector3f size = GetSize();
+            if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+                return 0.0f;
+            return 2.0f * ((size.x * size.y) + (size.x * size.z) + (size.y * size.z));
+        }
+
+        //Gets a box containing this one after it's transformed from local to world space.
+        BoundingBox GetTransformed(const Transform& localToWorld) const;
+
+        //Grows this box to contain the given point.
+        void Encapsulate(const Vector3f& p) { Encapsulate(p, p); }
+        //Grows this box to contain the given box.
+        void Encapsulate(const BoundingBox& b) { Encapsulate(b.Min, b.Max); }
+
+
         bool RayIntersects(const Ray& ray,
                            float tMin = 0.0f,
                            float tMax = std::numeric_limits<float>::infinity()) const;
+
+        //A faster version of "RayIntersects()" for when the ray's inverse direction is already known.
+        //Outputs the "t" value where the ray enters this box (clamped to "tMin").
+        bool RayIntersects(const Vector3f& rayPos, const Vector3f& invRayDir,
+                           float tMin, float tMax, float& outTEnter) const
+        {
+            float tx1 = (Min.x - rayPos.x) * invRayDir.x,
+                  tx2 = (Max.x - rayPos.x) * invRayDir.x,
+                  ty1 = (Min.y - rayPos.y) * invRayDir.y,
+                  ty2 = (Max.y - rayPos.y) * invRayDir.y,
+                  tz1 = (Min.z - rayPos.z) * invRayDir.z,
+                  tz2 = (Max.z - rayPos.z) * invRayDir.z;
+
+            //If the ray starts right on a side of the box and runs parallel to it, some of these are NaN.
+            //The comparisons are ordered so that NaN values get ignored.
+            tMin = FastMax(FastMax(FastMax(tMin, FastMin(tx1, tx2)), FastMin(ty1, ty2)), FastMin(tz1, tz2));
+            tMax = FastMin(FastMin(FastMin(tMax, FastMax(tx1, tx2)), FastMax(ty1, ty2)), FastMax(tz1, tz2));
+
+            outTEnter = tMin;
+            return tMin <= tMax;
+        }
+
+
+    private:
+
+        //Simple min/max that the compiler can turn into single instructions.
+        //If "b" is NaN, "a" is returned.
+        static float FastMin(float a, float b) { return (b < a) ? b : a; }
+        static float FastMax(float a, float b) { return (b > a) ? b : a; }
+
+        void Encapsulate(const Vector3f& min, const Vector3f& max)
+        {
+            Min = Vector3f(FastMin(Min.x, min.x), FastMin(Min.y, min.y), FastMin(Min.z, min.z));
+            Max = Vector3f(FastMax(Max.x, max.x), FastMax(Max.y, max.y), FastMax(Max.z, max.z));
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,323 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <string.h>
+#include <assert.h>
+
+#include "WideBVH.h"
+
+#if RT_BVH_SIMD
+    #include <emmintrin.h>
+#endif
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A 4-wide BVH whose child bounds are quantized down to 8 bits per side, relative to their parent's bounds.
+    //Each node fits in exactly one 64-byte cache line, so much more of the tree stays in the cache
+    //    than with full-precision bounds. The cost is a little extra math to decode the bounds,
+    //    and slightly looser boxes (they're always rounded outwards, so nothing is ever missed).
+    //"MaxDepth" is the deepest the binary BVH can get, which limits the size of the stack used when casting rays.
+    template<unsigned int MaxDepth>
+    class CompressedBVH
+    {
+    public:
+
+        static const unsigned int Width = 4;
+
+        struct alignas(64) Node
+        {
+            //Child bounds are decoded as "Origin + (q * 2^Exponent)" along each axis.
+            float Origin[3];
+            signed char Exponent[3];
+
+            unsigned char NChildren;
+
+            unsigned char MinX[Width], MinY[Width], MinZ[Width],
+                          MaxX[Width], MaxY[Width], MaxZ[Width];
+
+            //For a leaf child, this is the index of its first primitive index.
+            //Otherwise, this is the index of the child's node.
+            unsigned int Child[Width];
+            //The number of primitives in each child. 0 if the child isn't a leaf.
+            unsigned char NPrims[Width];
+
+
+            //Gets "2^Exponent" for the given axis.
+            float GetScale(int axis) const
+            {
+                //Build the float directly, since "ldexp()" is too slow to call during traversal.
+                unsigned int bits = (unsigned int)(Exponent[axis] + 127) << 23;
+                float scale;
+                memcpy(&scale, &bits, sizeof(float));
+                return scale;
+            }
+
+            //Gets the bounds of the given child, after they were quantized.
+            BoundingBox GetChildBounds(unsigned int i) const
+            {
+                float scaleX = GetScale(0),
+                      scaleY = GetScale(1),
+                      scaleZ = GetScale(2);
+                return BoundingBox(Vector3f(Origin[0] + ((float)MinX[i] * scaleX),
+                                            Origin[1] + ((float)MinY[i] * scaleY),
+                                            Origin[2] + ((float)MinZ[i] * scaleZ)),
+                                   Vector3f(Origin[0] + ((float)MaxX[i] * scaleX),
+                                            Origin[1] + ((float)MaxY[i] * scaleY),
+                                            Origin[2] + ((float)MaxZ[i] * scaleZ)));
+            }
+        };
+        static_assert(sizeof(Node) == 64, "Compressed BVH nodes should take up exactly one cache line");
+
+
+        CompressedBVH() { }
+        CompressedBVH(const CompressedBVH& cpy) { *this = cpy; }
+        CompressedBVH& operator=(const CompressedBVH& cpy)
+        {
+            SetNNodes(cpy.nNodes);
+            if (nNodes > 0)
+                memcpy(GetNodes(), cpy.GetNodes(), nNodes * sizeof(Node));
+            return *this;
+        }
+
+
+        //Quantizes the given 4-wide BVH into this tree.
+        void Build(const WideBVH<Width, MaxDepth>& wideTree)
+        {
+            const auto& wideNodes = wideTree.GetNodes();
+            SetNNodes(wideNodes.size());
+
+            Node* nodes = GetNodes();
+            for (size_t i = 0; i < wideNodes.size(); ++i)
+            {
+                const auto& wideNode = wideNodes[i];
+                Node& node = nodes[i];
+                memset(&node, 0, sizeof(Node));
+
+                node.NChildren = (unsigned char)wideNode.NChildren;
+                for (unsigned int j = 0; j < wideNode.NChildren; ++j)
+                {
+                    assert(wideNode.NPrims[j] <= 255);
+                    node.Child[j] = wideNode.Child[j];
+                    node.NPrims[j] = (unsigned char)wideNode.NPrims[j];
+                }
+
+                //Quantize each axis relative to the bounds of all the children.
+                QuantizeAxis(wideNode.MinX, wideNode.MaxX, wideNode.NChildren,
+                             node.Origin[0], node.Exponent[0], node.MinX, node.MaxX);
+                QuantizeAxis(wideNode.MinY, wideNode.MaxY, wideNode.NChildren,
+                             node.Origin[1], node.Exponent[1], node.MinY, node.MaxY);
+                QuantizeAxis(wideNode.MinZ, wideNode.MaxZ, wideNode.NChildren,
+                             node.Origin[2], node.Exponent[2], node.MinZ, node.MaxZ);
+            }
+        }
+
+        bool IsEmpty() const { return nNodes == 0; }
+        size_t GetNNodes() const { return nNodes; }
+        //The nodes are always aligned to a cache line.
+        const Node* GetNodes() const { return (const Node*)GetAlignedMemory(); }
+
+
+        //Finds every primitive whose bounds the given ray passes through within [tMin, tMax],
+        //    roughly in order from nearest to farthest.
+        //Works the same way as "BVHTree::CastRay()";
+        //    "primIndices" are the primitive indices of the binary tree this one was built from.
+        //If "outNBoxTests" isn't null, the number of child bounds the ray was tested against is added to it.
+        template<typename PrimTester>
+        bool CastRay(const Ray& ray, float tMin, float tMax,
+                     const unsigned int* primIndices, PrimTester testPrim,
+                     size_t* outNBoxTests = nullptr) const
+        {
+            if (nNodes == 0)
+                return false;
+
+            const Node* nodes = GetNodes();
+            Vector3f rayPos = ray.GetPos(),
+                     invRayDir = ray.GetDir().Reciprocal();
+
+            //Nodes and leaves that still need to be checked, along with the distance where the ray enters them.
+            //If "NPrims" is 0, "Index" is a node. Otherwise it's the start of a leaf's primitives.
+            struct StackEntry { unsigned int Index, NPrims; float TEnter; };
+            //Collapsing never makes the tree deeper, and each node adds at most "Width - 1" entries.
+            const size_t stackSize = MaxDepth * (Width - 1) + 2;
+            StackEntry stack[stackSize];
+            size_t stackCount = 0;
+            stack[stackCount++] = { 0, 0, tMin };
+
+            bool hitAnything = false;
+            while (stackCount > 0)
+            {
+                StackEntry entry = stack[--stackCount];
+
+                //If something closer was hit since this entry was found, skip it.
+                if (entry.TEnter > tMax)
+                    continue;
+
+                if (entry.NPrims > 0)
+                {
+                    for (unsigned int i = 0; i < entry.NPrims; ++i)
+                        if (testPrim(primIndices[entry.Index + i], tMax))
+                            hitAnything = true;
+                    continue;
+                }
+
+                const Node& node = nodes[entry.Index];
+                if (outNBoxTests != nullptr)
+                    *outNBoxTests += Width;
+
+                float tEnters[Width];
+                unsigned int hitMask = IntersectChildren(node, rayPos, invRayDir, tMin, tMax, tEnters);
+
+                //Sort the hit children from farthest to nearest,
+                //    so the nearest one ends up on top of the stack.
+                unsigned int sorted[Width];
+                unsigned int nSorted = 0;
+                for (unsigned int i = 0; i < node.NChildren; ++i)
+                {
+                    if ((hitMask & (1 << i)) == 0)
+                        continue;
+
+                    unsigned int j = nSorted++;
+                    for (; j > 0 && tEnters[sorted[j - 1]] < tEnters[i]; --j)
+                        sorted[j] = sorted[j - 1];
+                    sorted[j] = i;
+                }
+
+                assert(stackCount + nSorted <= stackSize);
+                for (unsigned int i = 0; i < nSorted; ++i)
+                {
+                    unsigned int child = sorted[i];
+                    stack[stackCount++] = { node.Child[child], node.NPrims[child], tEnters[child] };
+                }
+            }
+
+            return hitAnything;
+        }
+
+
+    private:
+
+        //The nodes live somewhere in this buffer, at the first address that's aligned to a cache line.
+        std::vector<unsigned char> nodeMemory;
+        size_t nNodes = 0;
+
+
+        const unsigned char* GetAlignedMemory() const
+        {
+            size_t address = (size_t)nodeMemory.data();
+            return nodeMemory.data() + (((64 - (address % 64)) % 64));
+        }
+        Node* GetNodes() { return (Node*)GetAlignedMemory(); }
+
+        void SetNNodes(size_t n)
+        {
+            nNodes = n;
+            nodeMemory.clear();
+            nodeMemory.shrink_to_fit();
+            if (n > 0)
+                nodeMemory.resize((n * sizeof(Node)) + 63);
+        }
+
+
+        //Picks an origin and power-of-two scale that fit the given children's bounds along one axis,
+        //    then quantizes their bounds. The quantized bounds always contain the original ones.
+        static void QuantizeAxis(const float* mins, const float* maxes, unsigned int nChildren,
+                                 float& outOrigin, signed char& outExponent,
+                                 unsigned char* outMins, unsigned char* outMaxes)
+        {
+            float min = mins[0],
+                  max = maxes[0];
+            for (unsigned int i = 1; i < nChildren; ++i)
+            {
+                min = (mins[i] < min ? mins[i] : min);
+                max = (maxes[i] > max ? maxes[i] : max);
+            }
+            outOrigin = min;
+
+            //Find the smallest scale that can reach the far side in 255 steps.
+            //Rounding error in the decoded bounds can make it fall just short, so keep growing it until it works.
+            int exponent = -126;
+            if (max > min)
+            {
+                int frexpExponent;
+                std::frexp((max - min) / 255.0f, &frexpExponent);
+                exponent = (frexpExponent < -126 ? -126 : frexpExponent);
+            }
+            while (exponent < 127 && min + (255.0f * std::ldexp(1.0f, exponent)) < max)
+                exponent += 1;
+            outExponent = (signed char)exponent;
+
+            float scale = std::ldexp(1.0f, exponent);
+            for (unsigned int i = 0; i < nChildren; ++i)
+            {
+                //Round outwards, then make sure the decoded value really is outside the original one.
+                float qMin = std::floor((mins[i] - min) / scale),
+                      qMax = std::ceil((maxes[i] - min) / scale);
+                qMin = (qMin < 0.0f ? 0.0f : (qMin > 255.0f ? 255.0f : qMin));
+                qMax = (qMax < 0.0f ? 0.0f : (qMax > 255.0f ? 255.0f : qMax));
+                while (qMin > 0.0f && min + (qMin * scale) > mins[i])
+                    qMin -= 1.0f;
+                while (qMax < 255.0f && min + (qMax * scale) < maxes[i])
+                    qMax += 1.0f;
+
+                outMins[i] = (unsigned char)qMin;
+                outMaxes[i] = (unsigned char)qMax;
+            }
+        }
+
+        //Tests the given ray against every child of the given node at once.
+        //Outputs the "t" value where the ray enters each child (clamped to "tMin").
+        //Returns a bitmask of the children that were hit.
+        //Follows the same rules as "BoundingBox::RayIntersects()", including how NaN values are ignored.
+        static unsigned int IntersectChildren(const Node& node,
+                                              const Vector3f& rayPos, const Vector3f& invRayDir,
+                                              float tMin, float tMax, float* outTEnters)
+        {
+            unsigned int mask = 0;
+
+#if RT_BVH_SIMD
+            //Decodes four quantized values along one axis, and gets the "t" values where the ray crosses them.
+            __m128i zero = _mm_setzero_si128();
+            auto getTs = [&](const unsigned char* q, int axis, float pos, float invDir)
+            {
+                int qBytes;
+                memcpy(&qBytes, q, 4);
+                __m128i qInts = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(qBytes), zero), zero);
+                __m128 decoded = _mm_add_ps(_mm_set1_ps(node.Origin[axis]),
+                                            _mm_mul_ps(_mm_cvtepi32_ps(qInts),
+                                                       _mm_set1_ps(node.GetScale(axis))));
+                return _mm_mul_ps(_mm_sub_ps(decoded, _mm_set1_ps(pos)), _mm_set1_ps(invDir));
+            };
+
+            __m128 tx1 = getTs(node.MinX, 0, rayPos.x, invRayDir.x),
+                   tx2 = getTs(node.MaxX, 0, rayPos.x, invRayDir.x),
+                   ty1 = getTs(node.MinY, 1, rayPos.y, invRayDir.y),
+                   ty2 = getTs(node.MaxY, 1, rayPos.y, invRayDir.y),
+                   tz1 = getTs(node.MinZ, 2, rayPos.z, invRayDir.z),
+                   tz2 = getTs(node.MaxZ, 2, rayPos.z, invRayDir.z);
+
+            //"_mm_min_ps(b, a)" is the same as "(a < b) ? a : b" and ignores a NaN "a" the same way.
+            __m128 tEnter = _mm_max_ps(_mm_min_ps(tx2, tx1), _mm_set1_ps(tMin)),
+                   tExit = _mm_min_ps(_mm_max_ps(tx2, tx1), _mm_set1_ps(tMax));
+            tEnter = _mm_max_ps(_mm_min_ps(ty2, ty1), tEnter);
+            tExit = _mm_min_ps(_mm_max_ps(ty2, ty1), tExit);
+            tEnter = _mm_max_ps(_mm_min_ps(tz2, tz1), tEnter);
+            tExit = _mm_min_ps(_mm_max_ps(tz2, tz1), tExit);
+
+            _mm_storeu_ps(outTEnters, tEnter);
+            mask = (unsigned int)_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit));
+#else
+            for (unsigned int i = 0; i < Width; ++i)
+                if (node.GetChildBounds(i).RayIntersects(rayPos, invRayDir, tMin, tMax, outTEnters[i]))
+                    mask |= (1 << i);
+#endif
+
+            return mask & ((1 << node.NChildren) - 1);
+        }
+    };
+}
+
+#pragma warning(default: 4251)
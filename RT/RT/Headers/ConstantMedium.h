@@ -24,8 +24,9 @@ namespace RT
 
 
         virtual void PrecalcData() override;
+        virtual void UpdatePrecalcData() override;
 
-        virtual void GetBoundingBox(BoundingBox& outB) const override { Surface->GetBoundingBox(outB); }
+        virtual void GetBoundingBox(BoundingBox& outB) const override { outB = bounds; }
         virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                              float tMin = 0.0f,
                              float tMax = std::numeric_limits<float>::infinity()) const override;
@@ -35,6 +36,9 @@ namespace RT
 
 
     private:
+
+        //The surface's bounds, stored here so they don't have to be fetched on every ray.
+        BoundingBox bounds;
         
         ADD_SHAPE_REFLECTION_DATA_H(ConstantMedium);
     };
@@ -19,6 +19,7 @@ namespace RT
     class DataWriter;
 
     EXPORT_RT_LIST(unsigned char);
+    EXPORT_RT_LIST(float);
 
 
     //A data structure that can read its data from a DataReader.
@@ -70,6 +71,11 @@ namespace RT
         virtual void WriteString(const String& value, const String& name) = 0;
         virtual void WriteBytes(const unsigned char* bytes, size_t nBytes, const String& name) = 0;
 
+        //Writes a large block of floats, e.x. mesh vertex data.
+        //By default, the raw bytes of the floats are written with "WriteBytes()",
+        //    which is much faster and more compact than writing each float individually.
+        virtual void WriteFloats(const float* values, size_t nValues, const String& name);
+
         virtual void WriteVec2f(const Vector2f& v, const String& name);
         virtual void WriteVec3f(const Vector3f& v, const String& name);
         virtual void WriteVec4f(const Vector4f& v, const String& name);
@@ -164,6 +170,10 @@ namespace RT
         virtual ~DataReader(void) { }
 
 
+        //Gets whether an element with the given name exists at the current level of the data.
+        //Useful for optional or renamed fields, so that other read errors aren't mistaken for them.
+        virtual bool HasElement(const String& name) = 0;
+
         virtual void ReadBool(bool& outB, const String& name) = 0;
         virtual void ReadByte(unsigned char& outB, const String& name) = 0;
         virtual void ReadInt(int& outI, const String& name) = 0;
@@ -173,6 +183,9 @@ namespace RT
         virtual void ReadString(String& outStr, const String& name) = 0;
         virtual void ReadBytes(List<unsigned char>& outBytes, const String& name) = 0;
 
+        //Reads a block of floats that was written with "DataWriter::WriteFloats()".
+        virtual void ReadFloats(List<float>& outValues, const String& name);
+
         virtual void ReadVec2f(Vector2f& v, const String& name);
         virtual void ReadVec3f(Vector3f& v, const String& name);
         virtual void ReadVec4f(Vector4f& v, const String& name);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Texture2D.h"
+#include "AOVBuffers.h"
+#include "ThreadPool.h"
+
+
+namespace RT
+{
+    //Removes noise from a rendered image with an edge-avoiding a-trous wavelet filter
+    //    (Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform for fast Global Illumination Filtering").
+    //Each pass blurs the image with a 5x5 kernel whose taps are twice as far apart as the last pass's,
+    //    and the image's AOV buffers stop the blur from crossing edges between surfaces.
+    //The albedo is divided out before filtering and multiplied back in afterwards,
+    //    so texture detail isn't blurred away along with the noise.
+    class RT_API Denoiser
+    {
+    public:
+
+        //The number of filter passes. Each pass reaches twice as far as the last,
+        //    so four passes blur across up to 30 pixels in each direction.
+        size_t NPasses = 4;
+
+        //The below values control how quickly the weight of a neighboring pixel falls off
+        //    as it gets more different from the pixel being filtered.
+        //Smaller values keep edges sharper, but leave more noise.
+
+        //How different the (albedo-divided) colors can be. Halved with each pass,
+        //    since each pass has less noise left to remove.
+        float ColorSigma = 0.5f;
+        //How different the normals can be.
+        float NormalSigma = 0.2f;
+        //How different the depths can be, relative to the depth of the pixel being filtered.
+        float DepthSigma = 0.05f;
+        //How different the albedos can be.
+        float AlbedoSigma = 0.1f;
+
+
+        //Denoises "image" into "outImage", using the given AOV buffers rendered along with it.
+        //All of them must be the same size. "outImage" may be the same texture as "image".
+        void Denoise(const Texture2D& image, const AOVBuffers& features,
+                     Texture2D& outImage, ThreadPool& pool) const;
+    };
+}
@@ -1,25 +1,59 @@
 #pragma once
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "Vectors.h"
 
 
 namespace RT
 {
-    //A fast (but not cryptographically-strong) PRNG.
+    //A fast (but not cryptographically-strong) PRNG: O'Neill's PCG32 (XSH-RR variant).
+    //Each generator has a seed, which picks its starting point,
+    //    and a stream, which picks one of 2^63 different sequences.
     //Always generates non-negative numbers.
     class RT_API FastRand
     {
     public:
-        static int Hash(int x, int y) { return (x << 5) + x ^ y; } //http://stackoverflow.com/questions/13812335/how-to-hash-an-int-in-c-sharp
-        static int Hash(float f) { return *(int*)(&f); }
 
+        //A 32-bit integer hash where every input bit affects every output bit ("lowbias32", by Chris Wellons).
+        static unsigned int Mix(unsigned int x)
+        {
+            x ^= x >> 16;
+            x *= 0x7feb352dU;
+            x ^= x >> 15;
+            x *= 0x846ca68bU;
+            x ^= x >> 16;
+            return x;
+        }
+        //A 64-bit integer hash (the "SplitMix64" finalizer).
+        static uint64_t Mix64(uint64_t x)
+        {
+            x ^= x >> 30;
+            x *= 0xbf58476d1ce4e5b9ULL;
+            x ^= x >> 27;
+            x *= 0x94d049bb133111ebULL;
+            x ^= x >> 31;
+            return x;
+        }
 
-	    int Seed;
+        static int Hash(int x, int y) { return (int)Mix((unsigned int)x ^ Mix((unsigned int)y + 0x9e3779b9U)); }
+        static int Hash(float f)
+        {
+            //Positive and negative zero should hash the same.
+            if (f == 0.0f)
+                f = 0.0f;
+            unsigned int bits;
+            memcpy(&bits, &f, sizeof(float));
+            return (int)Mix(bits);
+        }
 
 
-        FastRand(int seed = 1234567) : Seed(seed) { }
+        uint64_t State, Increment;
+
+
+        FastRand(int seed = 1234567) { SetSeed((uint32_t)seed, 0); }
         FastRand(int x, int y) : FastRand(Hash(x, y)) { }
         FastRand(int x, int y, int z) : FastRand(Hash(x, y), z) { }
         FastRand(int x, int y, int z, int w) : FastRand(Hash(x, y), Hash(z, w)) { }
@@ -29,27 +63,60 @@ namespace RT
         FastRand(float x, float y, float z) : FastRand(Hash(x), Hash(y), Hash(z)) { }
         FastRand(float x, float y, float z, float w) : FastRand(Hash(x), Hash(y), Hash(z), Hash(w)) { }
 
+        //Makes a generator from the given seed in the given stream.
+        //Generators with different streams give unrelated sequences even if their seeds are the same.
+        static FastRand FromStream(uint64_t seed, uint64_t stream)
+        {
+            FastRand r;
+            r.SetSeed(seed, stream);
+            return r;
+        }
+        //Makes a generator for the given dimension of the given sample of the given pixel.
+        //Every combination gets its own stream, so the numbers for any of them
+        //    can be generated without generating all the ones before it.
+        static FastRand ForSample(unsigned int pixelX, unsigned int pixelY,
+                                  unsigned int sampleIndex, unsigned int dimension = 0)
+        {
+            return FromStream(((uint64_t)sampleIndex << 32) | dimension,
+                              ((uint64_t)pixelY << 32) | pixelX);
+        }
+
 
-        //Gets a random non-negative integer.
-	    inline int NextInt()
-	    {
-            //I forget where this particular XORshift generator came from.
-		    Seed = (Seed ^ 61) ^ (Seed >> 16);
-		    Seed += (Seed << 3);
-		    Seed ^= (Seed >> 4);
-		    Seed *= 0x27d4eb2d;
-		    Seed ^= (Seed >> 15);
-            assert(Seed >= 0);
-		    return Seed;
-	    }
-        //Gets a random float between 0 and 1.
-	    inline float NextFloat()
+        //Restarts this generator from the given seed in the given stream.
+        void SetSeed(uint64_t seed, uint64_t stream)
+        {
+            State = 0;
+            Increment = (Mix64(stream) << 1) | 1;
+            NextUInt();
+            State += Mix64(seed);
+            NextUInt();
+        }
+
+        //Gets a random 32-bit integer.
+        inline unsigned int NextUInt()
         {
-            //TODO: Check this out: https://www.reddit.com/r/askscience/comments/3kxj7u/many_prngs_use_bitwise_operations_for_their_speed/cv6ao96/
+            uint64_t oldState = State;
+            State = (oldState * 6364136223846793005ULL) + Increment;
 
-            const int b = 9999999;
-		    return (float)(NextInt() % b) / (float)b;
-	    }
+            unsigned int xorShifted = (unsigned int)(((oldState >> 18) ^ oldState) >> 27),
+                         rotation = (unsigned int)(oldState >> 59);
+            return (xorShifted >> rotation) | (xorShifted << ((0 - rotation) & 31));
+        }
+        //Gets a random non-negative integer.
+        inline int NextInt() { return (int)(NextUInt() >> 1); }
+        //Gets a random float in [0, 1).
+        inline float NextFloat() { return ToFloat(NextUInt()); }
+
+        //Turns 32 random bits into a float in [0, 1).
+        //The top 23 bits become the mantissa of a float in [1, 2), which is then shifted down;
+        //    this avoids an int-to-float conversion and a divide.
+        static float ToFloat(unsigned int bits)
+        {
+            unsigned int floatBits = 0x3f800000U | (bits >> 9);
+            float f;
+            memcpy(&f, &floatBits, sizeof(float));
+            return f - 1.0f;
+        }
 
         //Gets a random vector of length 1.
         inline Vector3f NextUnitVector3()
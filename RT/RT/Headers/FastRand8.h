@@ -0,0 +1,124 @@
+#pragma once
+
+#include "FastRand.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define RT_RAND_SIMD 1
+#else
+    #define RT_RAND_SIMD 0
+#endif
+
+
+namespace RT
+{
+    //Eight independent random streams generated side by side, for kernels that work in batches.
+    //Each lane is counter-based: its "i"th number is a hash of the lane's key and "i",
+    //    so a lane can jump to any point in its stream and the lanes never overlap.
+    //Lane "i" gives exactly the same numbers as "Get(GetKey(i), counter)",
+    //    whether or not SIMD is available.
+    class RT_API FastRand8
+    {
+    public:
+
+        static const unsigned int NLanes = 8;
+
+        //Gets the given number of the stream with the given key.
+        static unsigned int Get(unsigned int key, unsigned int counter)
+        {
+            return FastRand::Mix(key ^ FastRand::Mix(counter));
+        }
+
+
+        //The index of the next number in every lane's stream.
+        unsigned int Counter = 0;
+
+
+        //Gives each lane a different key generated from the given seed.
+        FastRand8(unsigned int seed = 1234567)
+        {
+            for (unsigned int i = 0; i < NLanes; ++i)
+                keys[i] = FastRand::Mix(seed + (i * 0x9e3779b9U));
+        }
+        //Uses the given key for each lane, e.x. to give each of eight pixels its own stream.
+        FastRand8(const unsigned int laneKeys[NLanes])
+        {
+            for (unsigned int i = 0; i < NLanes; ++i)
+                keys[i] = laneKeys[i];
+        }
+
+        unsigned int GetKey(unsigned int lane) const { return keys[lane]; }
+
+
+        //Gets the next random 32-bit integer of each lane.
+        void NextUInts(unsigned int outValues[NLanes])
+        {
+#if RT_RAND_SIMD
+            __m128i mixedCounter = _mm_set1_epi32((int)FastRand::Mix(Counter));
+            for (unsigned int i = 0; i < NLanes; i += 4)
+            {
+                __m128i values = MixLanes(_mm_xor_si128(LoadKeys(i), mixedCounter));
+                _mm_storeu_si128((__m128i*)(outValues + i), values);
+            }
+#else
+            unsigned int mixedCounter = FastRand::Mix(Counter);
+            for (unsigned int i = 0; i < NLanes; ++i)
+                outValues[i] = FastRand::Mix(keys[i] ^ mixedCounter);
+#endif
+            Counter += 1;
+        }
+        //Gets the next random float in [0, 1) of each lane.
+        //Uses the same conversion as "FastRand::ToFloat()".
+        void NextFloats(float outValues[NLanes])
+        {
+#if RT_RAND_SIMD
+            __m128i mixedCounter = _mm_set1_epi32((int)FastRand::Mix(Counter));
+            __m128i oneBits = _mm_set1_epi32(0x3f800000);
+            __m128 one = _mm_set1_ps(1.0f);
+            for (unsigned int i = 0; i < NLanes; i += 4)
+            {
+                __m128i values = MixLanes(_mm_xor_si128(LoadKeys(i), mixedCounter));
+                __m128 floats = _mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(values, 9), oneBits));
+                _mm_storeu_ps(outValues + i, _mm_sub_ps(floats, one));
+            }
+            Counter += 1;
+#else
+            unsigned int values[NLanes];
+            NextUInts(values);
+            for (unsigned int i = 0; i < NLanes; ++i)
+                outValues[i] = FastRand::ToFloat(values[i]);
+#endif
+        }
+
+
+    private:
+
+        unsigned int keys[NLanes];
+
+
+#if RT_RAND_SIMD
+        __m128i LoadKeys(unsigned int firstLane) const { return _mm_loadu_si128((const __m128i*)(keys + firstLane)); }
+
+        //Multiplies each 32-bit lane by the given constant, keeping the low 32 bits.
+        //SSE2 can only multiply two 32-bit lanes at a time, so the odd lanes are done separately.
+        static __m128i MultiplyLanes(__m128i a, unsigned int b)
+        {
+            __m128i bs = _mm_set1_epi32((int)b);
+            __m128i even = _mm_mul_epu32(a, bs),
+                    odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), bs);
+            return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                      _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+        }
+        //"FastRand::Mix()" on four lanes at once.
+        static __m128i MixLanes(__m128i x)
+        {
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            x = MultiplyLanes(x, 0x7feb352dU);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 15));
+            x = MultiplyLanes(x, 0x846ca68bU);
+            x = _mm_xor_si128(x, _mm_srli_epi32(x, 16));
+            return x;
+        }
+#endif
+    };
+}
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <vector>
+
+#include "Shape.h"
+#include "SmartPtrs.h"
+#include "List.h"
+#include "MaterialValues.h"
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A foggy medium whose density changes from place to place, e.x. fog that thins out with height.
+    //The density comes from a 3D grid stretched over the surface's world-space bounds if one is given,
+    //    or from a MaterialValue otherwise.
+    //Rays are traced through it with delta tracking against a coarse grid of maximum densities,
+    //    built in "PrecalcData()", so empty and thin regions are crossed in big steps.
+    //It is highly recommended to pair this shape with Material_Medium.
+    class RT_API HeterogeneousMedium : public Shape
+    {
+    public:
+
+        //The number of cells along each axis of the grid of maximum densities.
+        static const unsigned int MajorantGridSize = 16;
+        //The number of points along each axis of a maximum-density cell
+        //    where a MaterialValue density is sampled to find that cell's maximum.
+        static const unsigned int MajorantSamplesPerAxis = 4;
+
+
+        //The surface of this medium.
+        SharedPtr<Shape> Surface;
+
+        //The density, if there's no grid.
+        //It's evaluated with the world position as the surface position, so e.x. "MV_SurfPos" works.
+        MaterialValue::Ptr Density;
+        //A MaterialValue density can only be sampled at points, so the maximum density in each cell
+        //    is padded by this factor in case the density peaks between the samples.
+        float MajorantPadding = 1.25f;
+
+        //If not empty, the density comes from this grid instead of "Density".
+        //The values are indexed by [x + (y * GridSizeX) + (z * GridSizeX * GridSizeY)],
+        //    sit at the centers of their cells, and are blended trilinearly.
+        List<float> DensityGrid;
+        unsigned int GridSizeX = 0,
+                     GridSizeY = 0,
+                     GridSizeZ = 0;
+
+        //Scales the density from either source.
+        float DensityScale = 1.0f;
+
+
+        HeterogeneousMedium(SharedPtr<Shape> surface = nullptr,
+                            MaterialValue::Ptr density = new MV_Constant(1.0f))
+            : Surface(surface), Density(density) { }
+
+
+        virtual void PrecalcData() override;
+        virtual void UpdatePrecalcData() override;
+
+        virtual void GetBoundingBox(BoundingBox& outB) const override { outB = bounds; }
+        virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                             float tMin = 0.0f,
+                             float tMax = std::numeric_limits<float>::infinity()) const override;
+
+        virtual void WriteData(DataWriter& writer) const override;
+        virtual void ReadData(DataReader& reader) override;
+
+
+    private:
+
+        BoundingBox bounds;
+        Vector3f cellSize, invCellSize;
+
+        //The highest density in each cell of a grid over "bounds".
+        //Indexed the same way as "DensityGrid".
+        std::vector<float> majorants;
+
+
+        void BuildMajorants();
+
+        //Gets where the given ray is inside the surface, within [tMin, tMax].
+        //Returns false if it never is.
+        bool GetInterval(const Ray& ray, FastRand& prng, float tMin, float tMax,
+                         float& outEnterT, float& outExitT) const;
+
+        float GetDensity(const Vector3f& worldPos, const Ray& ray, FastRand& prng) const;
+        float GetGridDensity(const Vector3f& worldPos) const;
+
+        //Goes through every majorant cell the given ray passes through between "tMin" and "tMax", in order.
+        //For each one, calls "visitCell(float tEnter, float tExit, float majorant)",
+        //    which returns whether to stop.
+        template<typename CellVisitor>
+        void WalkMajorants(const Ray& ray, float tMin, float tMax, CellVisitor visitCell) const;
+
+
+        ADD_SHAPE_REFLECTION_DATA_H(HeterogeneousMedium);
+    };
+}
+
+#pragma warning(default: 4251)
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Shape.h"
+#include "Dictionary.h"
+
+
+namespace RT
+{
+    using ConstShapeToID = Dictionary<const Shape*, unsigned int>;
+    using IDToShape = Dictionary<unsigned int, SharedPtr<Shape>>;
+
+
+    //A copy of some geometry that may be shared with other instances, placed with its own transform.
+    //The geometry only exists in memory once, no matter how many instances use it.
+    //The geometry must not be modified while any instances of it are being traced.
+    //NOTE: The geometry is precalculated by whatever owns the instances, not by the instances themselves,
+    //    so that it only happens once. Tracer does this for every instance in its objects,
+    //    including instances nested in other instances' geometry or used as a medium's surface.
+    class RT_API Instance : public Shape
+    {
+    public:
+
+        //Shared geometry is serialized once by the owner of the instances, which gives it an ID.
+        //While one of these exists, instances serialized on this thread refer to their geometry by that ID.
+        //Instances whose geometry has no ID, or that are serialized outside of a scope,
+        //    write their geometry in full.
+        struct RT_API GeometryIDScope
+        {
+        public:
+            GeometryIDScope(const ConstShapeToID* geometryToID, const IDToShape* idToGeometry);
+            ~GeometryIDScope();
+        private:
+            const ConstShapeToID* prevGeometryToID;
+            const IDToShape* prevIDToGeometry;
+        };
+
+
+        SharedPtr<Shape> Geometry;
+
+
+        Instance(SharedPtr<Shape> geometry = nullptr) : Geometry(geometry) { }
+
+
+        virtual void PrecalcData() override;
+
+        virtual void GetBoundingBox(BoundingBox& outB) const override { outB = bounds; }
+        virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                             float tMin = 0.0f,
+                             float tMax = std::numeric_limits<float>::infinity()) const override;
+        virtual bool CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                                     float& outEnterT, float& outExitT) const override;
+
+
+        virtual void WriteData(DataWriter& writer) const override;
+        virtual void ReadData(DataReader& reader) override;
+
+
+    private:
+
+        BoundingBox bounds;
+
+        //Gets the given ray in the geometry's space, normalized,
+        //    along with how much to multiply the world ray's "t" values by to get "t" values along it.
+        Ray GetLocalRay(const Ray& ray, float& outTScale) const;
+
+
+        ADD_SHAPE_REFLECTION_DATA_H(Instance);
+    };
+}
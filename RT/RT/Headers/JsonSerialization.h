@@ -89,6 +89,8 @@ namespace RT
         String Reload(const String& filePath);
 
 
+        virtual bool HasElement(const String& name) override;
+
         virtual void ReadBool(bool& outB, const String& name) override;
         virtual void ReadByte(unsigned char& outB, const String& name) override;
         virtual void ReadInt(int& outI, const String& name) override;
@@ -1,6 +1,6 @@
 #pragma once
 
-#include "FastRand.h"
+#include "Sampler.h"
 #include "Shape.h"
 #include "DataSerialization.h"
 
@@ -48,7 +48,7 @@ namespace RT
         //Also potentially attenuates/brightens the ray.
         //Returns "true" if the ray scattered, or "false" if the ray was absorbed.
         virtual bool Scatter(const Ray& rIn, const Vertex& surface,
-                             const Shape& shpe, FastRand& prng,
+                             const Shape& shpe, Sampler& sampler,
                              Vector3f& outAttenuation, Vector3f& outEmission, Ray& outRay) const = 0;
 
         virtual void ReadData(DataReader& data) override { }
@@ -7,7 +7,7 @@
 #include "Dictionary.h"
 #include "DataSerialization.h"
 #include "SmartPtrs.h"
-#include "FastRand.h"
+#include "Sampler.h"
 #include "Vectorf.h"
 
 
@@ -65,7 +65,7 @@ namespace RT
 
         //Gets a value with between 1 and 4 dimensions.
         //Note that the shape and vertex may be null if nothing was hit by the ray.
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const = 0;
 
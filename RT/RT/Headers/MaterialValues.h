@@ -97,7 +97,7 @@ namespace RT
 
         virtual Dimensions GetNDims() const override { return Value.NValues; }
 
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override
             { return Value; }
@@ -123,7 +123,7 @@ namespace RT
     { \
     public: \
         virtual Dimensions GetNDims() const override { return nDims; } \
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng, \
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler, \
                                     const Shape* shpe = nullptr, \
                                     const Vertex* surface = nullptr) const override \
             { getValueBody } \
@@ -165,10 +165,10 @@ namespace RT
         Ptr T;
         MV_RayPos(Ptr t) : T(t) { }
         virtual Dimensions GetNDims() const override { return Three; }
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override
-            { return ray.GetPos((float)T->GetValue(ray, prng, shpe, surface)); }
+            { return ray.GetPos((float)T->GetValue(ray, sampler, shpe, surface)); }
         virtual size_t GetNChildren() const override { return 1; }
         virtual const MaterialValue* GetChild(size_t i) const override { return T.Get(); }
         virtual void SetChild(size_t index, const Ptr& newChild) override { assert(index == 0); T = newChild; }
@@ -186,7 +186,7 @@ namespace RT
         Dimensions NDims;
         MV_PureNoise(Dimensions nDims = One) : NDims(nDims) { }
         virtual Dimensions GetNDims() const override { return NDims; }
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
         virtual size_t GetNChildren() const override { return 0; }
@@ -207,7 +207,7 @@ namespace RT
         Ptr X;
         MV_PerlinNoise(Ptr x) : X(x) { }
         virtual Dimensions GetNDims() const override { return One; }
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
         virtual size_t GetNChildren() const override { return 1; }
@@ -237,7 +237,7 @@ namespace RT
         MV_WorleyNoise(Ptr x, Ptr variance) : X(x), Variance(variance) { }
 
         virtual Dimensions GetNDims() const override { return Dimensions::One; }
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
 
@@ -290,10 +290,10 @@ namespace RT
 
         virtual Dimensions GetNDims() const override { return Three; }
 
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override
-            { return Tex->GetColor(UV->GetValue(ray, prng, shpe, surface)); }
+            { return Tex->GetColor(UV->GetValue(ray, sampler, shpe, surface)); }
 
         virtual size_t GetNChildren() const override { return 1; }
         virtual const MaterialValue* GetChild(size_t i) const override { return UV.Get(); }
@@ -386,7 +386,7 @@ namespace RT
             : NValues(4), Val(val) { Swizzle[0] = newX; Swizzle[1] = newY; Swizzle[2] = newZ; Swizzle[3] = newW; }
 
         virtual Dimensions GetNDims() const override { return (Dimensions)NValues; }
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
         virtual size_t GetNChildren() const override { return 1; }
@@ -413,7 +413,7 @@ namespace RT
 
         virtual Dimensions GetNDims() const override;
 
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng,
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
 
@@ -438,7 +438,7 @@ namespace RT
 
         virtual Dimensions GetNDims() const override { return Dimensions::Three; }
 
-        virtual Vectorf GetValue(const Ray&, FastRand& prng,
+        virtual Vectorf GetValue(const Ray&, Sampler& sampler,
                                  const Shape* shpe = nullptr,
                                  const Vertex* surface = nullptr) const override;
 
@@ -471,7 +471,7 @@ namespace RT
         MV_##name(const Ptr& val1, const Ptr& val2, const Ptr& val3, const Ptr& val4, const Ptr& val5) { paramsListName.push_back(Ptr(val1)); paramsListName.push_back(Ptr(val2)); paramsListName.push_back(Ptr(val3)); paramsListName.push_back(Ptr(val4)); paramsListName.push_back(Ptr(val5)); } \
             \
         virtual Dimensions GetNDims() const override; \
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng, \
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler, \
                                     const Shape* shpe = nullptr, \
                                     const Vertex* surface = nullptr) const override; \
             \
@@ -503,7 +503,7 @@ namespace RT
         MV_##name(Ptr _##paramName) : paramName(_##paramName) { }; \
             \
         virtual Dimensions GetNDims() const override { dimsCalc } \
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng, \
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler, \
                                  const Shape* shpe = nullptr, \
                                  const Vertex* surface = nullptr) const override; \
         virtual size_t GetNChildren() const override { return 1; } \
@@ -527,7 +527,7 @@ namespace RT
         MV_##name(Ptr _##param1Name, Ptr _##param2Name) : param1Name(_##param1Name), param2Name(_##param2Name) { }; \
             \
         virtual Dimensions GetNDims() const override; \
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng, \
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler, \
                                     const Shape* shpe = nullptr, \
                                     const Vertex* surface = nullptr) const override; \
         virtual size_t GetNChildren() const override { return 2; } \
@@ -550,7 +550,7 @@ namespace RT
         MV_##name(Ptr _##param1Name, Ptr _##param2Name, Ptr _##param3Name) : param1Name(_##param1Name), param2Name(_##param2Name), param3Name(_##param3Name) { }; \
             \
         virtual Dimensions GetNDims() const override; \
-        virtual Vectorf GetValue(const Ray& ray, FastRand& prng, \
+        virtual Vectorf GetValue(const Ray& ray, Sampler& sampler, \
                                     const Shape* shpe = nullptr, \
                                     const Vertex* surface = nullptr) const override; \
         virtual size_t GetNChildren() const override { return 3; } \
@@ -18,7 +18,7 @@ namespace RT
 
 
         virtual bool Scatter(const Ray& rIn, const Vertex& surface,
-                             const Shape& shpe, FastRand& prng,
+                             const Shape& shpe, Sampler& sampler,
                              Vector3f& outAttenuation, Vector3f& outEmission, Ray& outRay) const override;
 
 
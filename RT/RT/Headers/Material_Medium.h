@@ -17,7 +17,7 @@ namespace RT
             : Albedo(albedo) { }
 
         virtual bool Scatter(const Ray& rIn, const Vertex& surface,
-                             const Shape& shpe, FastRand& prng,
+                             const Shape& shpe, Sampler& sampler,
                              Vector3f& outAttenuation, Vector3f& outEmission, Ray& outRay) const override;
 
         virtual void WriteData(DataWriter& writer) const override;
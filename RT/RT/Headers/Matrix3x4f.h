@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Matrix4f.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #include <xmmintrin.h>
+    #define RT_MATRIX_SIMD 1
+#else
+    #define RT_MATRIX_SIMD 0
+#endif
+
+
+namespace RT
+{
+    //An affine transformation: a 4x4 matrix whose bottom row is always (0, 0, 0, 1).
+    //Only the top three rows are stored, so it takes 3/4 the space of a "Matrix4f",
+    //    and points can be transformed without the projective row or the divide by W.
+    //The values are stored by column, so that applying it is a sum of scaled columns.
+    struct RT_API Matrix3x4f
+    {
+    public:
+
+        Matrix3x4f() : Matrix3x4f(Matrix4f()) { }
+        //Uses the top three rows of the given matrix. Its bottom row should be (0, 0, 0, 1).
+        explicit Matrix3x4f(const Matrix4f& m);
+
+
+        float& Get(int row, int col) { return cols[col][row]; }
+        const float& Get(int row, int col) const { return cols[col][row]; }
+
+        Matrix4f ToMatrix4f() const;
+
+
+        Vector3f ApplyPoint(const Vector3f& p) const
+        {
+#if RT_MATRIX_SIMD
+            __m128 result = _mm_add_ps(_mm_mul_ps(LoadCol(0), _mm_set1_ps(p.x)),
+                                       _mm_mul_ps(LoadCol(1), _mm_set1_ps(p.y)));
+            result = _mm_add_ps(result, _mm_mul_ps(LoadCol(2), _mm_set1_ps(p.z)));
+            return ToVector3f(_mm_add_ps(result, LoadCol(3)));
+#else
+            return Vector3f((cols[0][0] * p.x) + (cols[1][0] * p.y) + (cols[2][0] * p.z) + cols[3][0],
+                            (cols[0][1] * p.x) + (cols[1][1] * p.y) + (cols[2][1] * p.z) + cols[3][1],
+                            (cols[0][2] * p.x) + (cols[1][2] * p.y) + (cols[2][2] * p.z) + cols[3][2]);
+#endif
+        }
+        Vector3f ApplyVector(const Vector3f& v) const
+        {
+#if RT_MATRIX_SIMD
+            __m128 result = _mm_add_ps(_mm_mul_ps(LoadCol(0), _mm_set1_ps(v.x)),
+                                       _mm_mul_ps(LoadCol(1), _mm_set1_ps(v.y)));
+            return ToVector3f(_mm_add_ps(result, _mm_mul_ps(LoadCol(2), _mm_set1_ps(v.z))));
+#else
+            return Vector3f((cols[0][0] * v.x) + (cols[1][0] * v.y) + (cols[2][0] * v.z),
+                            (cols[0][1] * v.x) + (cols[1][1] * v.y) + (cols[2][1] * v.z),
+                            (cols[0][2] * v.x) + (cols[1][2] * v.y) + (cols[2][2] * v.z));
+#endif
+        }
+        //Applies the transpose of this matrix's rotation/scale part to the given vector.
+        //Applying the inverse of a transform this way is how that transform applies to normals.
+        Vector3f ApplyVectorTransposed(const Vector3f& v) const
+        {
+            return Vector3f((cols[0][0] * v.x) + (cols[0][1] * v.y) + (cols[0][2] * v.z),
+                            (cols[1][0] * v.x) + (cols[1][1] * v.y) + (cols[1][2] * v.z),
+                            (cols[2][0] * v.x) + (cols[2][1] * v.y) + (cols[2][2] * v.z));
+        }
+
+
+    private:
+
+        float cols[4][3];
+
+
+#if RT_MATRIX_SIMD
+        //Loads the given column into the first three lanes. The last lane is garbage.
+        __m128 LoadCol(int col) const
+        {
+            //Reading four floats from the last column would go past the end of the matrix,
+            //    so read from one float earlier and shift it down.
+            if (col < 3)
+                return _mm_loadu_ps(cols[col]);
+            __m128 lastFour = _mm_loadu_ps(&cols[2][2]);
+            return _mm_shuffle_ps(lastFour, lastFour, _MM_SHUFFLE(3, 3, 2, 1));
+        }
+        static Vector3f ToVector3f(__m128 v)
+        {
+            float values[4];
+            _mm_storeu_ps(values, v);
+            return Vector3f(values[0], values[1], values[2]);
+        }
+#endif
+    };
+}
@@ -5,6 +5,7 @@
 #include "Triangle.h"
 #include "Shape.h"
 #include "List.h"
+#include "BVHTree.h"
 
 
 namespace RT
@@ -18,7 +19,28 @@ namespace RT
     {
     public:
 
+        //How a mesh's BVH can be built.
+        enum SplitModes : unsigned char
+        {
+            //Use whatever "UseSpatialSplitsByDefault" says.
+            SceneDefault = 0,
+            //Only split the triangles into groups. The fastest to build.
+            ObjectSplits,
+            //Also split space itself, clipping triangles that cross the split plane.
+            //Much faster to trace for long, thin triangles (e.x. architecture),
+            //    but slower to build, and uses more memory.
+            SpatialSplits,
+        };
+
+        //The defaults for every mesh whose split mode is "SceneDefault".
+        //Not thread-safe; set these before doing any precalculation.
+        static bool UseSpatialSplitsByDefault;
+        //How many extra triangle references spatial splits may make, as a fraction of the triangle count.
+        static float SpatialSplitBudget;
+
+
         List<Triangle> Tris;
+        SplitModes SplitMode = SceneDefault;
 
 
         Mesh() { }
@@ -30,11 +52,17 @@ namespace RT
 
 
         virtual void PrecalcData() override;
+        //Refits this mesh's BVH to its triangles' new positions instead of rebuilding it,
+        //    unless they moved so much that a rebuild would be worth it.
+        //The BVH is also rebuilt if the number of triangles changed.
+        virtual void UpdatePrecalcData() override;
 
-        virtual void GetBoundingBox(BoundingBox& b) const override { b = bounds; }
+        virtual void GetBoundingBox(BoundingBox& b) const override { b = worldBounds; }
         virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                              float tMin = 0.0f,
                              float tMax = std::numeric_limits<float>::infinity()) const override;
+        virtual bool CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                                     float& outEnterT, float& outExitT) const override;
 
 
         virtual void WriteData(DataWriter& writer) const override;
@@ -43,7 +71,17 @@ namespace RT
 
     private:
 
-        BoundingBox bounds;
+        BoundingBox worldBounds;
+        BVHTree bvh;
+
+
+        //Precalculates every triangle and gets its bounds.
+        //Returns a hash of the triangles' positions.
+        unsigned long long PrecalcTris(std::vector<BoundingBox>& outTriBounds);
+        //Builds the BVH with this mesh's split mode.
+        //If "hash" isn't null, the BVH cache is used with that hash.
+        void BuildBVH(const std::vector<BoundingBox>& triBounds, const unsigned long long* hash);
+        void UpdateWorldBounds();
 
 
         ADD_SHAPE_REFLECTION_DATA_H(Mesh);
@@ -1,11 +1,17 @@
 #pragma once
 
 #include "Tracer.h"
+#include "RenderBuffer.h"
+#include "AOVBuffers.h"
+#include "Denoiser.h"
 
 #include "Sphere.h"
 #include "Mesh.h"
 #include "Plane.h"
 #include "ConstantMedium.h"
+#include "HeterogeneousMedium.h"
+#include "Instance.h"
+#include "SphereBatch.h"
 
 #include "Material_Lambert.h"
 #include "Material_Metal.h"
@@ -15,5 +21,9 @@
 #include "SkyMaterial_VerticalGradient.h"
 #include "MaterialValues.h"
 
+#include "Samplers.h"
+#include "FastRand8.h"
+
 #include "Mathf.h"
-#include "JsonSerialization.h"
\ No newline at end of file
+#include "JsonSerialization.h"
+#include "BVHCache.h"
\ No newline at end of file
@@ -32,6 +32,60 @@ C_RT_API float* rt_GenerateImage(unsigned int imgWidth, unsigned int imgHeight,
                                  float camForwardX, float camForwardY, float camForwardZ,
                                  float camUpX, float camUpY, float camUpZ,
                                  const char* sceneJSONPath);
+
+//Called by "GeneratePreviewImage()" after each pass, with the whole image so far
+//    (laid out the same way as the data from "GenerateImage()"), and the size of the blocks it was traced in.
+//The data is only valid until the callback returns.
+typedef void (*rt_PreviewPassCallback)(const float* img, unsigned int blockSize);
+//Quickly generates a preview of the image with one sample per pixel, for interactive camera moves.
+//The image is traced from coarse to fine: first one pixel in every 8x8 block, then every 4x4, 2x2,
+//    and finally every pixel, reusing the pixels traced by earlier passes.
+//After each pass, "onPass" is given the image with every block filled in by its traced pixel,
+//    so it can be shown right away.
+//The arguments are the same as "GenerateImage()", and the settings of "SetAdaptiveSampling()"
+//    and "SetCropWindow()" aren't used. Returns once the full-resolution pass is done.
+//The scene is kept loaded between calls until a different path is given or its file changes,
+//    so repeated previews (e.x. while moving the camera) don't re-read it.
+//If the scene can't be loaded, returns without calling "onPass".
+C_RT_API void rt_GeneratePreviewImage(unsigned int imgWidth, unsigned int imgHeight,
+                                      unsigned int maxBounces, unsigned int nThreads,
+                                      float vertFOVDegrees, float aperture, float focusDist,
+                                      float camPosX, float camPosY, float camPosZ,
+                                      float camForwardX, float camForwardY, float camForwardZ,
+                                      float camUpX, float camUpY, float camUpZ,
+                                      const char* sceneJSONPath,
+                                      rt_PreviewPassCallback onPass);
+
+//Sets the folder that built BVHs are cached in, so that later calls to "GenerateImage()"
+//    don't have to rebuild them for geometry that hasn't changed.
+//The folder must already exist. Pass null or an empty string to disable the cache (the default).
+C_RT_API void rt_SetBVHCacheFolder(const char* folderPath);
+
+//Sets whether meshes build their BVHs with spatial splits, unless a mesh picks for itself.
+//Spatial splits make meshes with long, thin triangles much faster to trace, but take longer to build.
+//"budget" is how many extra triangle references may be made, as a fraction of each mesh's triangle count.
+//Spatial splits are disabled by default.
+C_RT_API void rt_SetSpatialSplits(int enabled, float budget);
+
+//Sets how the random numbers for each pixel's samples are picked:
+//0 is independent random numbers, 1 is Owen-scrambled Sobol points (the default),
+//    and 2 is Sobol points shifted per pixel by blue noise, for finer-grained noise at low sample counts.
+C_RT_API void rt_SetSampler(int samplerType);
+
+//Makes "GenerateImage()" spend more samples on the pixels that need them.
+//Every pixel gets "samplesPerPixel" samples, then pixels keep getting more samples in passes
+//    until their estimated error (relative to their brightness, e.x. 0.01 for 1%) is below "targetError",
+//    or until they have "maxSamplesPerPixel" samples.
+//Pass 0 for "targetError" to disable adaptive sampling (the default).
+C_RT_API void rt_SetAdaptiveSampling(float targetError, unsigned int maxSamplesPerPixel);
+
+//Makes "GenerateImage()" render only the given rectangle of the image,
+//    keeping the projection of the whole image's camera.
+//While a crop window is set, "GenerateImage()" only returns the rectangle's pixels ("width * height * 3" floats),
+//    and adaptive sampling isn't used.
+//Pass 0 for "width" or "height" to render the whole image again (the default).
+C_RT_API void rt_SetCropWindow(unsigned int minX, unsigned int minY, unsigned int width, unsigned int height);
+
 //Frees up the data returned by "GenerateImage()".
 //Failing to call this when finished with the data results in a memory leak.
 C_RT_API void rt_ReleaseImage(float* img);
@@ -40,7 +94,8 @@ C_RT_API void rt_ReleaseImage(float* img);
 //The code that represents "everything was successful!"
 C_RT_API unsigned char rt_ERRORCODE_SUCCESS();
 //The code that represents "The texture is not large enough to be traced successfully".
-//This can happen if the width is 0 or the height is less than the number of threads to use.
+//This can happen if the width is 0 or the height is less than the number of threads to use,
+//    or if the crop window doesn't fit inside the image.
 C_RT_API unsigned char rt_ERRORCODE_BAD_SIZE();
 //'nThreads' or 'samplesPerPixel' is 0, or 'vertFOVDegrees' is non-positive.
 C_RT_API unsigned char rt_ERRORCODE_BAD_VALUE();
@@ -17,7 +17,8 @@ namespace RT
         const Vector3f& GetDir() const { return dir; }
 
         Vector3f GetPos(float t) const { return pos + (dir * t); }
-        float GetT(Vector3f posAlongRay) const { return dir.Dot(posAlongRay - pos); }
+        //The inverse of "GetPos(t)". Works for rays that aren't normalized.
+        float GetT(Vector3f posAlongRay) const { return dir.Dot(posAlongRay - pos) / dir.Dot(dir); }
 
 
         void SetPos(const Vector3f& newPos) { pos = newPos; }
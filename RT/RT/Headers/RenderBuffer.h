@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+
+#include "Texture2D.h"
+#include "RTString.h"
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //Accumulates the samples of an image as it's rendered, so more samples can be added to any pixel later.
+    //Also tracks how noisy each pixel's samples are, to estimate how far the pixel is from converging.
+    class RT_API RenderBuffer
+    {
+    public:
+
+        //When estimating a pixel's error relative to its brightness,
+        //    pixels darker than this are treated as being this bright,
+        //    so that nearly-black pixels don't soak up samples chasing invisible noise.
+        static const float MinErrorLuminance;
+
+        static float GetLuminance(const Vector3f& color)
+            { return (0.2126f * color.x) + (0.7152f * color.y) + (0.0722f * color.z); }
+
+
+        RenderBuffer(size_t width = 0, size_t height = 0) { Resize(width, height); }
+
+
+        size_t GetWidth() const { return width; }
+        size_t GetHeight() const { return height; }
+
+        //Changes the size of this buffer and removes all samples from it.
+        void Resize(size_t newWidth, size_t newHeight);
+        //Removes all samples from this buffer.
+        void Clear();
+
+        void AddSample(size_t x, size_t y, const Vector3f& color)
+        {
+            Pixel& p = pixels[x + (y * width)];
+            float luminance = GetLuminance(color);
+            p.ColorSum += color;
+            p.LuminanceSqrSum += luminance * luminance;
+            p.NSamples += 1;
+        }
+
+        unsigned int GetNSamples(size_t x, size_t y) const { return pixels[x + (y * width)].NSamples; }
+        //Gets the total number of samples in every pixel.
+        size_t GetTotalSamples() const;
+
+        //Gets the average of the given pixel's samples, or black if it has none.
+        Vector3f GetColor(size_t x, size_t y) const;
+        //Estimates how far the given pixel's average brightness is from the true value,
+        //    as the standard error of the mean relative to the pixel's brightness.
+        //Returns infinity if the pixel has fewer than two samples.
+        float GetRelativeError(size_t x, size_t y) const;
+
+        //Writes the average color of each pixel into the given texture, which must be the same size.
+        void CopyTo(Texture2D& outTex) const;
+
+        //Saves every pixel's samples to a binary file, so that rendering can be resumed later.
+        //"settingsHash" should identify everything that affects the samples (the scene, camera, sampler, etc.),
+        //    so that a checkpoint can't be resumed with different settings.
+        //The file is replaced all at once, so an interrupted save never leaves a half-written checkpoint.
+        //Returns an error message, or the empty string if it succeeded.
+        String SaveCheckpoint(const String& path, unsigned long long settingsHash) const;
+        //Replaces this buffer's size and samples with those from a file written by "SaveCheckpoint()".
+        //Fails if the file was saved with a different "settingsHash".
+        //Returns an error message, or the empty string if it succeeded.
+        String LoadCheckpoint(const String& path, unsigned long long settingsHash);
+
+
+    private:
+
+        struct Pixel
+        {
+            Vector3f ColorSum;
+            float LuminanceSqrSum = 0.0f;
+            unsigned int NSamples = 0;
+        };
+
+        size_t width = 0, height = 0;
+        std::vector<Pixel> pixels;
+    };
+}
+
+#pragma warning(default: 4251)
\ No newline at end of file
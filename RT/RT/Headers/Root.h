@@ -9,7 +9,8 @@
 //This namespace defines a Bounding Volume Hierarchy -- a spacial data structure.
 namespace BVH
 {
-    //TOOD: Template parameter for number of child nodes (default is 2 for binary tree). Use template parameter so that child references are stored on the stack with the Node instance.
+    //NOTE: This tree isn't used by the tracer, which uses "RT::BVHTree" instead.
+    //    Wider nodes (the old TODO here) are done by "RT::WideBVH<Width>", which collapses a built BVHTree.
 
     //"T" is the type of element being stored in this BVH.
     //"BoundsType" is the type of bounding space. Should have the same interface as "BVH::Bounds<>".
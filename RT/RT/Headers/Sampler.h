@@ -0,0 +1,87 @@
+#pragma once
+
+#include "FastRand.h"
+
+
+namespace RT
+{
+    //Generates the random numbers used to render one sample of one pixel.
+    //Each random number comes from the next "dimension" of the sample.
+    //Samplers that know which pixel, sample, and dimension a number is for
+    //    can spread the numbers out much more evenly than independent random numbers,
+    //    which makes images converge with fewer samples.
+    //A sampler is used by one thread at a time.
+    class RT_API Sampler
+    {
+    public:
+
+        enum Types
+        {
+            //Independent random numbers for every sample.
+            Random,
+            //Owen-scrambled Sobol points, scrambled differently for every pixel.
+            Sobol,
+            //Owen-scrambled Sobol points that are the same for every pixel,
+            //    then shifted per pixel by a blue-noise pattern
+            //    so that the leftover error looks like fine, even grain instead of clumps.
+            BlueNoiseSobol,
+        };
+
+        //The type of sampler that images are rendered with, unless a different one is asked for.
+        static Types DefaultType;
+
+        //Allocates a new sampler of the given type on the heap.
+        static Sampler* Create(Types type);
+
+
+        virtual ~Sampler() { }
+
+
+        //Starts generating the numbers for the given sample of the given pixel, at dimension 0.
+        virtual void StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int sampleIndex) = 0;
+
+        //Skips ahead to the given dimension, unless it was already passed.
+        //Used to line up the dimensions of different samples, e.x. so that each bounce of a path starts
+        //    at the same dimension no matter how many numbers the bounces before it used.
+        void SkipToDimension(unsigned int newDimension) { dimension = (newDimension > dimension ? newDimension : dimension); }
+        unsigned int GetDimension() const { return dimension; }
+
+        //Gets a number between 0 and 1 from the next dimension.
+        virtual float NextFloat() = 0;
+        //Gets a point in the unit square from the next pair of dimensions.
+        //Numbers that are used together should come from the same call to this,
+        //    so that they're spread out evenly as a pair and not just individually.
+        virtual Vector2f Next2D() = 0;
+
+        //Gets a random vector of length 1.
+        Vector3f NextUnitVector3()
+        {
+            Vector2f t = Next2D();
+            float theta = 2.0f * (float)M_PI * t.x,
+                  z = -1.0f + (2.0f * t.y),
+                  temp = sqrt(1.0f - (z * z));
+            return Vector3f(cosf(theta) * temp, sinf(theta) * temp, z);
+        }
+        //Gets a random vector of length 1.
+        Vector2f NextUnitVector2()
+        {
+            float angle = 2.0f * (float)M_PI * NextFloat();
+            return Vector2f(sinf(angle), cosf(angle));
+        }
+        //Gets a random vector of length between 0 and 1.
+        Vector2f NextVector2()
+        {
+            return NextUnitVector2() * NextFloat();
+        }
+
+        //Gets a plain random number generator for the current sample,
+        //    for things that need an unknown number of random numbers, e.x. walking through a medium.
+        FastRand& GetPRNG() { return prng; }
+
+
+    protected:
+
+        unsigned int dimension = 0;
+        FastRand prng;
+    };
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Sampler.h"
+
+
+namespace RT
+{
+    //Independent random numbers, from a separate "FastRand" stream for each sample of each pixel.
+    class RT_API Sampler_Random : public Sampler
+    {
+    public:
+
+        Sampler_Random() { }
+        //Makes a sampler that's already started, drawing from a stream with the given seed.
+        //Used to pass a plain random number generator to things that want a sampler.
+        Sampler_Random(int seed) { prng = FastRand(seed); }
+
+
+        virtual void StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int sampleIndex) override;
+
+        virtual float NextFloat() override { dimension += 1; return prng.NextFloat(); }
+        virtual Vector2f Next2D() override
+        {
+            dimension += 2;
+            float x = prng.NextFloat();
+            float y = prng.NextFloat();
+            return Vector2f(x, y);
+        }
+    };
+
+
+    //Owen-scrambled Sobol points, using the first two Sobol dimensions
+    //    for each pair of numbers and a different random scramble for every dimension and pixel.
+    //Based on "Practical Hash-based Owen Scrambling" (Burley, 2020).
+    class RT_API Sampler_Sobol : public Sampler
+    {
+    public:
+
+        virtual void StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int sampleIndex) override;
+
+        virtual float NextFloat() override;
+        virtual Vector2f Next2D() override;
+
+
+    protected:
+
+        unsigned int pixelSeed = 0, sampleIndex = 0;
+
+        //Gets the scrambled Sobol point for the current sample in the given dimension.
+        //Outputs both Sobol dimensions; the second is only computed if "outY" isn't null.
+        void GetPoint(unsigned int dimension, float& outX, float* outY) const;
+    };
+
+
+    //Owen-scrambled Sobol points that are scrambled the same way for every pixel,
+    //    then offset per pixel and dimension by a tiling blue-noise texture.
+    //Neighboring pixels end up with very different offsets,
+    //    so the error at low sample counts looks like fine, even grain instead of clumps.
+    class RT_API Sampler_BlueNoise : public Sampler_Sobol
+    {
+    public:
+
+        //The width and height of the tiling blue-noise texture.
+        static const unsigned int TileSize = 64;
+
+
+        virtual void StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int sampleIndex) override;
+
+        virtual float NextFloat() override;
+        virtual Vector2f Next2D() override;
+
+
+    private:
+
+        unsigned int pixelX = 0, pixelY = 0;
+
+        //Gets the blue-noise offset of this sampler's pixel for the given dimension.
+        float GetOffset(unsigned int dimension) const;
+    };
+}
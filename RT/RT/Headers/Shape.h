@@ -5,6 +5,7 @@
 #include "Transform.h"
 #include "DataSerialization.h"
 #include "FastRand.h"
+#include "SmartPtrs.h"
 
 
 
@@ -34,6 +35,10 @@ namespace RT
             outShpe = Create(typeName);
             reader.ReadDataStructure(*outShpe, name + "Value");
         }
+        //Reads the given shape from the given DataReader.
+        //If "shpe" already holds a shape of the same type, that shape is read into instead of making a new one,
+        //    so it keeps any acceleration structures that "UpdatePrecalcData()" can reuse.
+        static void ReadValue(SharedPtr<Shape>& shpe, DataReader& reader, const String& name);
 
 
         Transform Tr;
@@ -45,12 +50,23 @@ namespace RT
 
 
         virtual void PrecalcData() { }
+        //Updates the precomputed data after this shape's transform or geometry changed,
+        //    reusing any acceleration structures where possible instead of building them from scratch.
+        virtual void UpdatePrecalcData() { PrecalcData(); }
 
         virtual void GetBoundingBox(BoundingBox& outBox) const = 0;
         virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                              float tMin = 0.0f,
                              float tMax = std::numeric_limits<float>::infinity()) const = 0;
 
+        //Finds the first two places along the given ray's whole line (including behind its start)
+        //    where it crosses this shape's surface, which for a closed shape are where the line enters and exits it.
+        //Crossings less than "minThickness" apart count as the same one.
+        //Returns whether both crossings were found.
+        //The default implementation casts the ray twice; shapes should override it to find both in one pass.
+        virtual bool CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                                     float& outEnterT, float& outExitT) const;
+
 
         virtual void WriteData(DataWriter& writer) const override { writer.WriteDataStructure(Tr, "Transform"); }
         virtual void ReadData(DataReader& reader) override { reader.ReadDataStructure(Tr, "Transform"); }
@@ -71,6 +87,8 @@ namespace RT
         //Used by the serialization system.
         static ShapeFactory GetFactory(const String& typeName);
     };
+
+    EXPORT_SHAREDPTR(Shape);
 }
 
 
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Main.hpp"
-#include "FastRand.h"
+#include "Sampler.h"
 #include "Ray.h"
 #include "SmartPtrs.h"
 #include "DataSerialization.h"
@@ -35,7 +35,7 @@ namespace RT
 
 
         //Gets the color of the sky using the given ray.
-        virtual Vector3f GetColor(const Ray& ray, FastRand& prng) const = 0;
+        virtual Vector3f GetColor(const Ray& ray, Sampler& sampler) const = 0;
 
         virtual void ReadData(DataReader& data) override { }
         virtual void WriteData(DataWriter& data) const override { }
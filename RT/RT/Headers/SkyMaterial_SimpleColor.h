@@ -17,7 +17,7 @@ namespace RT
             : Color(col) { }
 
 
-        virtual Vector3f GetColor(const Ray& ray, FastRand& prng) const override;
+        virtual Vector3f GetColor(const Ray& ray, Sampler& sampler) const override;
 
 
         virtual void WriteData(DataWriter& writer) const override;
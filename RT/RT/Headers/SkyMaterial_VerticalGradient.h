@@ -20,7 +20,7 @@ namespace RT
             : BottomCol(bottomCol), TopCol(topCol), SkyDir(skyDir) { }
 
 
-        virtual Vector3f GetColor(const Ray& ray, FastRand& prng) const override;
+        virtual Vector3f GetColor(const Ray& ray, Sampler& sampler) const override;
 
 
         virtual void WriteData(DataWriter& writer) const override;
@@ -19,12 +19,21 @@ namespace RT
         Sphere(Vector3f pos, float radius) { Tr.ScaleBy(radius); Tr.SetPos(pos); }
 
 
+        //Fills in the normal, tangent, bitangent, and UV of a point on the surface of a sphere,
+        //    given its normal in the sphere's local space and in world space.
+        static void GetSurfaceData(unsigned char wrapAxis,
+                                   const Vector3f& localNormal, const Vector3f& worldNormal,
+                                   Vertex& outV);
+
+
         virtual void PrecalcData() override;
 
         virtual void GetBoundingBox(BoundingBox& outB) const override;
         virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                              float tMin = 0.0f,
                              float tMax = std::numeric_limits<float>::infinity()) const override;
+        virtual bool CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                                     float& outEnterT, float& outExitT) const override;
 
 
         virtual void WriteData(DataWriter& writer) const override;
@@ -35,7 +44,15 @@ namespace RT
 
         BoundingBox bounds;
 
+        //If this sphere's scale is uniform, it's still a sphere in world space,
+        //    so rays can be intersected with it directly instead of being transformed into local space.
+        bool isUniform;
+        Vector3f worldCenter;
+        float worldRadius;
+        bool isRotated;
+
         void FillInData(Vertex& hitPos, Vector3f localIntersectPos, Vector3f worldIntersectPos) const;
+        bool CastRayUniform(const Ray& ray, Vertex& outHit, float tMin, float tMax) const;
 
 
         ADD_SHAPE_REFLECTION_DATA_H(Sphere);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Shape.h"
+#include "List.h"
+#include "BVHTree.h"
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A large number of spheres with the same material, e.x. particles.
+    //The spheres are stored in groups of 8, with each group's positions and radii in separate arrays,
+    //    so a ray can be tested against a whole group at once with SIMD instructions.
+    //A BVH is built over the groups, and is cached like a mesh's BVH.
+    class RT_API SphereBatch : public Shape
+    {
+    public:
+
+        static const unsigned int GroupSize = 8;
+
+
+        //Every four floats are one sphere, in local space: the X, Y, and Z of its center, then its radius.
+        List<float> Spheres;
+
+        //The axis that each sphere's UV's are wrapped around.
+        //0 = X, 1 = Y, 2 = Z.
+        unsigned char WrapAxis = 1;
+
+
+        SphereBatch() { }
+
+
+        size_t GetNSpheres() const { return Spheres.GetSize() / 4; }
+        void AddSphere(const Vector3f& center, float radius)
+        {
+            Spheres.PushBack(center.x);
+            Spheres.PushBack(center.y);
+            Spheres.PushBack(center.z);
+            Spheres.PushBack(radius);
+        }
+
+
+        virtual void PrecalcData() override;
+
+        virtual void GetBoundingBox(BoundingBox& outB) const override { outB = worldBounds; }
+        virtual bool CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                             float tMin = 0.0f,
+                             float tMax = std::numeric_limits<float>::infinity()) const override;
+
+
+        virtual void WriteData(DataWriter& writer) const override;
+        virtual void ReadData(DataReader& reader) override;
+
+
+    private:
+
+        struct Group
+        {
+            float X[GroupSize], Y[GroupSize], Z[GroupSize],
+                  Radius[GroupSize];
+            //The number of spheres actually in this group. The rest of its slots are never hit.
+            unsigned int NSpheres;
+        };
+
+        //Spatially close spheres are put in the same group.
+        std::vector<Group> groups;
+        BVHTree bvh;
+
+        BoundingBox worldBounds;
+
+
+        //Finds the closest sphere in the given group that the given (local-space) ray hits within [tMin, tMax].
+        //"invDirLengthSqr" is 1 over the squared length of the ray's direction.
+        //Returns the index of that sphere in the group, or -1 if none were hit.
+        static int CastRay(const Group& group, const Ray& ray, float invDirLengthSqr,
+                           float tMin, float tMax, float& outT);
+
+
+        ADD_SHAPE_REFLECTION_DATA_H(SphereBatch);
+    };
+}
+
+#pragma warning(default: 4251)
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Main.hpp"
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A set of worker threads that loops can be split across.
+    //The thread that starts a job also helps run it,
+    //    so a job may safely start more jobs on the same pool.
+    class RT_API ThreadPool
+    {
+    public:
+
+        //Gets a pool shared by the whole library, with one thread per hardware thread.
+        static ThreadPool& GetGlobal();
+
+
+        //"nThreads" is the total number of threads that work on each job,
+        //    including the thread that started the job.
+        //Passing 0 uses one thread per hardware thread.
+        ThreadPool(size_t nThreads = 0);
+        ~ThreadPool();
+
+
+        size_t GetNThreads() const { return workers.size() + 1; }
+
+        //Runs "job(i)" for every "i" from 0 to "count - 1", split across this pool's threads.
+        //Blocks until every index has finished.
+        //If the job throws, the indices that haven't started yet are skipped,
+        //    and the first exception is rethrown here once the others have finished.
+        void ParallelFor(size_t count, const std::function<void(size_t i)>& job);
+        //Splits the range [0, count) into contiguous chunks of at least "minChunkSize" elements,
+        //    then runs "job(start, end)" for every chunk, split across this pool's threads.
+        //Blocks until every chunk has finished.
+        void ParallelForRanges(size_t count, size_t minChunkSize,
+                               const std::function<void(size_t start, size_t end)>& job);
+
+
+    private:
+
+        struct Batch;
+
+
+        std::vector<std::thread> workers;
+
+        std::mutex mutx;
+        std::condition_variable hasWork, finishedWork;
+        std::deque<std::shared_ptr<Batch>> batches;
+        bool isStopping = false;
+
+
+        void RunWorker();
+        void RunBatch(Batch& batch);
+
+
+        ThreadPool(const ThreadPool& cpy) = delete;
+        ThreadPool& operator=(const ThreadPool& cpy) = delete;
+    };
+}
+
+#pragma warning(default: 4251)
@@ -1,20 +1,27 @@
 #pragma once
 
 
+#include <vector>
+#include <functional>
+
 #include "List.h"
 
 #include "Material.h"
 #include "SkyMaterial.h"
+#include "Sampler.h"
 
 #include "Camera.h"
 #include "Texture2D.h"
+#include "RenderBuffer.h"
+#include "AOVBuffers.h"
+#include "ThreadPool.h"
 #include "SmartPtrs.h"
 #include "DataSerialization.h"
+#include "BVHTree.h"
 
 
 namespace RT
 {
-    EXPORT_SHAREDPTR(Shape);
     EXPORT_SHAREDPTR(Material);
 
     //A shape and its material.
@@ -38,6 +45,8 @@ namespace RT
     EXPORT_RT_LIST(ShapeAndMat);
 }
 
+#pragma warning(disable: 4251)
+
 namespace RT
 {
     EXPORT_SHAREDPTR(SkyMaterial);
@@ -48,6 +57,12 @@ namespace RT
     public:
 
 
+        //When rendering adaptively, pixels are judged in square tiles of this size.
+        static const size_t AdaptiveTileSize = 8;
+        //When rendering a preview, the first pass traces one pixel in every square block of this size.
+        static const size_t PreviewFirstBlockSize = 8;
+
+
         //Used to get the color when a ray doesn't hit anything.
         SharedPtr<SkyMaterial> SkyMat;
     
@@ -59,9 +74,15 @@ namespace RT
         Tracer(SkyMaterial* skyMat, const List<ShapeAndMat>& objects);
 
 
-        //Precomputes some data for all the shapes in this tracer.
+        //Precomputes some data for all the shapes in this tracer, and builds a BVH out of them.
+        //Shapes that are unbounded, or huge compared to the rest of the scene (e.x. ground planes),
+        //    are kept out of the BVH and tested separately, so they don't bloat its nodes.
         //Call this after all scene objects are finalized and before any tracing is done.
-        void PrecalcData() { for (size_t i = 0; i < Objects.GetSize(); ++i) Objects[i].Shpe->PrecalcData(); }
+        void PrecalcData();
+        //Updates the precomputed data after some objects have moved or changed shape,
+        //    refitting the existing BVHs where possible instead of building new ones.
+        //The objects must have already been precalculated once with "PrecalcData()".
+        void UpdatePrecalcData();
 
         //Traces the given ray through the scene to see what it hits.
         //Returns the shape that was hit, or null if nothing was hit.
@@ -76,26 +97,134 @@ namespace RT
         //Traces the given ray through the scene to see what it hits.
         //Returns whether the ray hit anything.
         //Note that the ray may be redirected as it hits certain kinds of objects.
-        bool TraceRay(size_t bounce, size_t maxBounces, Ray& ray, FastRand& prng,
-                      Vector3f& outColor, Vertex& outHit, float& outDist) const;
+        //Each bounce draws from its own range of the sampler's dimensions.
+        //If "outFeatures" isn't null, it's filled in with what this ray (not its bounces) hit.
+        bool TraceRay(size_t bounce, size_t maxBounces, Ray& ray, Sampler& sampler,
+                      Vector3f& outColor, Vertex& outHit, float& outDist,
+                      AOVBuffers::Pixel* outFeatures = nullptr) const;
 
         //Renders this scene into the given horizontal chunk of the given texture.
+        //If "outAOVs" isn't null, the same chunk of it is filled in too; it must be the same size as the texture.
         void TraceImage(const Camera& cam, Texture2D& outTex,
                         size_t startY, size_t endY, size_t maxBounces,
                         float verticalFOVDegrees, float aperture, float focusDist,
-                        size_t samplesPerPixel) const;
+                        size_t samplesPerPixel,
+                        Sampler::Types samplerType = Sampler::DefaultType,
+                        AOVBuffers* outAOVs = nullptr) const;
 
         //Renders this scene into the given image,
         //    splitting the work across the given number of threads.
+        //If "outAOVs" isn't null, it's filled in during the same pass; it must be the same size as the image.
         //Blocks this thread until finished.
         //Note that passing 1 for the number of threads means that no extra threads will be created.
         void TraceFullImage(const Camera& cam, Texture2D& outTex,
                             size_t nThreads, size_t maxBounces,
                             float verticalFOVDegrees, float aperture, float focusDist,
-                            size_t samplesPerPixel) const;
+                            size_t samplesPerPixel,
+                            Sampler::Types samplerType = Sampler::DefaultType,
+                            AOVBuffers* outAOVs = nullptr) const;
+
+        //Renders only the given rectangle of the image, keeping the projection of the whole image's camera.
+        //"outTex" can either be the size of the rectangle, to get just the cropped image,
+        //    or the size of the whole image, in which case only the rectangle's pixels are changed.
+        //Blocks this thread until finished.
+        void TraceCropImage(const Camera& cam, Texture2D& outTex,
+                            size_t imageWidth, size_t imageHeight,
+                            size_t cropMinX, size_t cropMinY, size_t cropWidth, size_t cropHeight,
+                            size_t nThreads, size_t maxBounces,
+                            float verticalFOVDegrees, float aperture, float focusDist,
+                            size_t samplesPerPixel,
+                            Sampler::Types samplerType = Sampler::DefaultType) const;
+
+        //Adds more samples to the pixels of the given buffer, splitting the rows across the given pool.
+        //"getNSamples(x, y)" gives the number of samples to add to each pixel.
+        //Each pixel's new samples carry on from the ones it already has,
+        //    so splitting samples into more passes doesn't change the result.
+        void TracePass(const Camera& cam, RenderBuffer& buffer, ThreadPool& pool,
+                       size_t maxBounces, float verticalFOVDegrees, float aperture, float focusDist,
+                       const std::function<size_t(size_t x, size_t y)>& getNSamples,
+                       Sampler::Types samplerType = Sampler::DefaultType) const;
+        //Like the other "TracePass()", but the buffer only covers a rectangle of a larger image,
+        //    whose top-left corner is at the given pixel.
+        //The pixels get exactly the same samples as they would when rendering the whole image.
+        //"getNSamples(x, y)" is given coordinates within the buffer.
+        void TracePass(const Camera& cam, RenderBuffer& buffer,
+                       size_t imageWidth, size_t imageHeight, size_t bufferMinX, size_t bufferMinY,
+                       ThreadPool& pool,
+                       size_t maxBounces, float verticalFOVDegrees, float aperture, float focusDist,
+                       const std::function<size_t(size_t x, size_t y)>& getNSamples,
+                       Sampler::Types samplerType = Sampler::DefaultType) const;
+
+        //Renders this scene into the given image, spending more samples on the pixels that need them.
+        //Every pixel gets "minSamples" samples, then more samples are added in passes
+        //    to the tiles of pixels whose estimated error is above "targetError", up to "maxSamples".
+        //The error is the standard error of a pixel's brightness, relative to that brightness
+        //    (e.x. 0.01 means the pixel is probably within 1% of its true brightness).
+        //Blocks this thread until finished. Returns the total number of samples taken.
+        size_t TraceAdaptiveImage(const Camera& cam, Texture2D& outTex,
+                                  size_t nThreads, size_t maxBounces,
+                                  float verticalFOVDegrees, float aperture, float focusDist,
+                                  size_t minSamples, size_t maxSamples, float targetError,
+                                  Sampler::Types samplerType = Sampler::DefaultType) const;
+
+        //Renders this scene into the given image for roughly the given number of seconds,
+        //    adding samples to every pixel in passes until there isn't time for another one.
+        //Every pixel gets at least one sample, even if that takes longer than the budget.
+        //Blocks this thread until finished. Returns the number of samples each pixel got.
+        size_t TraceTimedImage(const Camera& cam, Texture2D& outTex,
+                               size_t nThreads, size_t maxBounces,
+                               float verticalFOVDegrees, float aperture, float focusDist,
+                               float budgetSeconds,
+                               Sampler::Types samplerType = Sampler::DefaultType) const;
+
+        //Adds samples to the given buffer until every pixel has "samplesPerPixel" of them,
+        //    carrying on from whatever samples it already has (e.x. ones loaded from a checkpoint).
+        //Between passes, "onCheckpoint(buffer)" is called whenever "checkpointSeconds" have gone by
+        //    since the last call, and once more when finished.
+        //Each pixel's samples only depend on their index, so the result is exactly the same
+        //    no matter how many times the render is stopped and resumed, or how many threads it uses.
+        //Blocks this thread until finished.
+        void TraceCheckpointedImage(const Camera& cam, RenderBuffer& buffer,
+                                    size_t nThreads, size_t maxBounces,
+                                    float verticalFOVDegrees, float aperture, float focusDist,
+                                    size_t samplesPerPixel, float checkpointSeconds,
+                                    const std::function<void(const RenderBuffer&)>& onCheckpoint,
+                                    Sampler::Types samplerType = Sampler::DefaultType) const;
+
+        //Quickly renders the image at one sample per pixel, from coarse to fine, for interactive previews.
+        //The first pass traces one pixel in every "PreviewFirstBlockSize" block, and each later pass
+        //    halves the block size, only tracing the pixels that the earlier passes didn't.
+        //After each pass, every block is filled with the color of its traced pixel
+        //    and "onPass(outTex, blockSize)" is called, so the image can be shown right away.
+        //The final image is exactly the same as "TraceFullImage()" with one sample per pixel.
+        //Blocks this thread until finished; "onPass" is called on this thread.
+        void TracePreviewImage(const Camera& cam, Texture2D& outTex,
+                               size_t nThreads, size_t maxBounces,
+                               float verticalFOVDegrees, float aperture, float focusDist,
+                               const std::function<void(const Texture2D&, size_t blockSize)>& onPass,
+                               Sampler::Types samplerType = Sampler::DefaultType) const;
 
 
         virtual void ReadData(DataReader& data) override;
         virtual void WriteData(DataWriter& data) const override;
+
+        //Reads this scene's data, like "ReadData()", but reads into the shapes this scene already has
+        //    wherever their types match, so they can keep their BVHs.
+        //Used to load the next frame of an animation, followed by a call to "UpdatePrecalcData()".
+        //Note that any shapes shared with other scenes will be changed too.
+        void ReadDataInPlace(DataReader& data);
+
+
+    private:
+
+        BVHTree objectBVH;
+        //The indices in "Objects" of the shapes in the BVH, and of the shapes kept out of it.
+        //The BVH's primitive indices are indices into "boundedObjects".
+        std::vector<unsigned int> boundedObjects, unboundedObjects;
+
+
+        void ReadData(DataReader& data, bool reuseShapes);
     };
-}
\ No newline at end of file
+}
+
+#pragma warning(default: 4251)
\ No newline at end of file
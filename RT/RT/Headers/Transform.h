@@ -1,6 +1,7 @@
 #pragma once
 
-#include "Matrix4f.h"
+#include "Matrix3x4f.h"
+#include "Ray.h"
 #include "DataSerialization.h"
 
 
@@ -20,16 +21,27 @@ namespace RT
 
         Vector3f Point_WorldToLocal(Vector3f v) const { return toLocal.ApplyPoint(v); }
         Vector3f Dir_WorldToLocal(Vector3f d) const { return toLocal.ApplyVector(d); }
-        Vector3f Normal_WorldToLocal(Vector3f n) const { return toLocal_InverseTranspose.ApplyVector(n); }
+        Vector3f Normal_WorldToLocal(Vector3f n) const { return toWorld.ApplyVectorTransposed(n); }
 
         Vector3f Point_LocalToWorld(Vector3f v) const { return toWorld.ApplyPoint(v); }
         Vector3f Dir_LocalToWorld(Vector3f d) const { return toWorld.ApplyVector(d); }
-        Vector3f Normal_LocalToWorld(Vector3f n) const { return toWorld_InverseTranspose.ApplyVector(n); }
+        Vector3f Normal_LocalToWorld(Vector3f n) const { return toLocal.ApplyVectorTransposed(n); }
 
-        const Matrix4f& GetMatToWorld() const { return toWorld; }
-        const Matrix4f& GetMatToWorld_InverseTranspose() const { return toWorld_InverseTranspose; }
-        const Matrix4f& GetMatToLocal() const { return toLocal; }
-        const Matrix4f& GetWorldToLocal_InverseTranspose() const { return toLocal_InverseTranspose; }
+        //Moves the given ray into local space.
+        //The local ray's direction isn't normalized,
+        //    so that distances along it are the same as distances along the world ray.
+        //Shapes should do this once per ray and reuse the result for all their tests against it.
+        Ray Ray_WorldToLocal(const Ray& r) const { return Ray(Point_WorldToLocal(r.GetPos()),
+                                                              Dir_WorldToLocal(r.GetDir())); }
+
+        const Matrix3x4f& GetAffineToWorld() const { return toWorld; }
+        const Matrix3x4f& GetAffineToLocal() const { return toLocal; }
+
+        //The full 4x4 matrices aren't stored, so these are calculated each time.
+        Matrix4f GetMatToWorld() const { return toWorld.ToMatrix4f(); }
+        Matrix4f GetMatToWorld_InverseTranspose() const;
+        Matrix4f GetMatToLocal() const { return toLocal.ToMatrix4f(); }
+        Matrix4f GetWorldToLocal_InverseTranspose() const;
 
 
         void SetPos(const Vector3f& pos);
@@ -52,9 +64,9 @@ namespace RT
         Vector3f pos, scale;
         Quaternion rot;
 
-        Matrix4f toWorld, toLocal;
-        Matrix4f toWorld_InverseTranspose,
-                 toLocal_InverseTranspose;
+        //The inverse-transpose matrices for normals aren't stored,
+        //    since they're just the transposes of these.
+        Matrix3x4f toWorld, toLocal;
 
         void UpdateMats();
     };
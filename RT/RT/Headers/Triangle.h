@@ -3,6 +3,7 @@
 #include "Vertex.h"
 #include "Ray.h"
 #include "Transform.h"
+#include "BoundingBox.h"
 
 
 namespace RT
@@ -34,6 +35,10 @@ namespace RT
                           float tMin = 0.0f,
                           float tMax = std::numeric_limits<float>::infinity()) const;
 
+        //Gets the bounds of the part of this triangle between "min" and "max" along the given axis (0-2).
+        //Used to build BVHs with spatial splits.
+        BoundingBox GetClippedBounds(int axis, float min, float max) const;
+
 
     private:
 
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <vector>
+#include <assert.h>
+
+#include "BoundingBox.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #include <xmmintrin.h>
+    #define RT_BVH_SIMD 1
+#else
+    #define RT_BVH_SIMD 0
+#endif
+
+
+#pragma warning(disable: 4251)
+
+namespace RT
+{
+    //A BVH whose nodes each have up to "Width" children, made by collapsing a binary BVH.
+    //The children's bounds are stored as separate arrays for each axis,
+    //    so a ray can be tested against all of them at once with SIMD instructions.
+    //Like the binary BVH, the leaves only store ranges of primitive indices,
+    //    and those indices are the same ones the binary BVH uses.
+    //"MaxDepth" is the deepest the binary BVH can get, which limits the size of the stack used when casting rays.
+    template<unsigned int Width, unsigned int MaxDepth>
+    class WideBVH
+    {
+    public:
+
+        static_assert(Width == 4 || Width == 8, "Only 4- and 8-wide BVHs are supported");
+
+        struct Node
+        {
+            float MinX[Width], MinY[Width], MinZ[Width],
+                  MaxX[Width], MaxY[Width], MaxZ[Width];
+
+            //For a leaf child, this is the index of its first primitive index.
+            //Otherwise, this is the index of the child's node.
+            unsigned int Child[Width];
+            //The number of primitives in each child. 0 if the child isn't a leaf.
+            unsigned int NPrims[Width];
+
+            //The number of children this node actually has. Unused slots are never hit.
+            unsigned int NChildren;
+        };
+
+
+        //Collapses the given binary BVH nodes into this tree.
+        //The binary nodes must be laid out like "BVHTree::Node".
+        //Each wide node takes the place of a binary node and up to "Width" of its descendants,
+        //    always opening up the biggest child first.
+        template<typename BinaryNode>
+        void Build(const std::vector<BinaryNode>& binaryNodes)
+        {
+            nodes.clear();
+            if (binaryNodes.empty())
+                return;
+
+            struct ToDo { unsigned int BinaryIndex, WideIndex; };
+            std::vector<ToDo> toDo;
+            toDo.push_back({ 0, 0 });
+            nodes.emplace_back();
+            while (!toDo.empty())
+            {
+                ToDo next = toDo.back();
+                toDo.pop_back();
+
+                //Find the binary nodes that will become this node's children.
+                unsigned int children[Width];
+                unsigned int nChildren = 0;
+                if (binaryNodes[next.BinaryIndex].IsLeaf())
+                {
+                    children[nChildren++] = next.BinaryIndex;
+                }
+                else
+                {
+                    children[nChildren++] = binaryNodes[next.BinaryIndex].Offset;
+                    children[nChildren++] = binaryNodes[next.BinaryIndex].Offset + 1;
+                    while (nChildren < Width)
+                    {
+                        int biggest = -1;
+                        float biggestArea = -1.0f;
+                        for (unsigned int i = 0; i < nChildren; ++i)
+                        {
+                            const BinaryNode& child = binaryNodes[children[i]];
+                            if (!child.IsLeaf() && child.Bounds.GetSurfaceArea() > biggestArea)
+                            {
+                                biggest = (int)i;
+                                biggestArea = child.Bounds.GetSurfaceArea();
+                            }
+                        }
+                        if (biggest < 0)
+                            break;
+
+                        unsigned int opened = children[biggest];
+                        children[biggest] = binaryNodes[opened].Offset;
+                        children[nChildren++] = binaryNodes[opened].Offset + 1;
+                    }
+                }
+
+                //Fill in the node. Note that adding nodes may move the existing ones.
+                for (unsigned int i = 0; i < Width; ++i)
+                {
+                    BoundingBox bounds;
+                    unsigned int child = 0,
+                                 nPrims = 0;
+                    if (i < nChildren)
+                    {
+                        const BinaryNode& binaryChild = binaryNodes[children[i]];
+                        bounds = binaryChild.Bounds;
+                        if (binaryChild.IsLeaf())
+                        {
+                            child = binaryChild.Offset;
+                            nPrims = binaryChild.NPrims;
+                        }
+                        else
+                        {
+                            child = (unsigned int)nodes.size();
+                            nodes.emplace_back();
+                            toDo.push_back({ children[i], child });
+                        }
+                    }
+
+                    Node& node = nodes[next.WideIndex];
+                    node.MinX[i] = bounds.Min.x; node.MinY[i] = bounds.Min.y; node.MinZ[i] = bounds.Min.z;
+                    node.MaxX[i] = bounds.Max.x; node.MaxY[i] = bounds.Max.y; node.MaxZ[i] = bounds.Max.z;
+                    node.Child[i] = child;
+                    node.NPrims[i] = nPrims;
+                }
+                nodes[next.WideIndex].NChildren = nChildren;
+            }
+        }
+
+        bool IsEmpty() const { return nodes.empty(); }
+        const std::vector<Node>& GetNodes() const { return nodes; }
+
+
+        //Finds every primitive whose bounds the given ray passes through within [tMin, tMax],
+        //    roughly in order from nearest to farthest.
+        //Works the same way as "BVHTree::CastRay()";
+        //    "primIndices" are the primitive indices of the binary tree this one was built from.
+        //If "outNBoxTests" isn't null, the number of child bounds the ray was tested against is added to it.
+        template<typename PrimTester>
+        bool CastRay(const Ray& ray, float tMin, float tMax,
+                     const unsigned int* primIndices, PrimTester testPrim,
+                     size_t* outNBoxTests = nullptr) const
+        {
+            if (nodes.empty())
+                return false;
+
+            Vector3f rayPos = ray.GetPos(),
+                     invRayDir = ray.GetDir().Reciprocal();
+
+            //Nodes and leaves that still need to be checked, along with the distance where the ray enters them.
+            //If "NPrims" is 0, "Index" is a node. Otherwise it's the start of a leaf's primitives.
+            struct StackEntry { unsigned int Index, NPrims; float TEnter; };
+            //Collapsing never makes the tree deeper, and each node adds at most "Width - 1" entries.
+            const size_t stackSize = MaxDepth * (Width - 1) + 2;
+            StackEntry stack[stackSize];
+            size_t stackCount = 0;
+            stack[stackCount++] = { 0, 0, tMin };
+
+            bool hitAnything = false;
+            while (stackCount > 0)
+            {
+                StackEntry entry = stack[--stackCount];
+
+                //If something closer was hit since this entry was found, skip it.
+                if (entry.TEnter > tMax)
+                    continue;
+
+                if (entry.NPrims > 0)
+                {
+                    for (unsigned int i = 0; i < entry.NPrims; ++i)
+                        if (testPrim(primIndices[entry.Index + i], tMax))
+                            hitAnything = true;
+                    continue;
+                }
+
+                const Node& node = nodes[entry.Index];
+                if (outNBoxTests != nullptr)
+                    *outNBoxTests += Width;
+
+                float tEnters[Width];
+                unsigned int hitMask = IntersectChildren(node, rayPos, invRayDir, tMin, tMax, tEnters);
+
+                //Sort the hit children from farthest to nearest,
+                //    so the nearest one ends up on top of the stack.
+                unsigned int sorted[Width];
+                unsigned int nSorted = 0;
+                for (unsigned int i = 0; i < node.NChildren; ++i)
+                {
+                    if ((hitMask & (1 << i)) == 0)
+                        continue;
+
+                    unsigned int j = nSorted++;
+                    for (; j > 0 && tEnters[sorted[j - 1]] < tEnters[i]; --j)
+                        sorted[j] = sorted[j - 1];
+                    sorted[j] = i;
+                }
+
+                assert(stackCount + nSorted <= stackSize);
+                for (unsigned int i = 0; i < nSorted; ++i)
+                {
+                    unsigned int child = sorted[i];
+                    stack[stackCount++] = { node.Child[child], node.NPrims[child], tEnters[child] };
+                }
+            }
+
+            return hitAnything;
+        }
+
+
+    private:
+
+        std::vector<Node> nodes;
+
+
+        //Tests the given ray against every child of the given node at once.
+        //Outputs the "t" value where the ray enters each child (clamped to "tMin").
+        //Returns a bitmask of the children that were hit.
+        //Follows the same rules as "BoundingBox::RayIntersects()", including how NaN values are ignored.
+        static unsigned int IntersectChildren(const Node& node,
+                                              const Vector3f& rayPos, const Vector3f& invRayDir,
+                                              float tMin, float tMax, float* outTEnters)
+        {
+            unsigned int mask = 0;
+
+#if RT_BVH_SIMD
+            __m128 posX = _mm_set1_ps(rayPos.x), posY = _mm_set1_ps(rayPos.y), posZ = _mm_set1_ps(rayPos.z),
+                   invX = _mm_set1_ps(invRayDir.x), invY = _mm_set1_ps(invRayDir.y), invZ = _mm_set1_ps(invRayDir.z),
+                   tMins = _mm_set1_ps(tMin), tMaxes = _mm_set1_ps(tMax);
+
+            //"_mm_min_ps(a, b)" is "(a < b) ? a : b", so it returns "b" if either one is NaN
+            //    (and "_mm_max_ps()" works the same way).
+            //That makes "_mm_min_ps(b, a)" exactly "BoundingBox::FastMin(a, b)", which returns "a" if "b" is NaN,
+            //    so the operands here are swapped from the scalar version to get the same results, NaN included.
+            for (unsigned int i = 0; i < Width; i += 4)
+            {
+                __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinX + i), posX), invX),
+                       tx2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxX + i), posX), invX),
+                       ty1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinY + i), posY), invY),
+                       ty2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxY + i), posY), invY),
+                       tz1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MinZ + i), posZ), invZ),
+                       tz2 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.MaxZ + i), posZ), invZ);
+
+                __m128 tEnter = _mm_max_ps(_mm_min_ps(tx2, tx1), tMins),
+                       tExit = _mm_min_ps(_mm_max_ps(tx2, tx1), tMaxes);
+                tEnter = _mm_max_ps(_mm_min_ps(ty2, ty1), tEnter);
+                tExit = _mm_min_ps(_mm_max_ps(ty2, ty1), tExit);
+                tEnter = _mm_max_ps(_mm_min_ps(tz2, tz1), tEnter);
+                tExit = _mm_min_ps(_mm_max_ps(tz2, tz1), tExit);
+
+                _mm_storeu_ps(outTEnters + i, tEnter);
+                mask |= (unsigned int)_mm_movemask_ps(_mm_cmple_ps(tEnter, tExit)) << i;
+            }
+#else
+            for (unsigned int i = 0; i < Width; ++i)
+            {
+                BoundingBox box(Vector3f(node.MinX[i], node.MinY[i], node.MinZ[i]),
+                                Vector3f(node.MaxX[i], node.MaxY[i], node.MaxZ[i]));
+                if (box.RayIntersects(rayPos, invRayDir, tMin, tMax, outTEnters[i]))
+                    mask |= (1 << i);
+            }
+#endif
+
+            return mask & ((1 << node.NChildren) - 1);
+        }
+    };
+}
+
+#pragma warning(default: 4251)
@@ -0,0 +1,80 @@
+#include "../Headers/AOVBuffers.h"
+
+#include <assert.h>
+#include <cmath>
+#include <algorithm>
+
+using namespace RT;
+
+
+void AOVBuffers::Resize(size_t newWidth, size_t newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    pixels.assign(width * height, Pixel());
+}
+
+void AOVBuffers::CopyAlbedoTo(Texture2D& outTex) const
+{
+    assert(outTex.GetWidth() == width && outTex.GetHeight() == height);
+    for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+            outTex.SetColor(x, y, Get(x, y).Albedo);
+}
+void AOVBuffers::CopyNormalsTo(Texture2D& outTex) const
+{
+    assert(outTex.GetWidth() == width && outTex.GetHeight() == height);
+    for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+            outTex.SetColor(x, y, (Get(x, y).Normal * 0.5f) + Vector3f(0.5f, 0.5f, 0.5f));
+}
+void AOVBuffers::CopyDepthTo(Texture2D& outTex) const
+{
+    assert(outTex.GetWidth() == width && outTex.GetHeight() == height);
+
+    //Scaling by the farthest depth would make everything black next to a ground plane
+    //    that stretches to the horizon, so the median depth is used as the midpoint instead.
+    std::vector<float> depths;
+    for (const Pixel& p : pixels)
+        if (std::isfinite(p.Depth))
+            depths.push_back(p.Depth);
+    float medianDepth = 1.0f;
+    if (!depths.empty())
+    {
+        std::nth_element(depths.begin(), depths.begin() + (depths.size() / 2), depths.end());
+        medianDepth = std::max(depths[depths.size() / 2], 0.0001f);
+    }
+
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            float depth = Get(x, y).Depth;
+            float brightness = (std::isfinite(depth) ? depth / (depth + medianDepth) : 1.0f);
+            outTex.SetColor(x, y, Vector3f(brightness, brightness, brightness));
+        }
+    }
+}
+void AOVBuffers::CopyObjectIndicesTo(Texture2D& outTex) const
+{
+    assert(outTex.GetWidth() == width && outTex.GetHeight() == height);
+    for (size_t y = 0; y < height; ++y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            int index = Get(x, y).ObjectIndex;
+            if (index == NoObject)
+            {
+                outTex.SetColor(x, y, Vector3f());
+                continue;
+            }
+
+            //Scramble the index so that neighboring objects get very different colors.
+            unsigned int hash = (unsigned int)index * 2654435761u;
+            hash ^= hash >> 15;
+            outTex.SetColor(x, y, Vector3f((float)(hash & 0xff) / 255.0f,
+                                           (float)((hash >> 8) & 0xff) / 255.0f,
+                                           (float)((hash >> 16) & 0xff) / 255.0f));
+        }
+    }
+}
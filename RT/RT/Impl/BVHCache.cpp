@@ -0,0 +1,170 @@
+#include "../Headers/BVHCache.h"
+
+#include <fstream>
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef OS_WINDOWS
+    #include <unistd.h>
+#endif
+
+using namespace RT;
+
+
+namespace
+{
+    String cacheFolder;
+
+    //Identifies the file format, and must be changed whenever BVHTree's data layout changes.
+    const char fileMagic[8] = { 'R', 'T', 'B', 'V', 'H', '0', '0', '2' };
+
+    struct FileHeader
+    {
+        char Magic[8];
+        unsigned long long Hash;
+        unsigned long long NNodes, NPrims;
+        //Trees built with spatial splits can have more primitive indices than primitives.
+        unsigned long long NPrimIndices;
+        unsigned long long NodeSize;
+    };
+
+
+    String GetFilePath(const String& category, unsigned long long hash)
+    {
+        char hashStr[17];
+        snprintf(hashStr, sizeof(hashStr), "%016llx", hash);
+
+        String path = cacheFolder;
+        if (path[path.GetSize() - 1] != '/' && path[path.GetSize() - 1] != '\\')
+            path += "/";
+        return path + category + "_" + hashStr + ".bvh";
+    }
+
+    unsigned long long Mix(unsigned long long h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+}
+
+
+void BVHCache::Hasher::AddBytes(const void* data, size_t nBytes)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    //Hash eight bytes at a time, then whatever is left over.
+    unsigned long long h = Value;
+    size_t i = 0;
+    for (; i + 8 <= nBytes; i += 8)
+    {
+        unsigned long long word;
+        memcpy(&word, bytes + i, 8);
+        h = Mix(h ^ word) + 0x632BE59BD9B4E019ULL;
+    }
+    if (i < nBytes)
+    {
+        unsigned long long word = 0;
+        memcpy(&word, bytes + i, nBytes - i);
+        h = Mix(h ^ word ^ ((unsigned long long)(nBytes - i) << 56));
+    }
+
+    Value = h;
+}
+
+void RT_API BVHCache::SetFolder(const String& folderPath)
+{
+    cacheFolder = folderPath;
+}
+const String& RT_API BVHCache::GetFolder()
+{
+    return cacheFolder;
+}
+
+bool RT_API BVHCache::TryLoad(const String& category, unsigned long long hash, size_t nPrims,
+                              BVHTree& outTree)
+{
+    if (cacheFolder.IsEmpty())
+        return false;
+
+    std::ifstream file(GetFilePath(category, hash).CStr(), std::ios_base::binary);
+    if (!file.is_open())
+        return false;
+
+    //Make sure the file is for this exact BVH.
+    FileHeader header;
+    if (!file.read((char*)&header, sizeof(header)) ||
+        memcmp(header.Magic, fileMagic, sizeof(fileMagic)) != 0 ||
+        header.Hash != hash || header.NPrims != nPrims ||
+        header.NPrimIndices < header.NPrims || header.NPrimIndices > header.NPrims * 4 ||
+        header.NNodes > header.NPrimIndices * 2 ||
+        header.NodeSize != sizeof(BVHTree::Node))
+    {
+        return false;
+    }
+
+    std::vector<BVHTree::Node> nodes((size_t)header.NNodes);
+    std::vector<unsigned int> primIndices((size_t)header.NPrimIndices);
+    if (!file.read((char*)nodes.data(), nodes.size() * sizeof(BVHTree::Node)) ||
+        !file.read((char*)primIndices.data(), primIndices.size() * sizeof(unsigned int)))
+    {
+        return false;
+    }
+
+    return outTree.SetData(std::move(nodes), std::move(primIndices), nPrims);
+}
+void RT_API BVHCache::Save(const String& category, unsigned long long hash, const BVHTree& tree)
+{
+    if (cacheFolder.IsEmpty())
+        return;
+
+    FileHeader header;
+    memcpy(header.Magic, fileMagic, sizeof(fileMagic));
+    header.Hash = hash;
+    header.NNodes = tree.GetNodes().size();
+    header.NPrims = tree.GetNPrims();
+    header.NPrimIndices = tree.GetPrimIndices().size();
+    header.NodeSize = sizeof(BVHTree::Node);
+
+    //Write to a temp file first, so that nobody reads a half-written file.
+    //The temp file's name has to be unique across threads and processes,
+    //    so it's made from the process ID and a counter within this process.
+#ifdef OS_WINDOWS
+    size_t processID = (size_t)GetCurrentProcessId();
+#else
+    size_t processID = (size_t)getpid();
+#endif
+    static std::atomic<unsigned int> nextTempID(0);
+    size_t tempID = (size_t)(nextTempID++);
+    String path = GetFilePath(category, hash),
+           tempPath = path + ".tmp" + String(processID) + "_" + String(tempID);
+    {
+        std::ofstream file(tempPath.CStr(), std::ios_base::binary | std::ios_base::trunc);
+        if (!file.is_open())
+            return;
+
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)tree.GetNodes().data(), tree.GetNodes().size() * sizeof(BVHTree::Node));
+        file.write((const char*)tree.GetPrimIndices().data(),
+                   tree.GetPrimIndices().size() * sizeof(unsigned int));
+        if (!file)
+        {
+            file.close();
+            remove(tempPath.CStr());
+            return;
+        }
+    }
+
+    //Swap the finished file in with a single step, so another process never sees the path missing.
+#ifdef OS_WINDOWS
+    bool replaced = (MoveFileExA(tempPath.CStr(), path.CStr(), MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+    bool replaced = (rename(tempPath.CStr(), path.CStr()) == 0);
+#endif
+    if (!replaced)
+        remove(tempPath.CStr());
+}
@@ -0,0 +1,893 @@
+#include "../Headers/BVHTree.h"
+
+#include <algorithm>
+
+using namespace RT;
+
+
+namespace
+{
+    const size_t nBins = 16;
+
+    //Ranges with more primitives than this have their bins and partitions calculated in parallel.
+    const size_t minParallelRange = 16 * 1024;
+
+
+    struct Bin
+    {
+        BoundingBox Bounds = BoundingBox::Empty();
+        size_t Count = 0;
+    };
+
+    //Builds a BVHTree in two phases.
+    //First, the top of the tree is built one node at a time,
+    //    with each node's binning and partitioning split across the thread pool.
+    //Once a node is small enough, it's set aside as a subtree;
+    //    then all the subtrees are built at once, one per thread.
+    struct Builder
+    {
+        typedef BVHTree::Node Node;
+
+        struct Subtree { unsigned int NodeIndex; size_t Start, End, Depth; };
+
+
+        const BoundingBox* PrimBounds;
+        std::vector<Vector3f> Centroids;
+        std::vector<unsigned int>& Indices;
+        ThreadPool& Pool;
+
+        //Nodes with at most this many primitives become separate subtrees.
+        size_t SubtreeSize;
+        std::vector<Subtree> Subtrees;
+
+
+        Builder(const BoundingBox* primBounds, size_t nPrims,
+                std::vector<unsigned int>& indices, ThreadPool& pool)
+            : PrimBounds(primBounds), Indices(indices), Pool(pool)
+        {
+            SubtreeSize = std::max((size_t)1024, nPrims / (pool.GetNThreads() * 8));
+
+            Centroids.resize(nPrims);
+            Indices.resize(nPrims);
+            Pool.ParallelForRanges(nPrims, 4096, [&](size_t start, size_t end)
+            {
+                for (size_t i = start; i < end; ++i)
+                {
+                    Centroids[i] = PrimBounds[i].GetCenter();
+                    Indices[i] = (unsigned int)i;
+                }
+            });
+        }
+
+
+        //Gets how many chunks to split the given range into.
+        size_t GetNChunks(size_t start, size_t end, bool parallel) const
+        {
+            return (parallel ? std::min(Pool.GetNThreads() * 4, (end - start) / 1024 + 1) : 1);
+        }
+        //Splits the given range into the given number of chunks
+        //    and runs "func(chunkI, start, end)" on each of them.
+        template<typename Func>
+        void ForEachChunk(size_t start, size_t end, size_t nChunks, Func func)
+        {
+            size_t chunkSize = (end - start + nChunks - 1) / nChunks;
+
+            if (nChunks == 1)
+                func((size_t)0, start, end);
+            else
+                Pool.ParallelFor(nChunks, [&](size_t chunkI)
+                {
+                    size_t chunkStart = std::min(end, start + (chunkI * chunkSize)),
+                           chunkEnd = std::min(end, chunkStart + chunkSize);
+                    func(chunkI, chunkStart, chunkEnd);
+                });
+        }
+
+        void GetRangeBounds(size_t start, size_t end, bool parallel,
+                            BoundingBox& outBounds, BoundingBox& outCentroidBounds)
+        {
+            size_t nChunks = GetNChunks(start, end, parallel);
+            std::vector<BoundingBox> chunkBounds(nChunks),
+                                     chunkCentroidBounds(nChunks);
+            ForEachChunk(start, end, nChunks, [&](size_t chunkI, size_t chunkStart, size_t chunkEnd)
+            {
+                BoundingBox b = BoundingBox::Empty(),
+                            cb = BoundingBox::Empty();
+                for (size_t i = chunkStart; i < chunkEnd; ++i)
+                {
+                    b.Encapsulate(PrimBounds[Indices[i]]);
+                    cb.Encapsulate(Centroids[Indices[i]]);
+                }
+                chunkBounds[chunkI] = b;
+                chunkCentroidBounds[chunkI] = cb;
+            });
+
+            outBounds = BoundingBox::Empty();
+            outCentroidBounds = BoundingBox::Empty();
+            for (size_t i = 0; i < nChunks; ++i)
+            {
+                outBounds.Encapsulate(chunkBounds[i]);
+                outCentroidBounds.Encapsulate(chunkCentroidBounds[i]);
+            }
+        }
+
+        //Moves every primitive that passes the given predicate to the start of the given range.
+        //Returns the index of the first primitive that didn't pass.
+        template<typename Predicate>
+        size_t Partition(size_t start, size_t end, bool parallel, Predicate pred)
+        {
+            if (!parallel)
+                return std::partition(Indices.begin() + start, Indices.begin() + end, pred) -
+                       Indices.begin();
+
+            //Count how many elements pass in each chunk, then scatter them into a temp buffer.
+            size_t nChunks = GetNChunks(start, end, true);
+            std::vector<size_t> nPassed(nChunks);
+            ForEachChunk(start, end, nChunks, [&](size_t chunkI, size_t chunkStart, size_t chunkEnd)
+            {
+                size_t count = 0;
+                for (size_t i = chunkStart; i < chunkEnd; ++i)
+                    count += (pred(Indices[i]) ? 1 : 0);
+                nPassed[chunkI] = count;
+            });
+
+            size_t chunkSize = (end - start + nChunks - 1) / nChunks;
+            std::vector<size_t> passedOffsets(nChunks), failedOffsets(nChunks);
+            size_t totalPassed = 0;
+            for (size_t i = 0; i < nChunks; ++i)
+                totalPassed += nPassed[i];
+            size_t passedCounter = 0,
+                   failedCounter = totalPassed;
+            for (size_t i = 0; i < nChunks; ++i)
+            {
+                passedOffsets[i] = passedCounter;
+                failedOffsets[i] = failedCounter;
+
+                size_t thisChunkSize = std::min(chunkSize, (end - start) - std::min(end - start, i * chunkSize));
+                passedCounter += nPassed[i];
+                failedCounter += thisChunkSize - nPassed[i];
+            }
+
+            std::vector<unsigned int> temp(end - start);
+            ForEachChunk(start, end, nChunks, [&](size_t chunkI, size_t chunkStart, size_t chunkEnd)
+            {
+                size_t passedI = passedOffsets[chunkI],
+                       failedI = failedOffsets[chunkI];
+                for (size_t i = chunkStart; i < chunkEnd; ++i)
+                    if (pred(Indices[i]))
+                        temp[passedI++] = Indices[i];
+                    else
+                        temp[failedI++] = Indices[i];
+            });
+            ForEachChunk(start, end, nChunks, [&](size_t chunkI, size_t chunkStart, size_t chunkEnd)
+            {
+                std::copy(temp.begin() + (chunkStart - start), temp.begin() + (chunkEnd - start),
+                          Indices.begin() + chunkStart);
+            });
+
+            return start + totalPassed;
+        }
+
+        //Splits the given range in half by the primitives' centroids along the given axis.
+        size_t MedianSplit(size_t start, size_t end, int axis)
+        {
+            size_t mid = start + ((end - start) / 2);
+            std::nth_element(Indices.begin() + start, Indices.begin() + mid, Indices.begin() + end,
+                             [&](unsigned int a, unsigned int b)
+                                 { return Centroids[a][axis] < Centroids[b][axis]; });
+            return mid;
+        }
+
+        //Finds the best place to split the given range, using the surface area heuristic.
+        //Returns false if the range should become a leaf instead.
+        bool Split(size_t start, size_t end, size_t depth, bool parallel,
+                   const BoundingBox& bounds, const BoundingBox& centroidBounds,
+                   size_t& outMid)
+        {
+            size_t n = end - start;
+            if (n <= 1)
+                return false;
+
+            Vector3f centroidSize = centroidBounds.GetSize();
+            int largestAxis = (centroidSize.x > centroidSize.y ?
+                                   (centroidSize.x > centroidSize.z ? 0 : 2) :
+                                   (centroidSize.y > centroidSize.z ? 1 : 2));
+
+            //If all the centroids are in the same place, no split is better than any other.
+            if (centroidSize[largestAxis] <= 0.0f)
+            {
+                if (n <= BVHTree::MaxLeafPrims)
+                    return false;
+                outMid = start + (n / 2);
+                return true;
+            }
+
+            //If the tree is getting too deep, fall back to median splits,
+            //    which are guaranteed to finish within 32 more levels.
+            if (depth >= BVHTree::MaxDepth - 32)
+            {
+                outMid = MedianSplit(start, end, largestAxis);
+                return true;
+            }
+
+            //Sort the primitives into bins along each axis.
+            Vector3f binScale;
+            for (int axis = 0; axis < 3; ++axis)
+                binScale[axis] = (centroidSize[axis] > 0.0f ?
+                                      ((float)nBins * 0.99999f / centroidSize[axis]) :
+                                      0.0f);
+            auto getBin = [&](float centroid, int axis)
+            {
+                size_t bin = (size_t)((centroid - centroidBounds.Min[axis]) * binScale[axis]);
+                return std::min(bin, nBins - 1);
+            };
+
+            size_t nChunks = GetNChunks(start, end, parallel);
+            std::vector<Bin> chunkBins(nChunks * 3 * nBins);
+            ForEachChunk(start, end, nChunks, [&](size_t chunkI, size_t chunkStart, size_t chunkEnd)
+            {
+                Bin* bins = &chunkBins[chunkI * 3 * nBins];
+                for (size_t i = chunkStart; i < chunkEnd; ++i)
+                {
+                    unsigned int prim = Indices[i];
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        Bin& bin = bins[(axis * nBins) + getBin(Centroids[prim][axis], axis)];
+                        bin.Bounds.Encapsulate(PrimBounds[prim]);
+                        bin.Count += 1;
+                    }
+                }
+            });
+            for (size_t chunkI = 1; chunkI < nChunks; ++chunkI)
+                for (size_t i = 0; i < 3 * nBins; ++i)
+                {
+                    const Bin& src = chunkBins[(chunkI * 3 * nBins) + i];
+                    chunkBins[i].Bounds.Encapsulate(src.Bounds);
+                    chunkBins[i].Count += src.Count;
+                }
+
+            //Find the cheapest split: the one that minimizes
+            //    (left area * left count) + (right area * right count).
+            float bestCost = std::numeric_limits<float>::infinity();
+            int bestAxis = -1;
+            size_t bestBin = 0;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (binScale[axis] == 0.0f)
+                    continue;
+                const Bin* bins = &chunkBins[axis * nBins];
+
+                //Sweep from the right to get the cost of everything to the right of each split.
+                float rightCosts[nBins];
+                BoundingBox rightBounds = BoundingBox::Empty();
+                size_t rightCount = 0;
+                for (size_t i = nBins - 1; i > 0; --i)
+                {
+                    rightBounds.Encapsulate(bins[i].Bounds);
+                    rightCount += bins[i].Count;
+                    rightCosts[i - 1] = rightBounds.GetSurfaceArea() * (float)rightCount;
+                }
+
+                //Now sweep from the left.
+                BoundingBox leftBounds = BoundingBox::Empty();
+                size_t leftCount = 0;
+                for (size_t i = 0; i < nBins - 1; ++i)
+                {
+                    leftBounds.Encapsulate(bins[i].Bounds);
+                    leftCount += bins[i].Count;
+                    if (leftCount == 0 || leftCount == n)
+                        continue;
+
+                    float cost = (leftBounds.GetSurfaceArea() * (float)leftCount) + rightCosts[i];
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = i;
+                    }
+                }
+            }
+
+            //A leaf costs one intersection test per primitive;
+            //    a split costs one traversal step plus the expected tests in each child.
+            float area = bounds.GetSurfaceArea();
+            float splitCost = 1.0f + (area > 0.0f ? (bestCost / area) : 0.0f);
+            if (n <= BVHTree::MaxLeafPrims && (bestAxis < 0 || splitCost >= (float)n))
+                return false;
+
+            if (bestAxis < 0)
+            {
+                outMid = MedianSplit(start, end, largestAxis);
+                return true;
+            }
+
+            outMid = Partition(start, end, parallel, [&](unsigned int prim)
+                                   { return getBin(Centroids[prim][bestAxis], bestAxis) <= bestBin; });
+            if (outMid == start || outMid == end)
+                outMid = MedianSplit(start, end, largestAxis);
+            return true;
+        }
+
+        //Builds the given node out of the given range of primitives.
+        //If "isTopLevel" is true, small nodes are set aside to be built as subtrees later.
+        void BuildNode(std::vector<Node>& nodes, unsigned int nodeI,
+                       size_t start, size_t end, size_t depth, bool isTopLevel)
+        {
+            bool parallel = isTopLevel && (end - start) > minParallelRange;
+
+            BoundingBox bounds, centroidBounds;
+            GetRangeBounds(start, end, parallel, bounds, centroidBounds);
+            nodes[nodeI].Bounds = bounds;
+
+            if (isTopLevel && (end - start) <= SubtreeSize)
+            {
+                Subtrees.push_back({ nodeI, start, end, depth });
+                return;
+            }
+
+            size_t mid;
+            if (!Split(start, end, depth, parallel, bounds, centroidBounds, mid))
+            {
+                nodes[nodeI].Offset = (unsigned int)start;
+                nodes[nodeI].NPrims = (unsigned int)(end - start);
+                return;
+            }
+
+            unsigned int childI = (unsigned int)nodes.size();
+            nodes[nodeI].Offset = childI;
+            nodes[nodeI].NPrims = 0;
+            nodes.resize(nodes.size() + 2);
+
+            BuildNode(nodes, childI, start, mid, depth + 1, isTopLevel);
+            BuildNode(nodes, childI + 1, mid, end, depth + 1, isTopLevel);
+        }
+    };
+
+    //Builds a BVHTree with spatial splits, following "Spatial Splits in Bounding Volume Hierarchies"
+    //    (Stich, Friedrich, and Dietrich, 2009).
+    //Every node considers both a normal object split and a split through space,
+    //    where any primitive crossing the split plane is clipped and referenced on both sides.
+    struct SpatialBuilder
+    {
+        typedef BVHTree::Node Node;
+
+        //A primitive, or the part of one that's inside some node.
+        struct Ref
+        {
+            BoundingBox Bounds;
+            unsigned int Prim;
+        };
+
+        struct SpatialBin
+        {
+            BoundingBox Bounds = BoundingBox::Empty();
+            size_t NEntries = 0,
+                   NExits = 0;
+        };
+
+        //Spatial splits are only tried when the children of the best object split overlap
+        //    by more than this fraction of the root's surface area.
+        const float MinOverlap = 0.00001f;
+
+
+        const BVHTree::PrimClipper& ClipPrim;
+        std::vector<Node>& Nodes;
+        std::vector<unsigned int>& Indices;
+
+        float RootArea;
+        //The number of references that can still be made by spatial splits.
+        size_t RefsLeft;
+
+
+        SpatialBuilder(const BVHTree::PrimClipper& clipPrim, size_t maxExtraRefs, float rootArea,
+                       std::vector<Node>& nodes, std::vector<unsigned int>& indices)
+            : ClipPrim(clipPrim), Nodes(nodes), Indices(indices),
+              RootArea(rootArea), RefsLeft(maxExtraRefs) { }
+
+
+        static BoundingBox Intersect(const BoundingBox& a, const BoundingBox& b)
+        {
+            return BoundingBox(Vector3f(std::max(a.Min.x, b.Min.x),
+                                        std::max(a.Min.y, b.Min.y),
+                                        std::max(a.Min.z, b.Min.z)),
+                               Vector3f(std::min(a.Max.x, b.Max.x),
+                                        std::min(a.Max.y, b.Max.y),
+                                        std::min(a.Max.z, b.Max.z)));
+        }
+        static bool IsEmpty(const BoundingBox& b)
+        {
+            return !(b.Min.x <= b.Max.x && b.Min.y <= b.Max.y && b.Min.z <= b.Max.z);
+        }
+
+        //Gets the bounds of the part of the given reference between "min" and "max" along the given axis.
+        BoundingBox Clip(const Ref& ref, int axis, float min, float max) const
+        {
+            return Intersect(ClipPrim(ref.Prim, axis, min, max), ref.Bounds);
+        }
+
+        //Finds the best object split using binned SAH.
+        //Outputs the cost (not counting the traversal step) as (left area * left count) + (right area * right count).
+        //Returns false if no split was found.
+        bool FindObjectSplit(const std::vector<Ref>& refs, const BoundingBox& centroidBounds,
+                             float& outCost, int& outAxis, float& outPos,
+                             BoundingBox& outLeftBounds, BoundingBox& outRightBounds) const
+        {
+            outCost = std::numeric_limits<float>::infinity();
+            Vector3f centroidSize = centroidBounds.GetSize();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (centroidSize[axis] <= 0.0f)
+                    continue;
+
+                float binScale = (float)nBins * 0.99999f / centroidSize[axis];
+                Bin bins[nBins];
+                for (const Ref& ref : refs)
+                {
+                    size_t bin = (size_t)((ref.Bounds.GetCenter()[axis] - centroidBounds.Min[axis]) * binScale);
+                    bin = std::min(bin, nBins - 1);
+                    bins[bin].Bounds.Encapsulate(ref.Bounds);
+                    bins[bin].Count += 1;
+                }
+
+                BoundingBox rightBounds[nBins];
+                size_t rightCounts[nBins];
+                rightBounds[nBins - 1] = bins[nBins - 1].Bounds;
+                rightCounts[nBins - 1] = bins[nBins - 1].Count;
+                for (size_t i = nBins - 1; i > 0; --i)
+                {
+                    rightBounds[i - 1] = rightBounds[i];
+                    rightBounds[i - 1].Encapsulate(bins[i - 1].Bounds);
+                    rightCounts[i - 1] = rightCounts[i] + bins[i - 1].Count;
+                }
+
+                BoundingBox leftBounds = BoundingBox::Empty();
+                size_t leftCount = 0;
+                for (size_t i = 0; i < nBins - 1; ++i)
+                {
+                    leftBounds.Encapsulate(bins[i].Bounds);
+                    leftCount += bins[i].Count;
+                    if (leftCount == 0 || rightCounts[i + 1] == 0)
+                        continue;
+
+                    float cost = (leftBounds.GetSurfaceArea() * (float)leftCount) +
+                                 (rightBounds[i + 1].GetSurfaceArea() * (float)rightCounts[i + 1]);
+                    if (cost < outCost)
+                    {
+                        outCost = cost;
+                        outAxis = axis;
+                        outPos = centroidBounds.Min[axis] + ((float)(i + 1) / binScale);
+                        outLeftBounds = leftBounds;
+                        outRightBounds = rightBounds[i + 1];
+                    }
+                }
+            }
+
+            return outCost < std::numeric_limits<float>::infinity();
+        }
+
+        //Finds the best spatial split, by clipping every reference into evenly-spaced bins.
+        //Outputs the cost the same way as "FindObjectSplit()", along with how many references it would add.
+        //Returns false if no split was found.
+        bool FindSpatialSplit(const std::vector<Ref>& refs, const BoundingBox& bounds,
+                              float& outCost, int& outAxis, float& outPos, size_t& outNExtraRefs) const
+        {
+            outCost = std::numeric_limits<float>::infinity();
+            Vector3f size = bounds.GetSize();
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                if (size[axis] <= 0.0f)
+                    continue;
+
+                float binSize = size[axis] / (float)nBins;
+                auto getBinStart = [&](size_t bin) { return bounds.Min[axis] + (binSize * (float)bin); };
+                auto getBin = [&](float pos)
+                {
+                    float bin = (pos - bounds.Min[axis]) / binSize;
+                    return (bin <= 0.0f ? 0 : std::min((size_t)bin, nBins - 1));
+                };
+
+                //Each reference is clipped into every bin it touches.
+                SpatialBin bins[nBins];
+                for (const Ref& ref : refs)
+                {
+                    size_t firstBin = getBin(ref.Bounds.Min[axis]),
+                           lastBin = getBin(ref.Bounds.Max[axis]);
+                    bins[firstBin].NEntries += 1;
+                    bins[lastBin].NExits += 1;
+
+                    if (firstBin == lastBin)
+                    {
+                        bins[firstBin].Bounds.Encapsulate(ref.Bounds);
+                        continue;
+                    }
+                    for (size_t bin = firstBin; bin <= lastBin; ++bin)
+                    {
+                        BoundingBox clipped = Clip(ref, axis, getBinStart(bin), getBinStart(bin + 1));
+                        if (!IsEmpty(clipped))
+                            bins[bin].Bounds.Encapsulate(clipped);
+                    }
+                }
+
+                BoundingBox rightBounds[nBins];
+                size_t rightCounts[nBins];
+                rightBounds[nBins - 1] = bins[nBins - 1].Bounds;
+                rightCounts[nBins - 1] = bins[nBins - 1].NExits;
+                for (size_t i = nBins - 1; i > 0; --i)
+                {
+                    rightBounds[i - 1] = rightBounds[i];
+                    rightBounds[i - 1].Encapsulate(bins[i - 1].Bounds);
+                    rightCounts[i - 1] = rightCounts[i] + bins[i - 1].NExits;
+                }
+
+                BoundingBox leftBounds = BoundingBox::Empty();
+                size_t leftCount = 0;
+                for (size_t i = 0; i < nBins - 1; ++i)
+                {
+                    leftBounds.Encapsulate(bins[i].Bounds);
+                    leftCount += bins[i].NEntries;
+                    size_t rightCount = rightCounts[i + 1];
+                    if (leftCount == 0 || rightCount == 0 || leftCount + rightCount - refs.size() > RefsLeft)
+                        continue;
+
+                    float cost = (leftBounds.GetSurfaceArea() * (float)leftCount) +
+                                 (rightBounds[i + 1].GetSurfaceArea() * (float)rightCount);
+                    if (cost < outCost)
+                    {
+                        outCost = cost;
+                        outAxis = axis;
+                        outPos = getBinStart(i + 1);
+                        outNExtraRefs = leftCount + rightCount - refs.size();
+                    }
+                }
+            }
+
+            return outCost < std::numeric_limits<float>::infinity();
+        }
+
+        //Builds the given node out of the given references, which get consumed.
+        void BuildNode(unsigned int nodeI, std::vector<Ref>& refs, size_t depth)
+        {
+            BoundingBox bounds = BoundingBox::Empty(),
+                        centroidBounds = BoundingBox::Empty();
+            for (const Ref& ref : refs)
+            {
+                bounds.Encapsulate(ref.Bounds);
+                centroidBounds.Encapsulate(ref.Bounds.GetCenter());
+            }
+            Nodes[nodeI].Bounds = bounds;
+
+            size_t n = refs.size();
+            std::vector<Ref> leftRefs, rightRefs;
+
+            //Near the maximum depth, fall back to median splits,
+            //    which are guaranteed to finish within 32 more levels.
+            bool split = false;
+            if (n > 1 && depth < BVHTree::MaxDepth - 32)
+            {
+                float objectCost = 0.0f, objectPos = 0.0f,
+                      spatialCost = 0.0f, spatialPos = 0.0f;
+                int objectAxis = 0, spatialAxis = 0;
+                size_t nExtraRefs = 0;
+                BoundingBox objectLeft, objectRight;
+                bool foundObjectSplit = FindObjectSplit(refs, centroidBounds, objectCost, objectAxis, objectPos,
+                                                        objectLeft, objectRight);
+
+                //Only try a spatial split if the object split's children overlap a lot.
+                bool trySpatial = (RefsLeft > 0);
+                if (trySpatial && foundObjectSplit)
+                {
+                    BoundingBox overlap = Intersect(objectLeft, objectRight);
+                    trySpatial = !IsEmpty(overlap) && overlap.GetSurfaceArea() > MinOverlap * RootArea;
+                }
+                bool foundSpatialSplit = trySpatial &&
+                                         FindSpatialSplit(refs, bounds, spatialCost, spatialAxis, spatialPos,
+                                                          nExtraRefs);
+
+                //A leaf costs one intersection test per primitive;
+                //    a split costs one traversal step plus the expected tests in each child.
+                float area = bounds.GetSurfaceArea();
+                auto getSplitCost = [&](float cost) { return 1.0f + (area > 0.0f ? (cost / area) : 0.0f); };
+                float bestCost = std::min(foundObjectSplit ? getSplitCost(objectCost) :
+                                                             std::numeric_limits<float>::infinity(),
+                                          foundSpatialSplit ? getSplitCost(spatialCost) :
+                                                              std::numeric_limits<float>::infinity());
+                bool makeLeaf = (n <= BVHTree::MaxLeafPrims && bestCost >= (float)n);
+
+                if (!makeLeaf && foundSpatialSplit && (!foundObjectSplit || spatialCost < objectCost))
+                {
+                    //References crossing the plane go into both sides, clipped to each one.
+                    const float inf = std::numeric_limits<float>::infinity();
+                    for (const Ref& ref : refs)
+                    {
+                        if (ref.Bounds.Max[spatialAxis] <= spatialPos)
+                        {
+                            leftRefs.push_back(ref);
+                        }
+                        else if (ref.Bounds.Min[spatialAxis] >= spatialPos)
+                        {
+                            rightRefs.push_back(ref);
+                        }
+                        else
+                        {
+                            Ref left = { Clip(ref, spatialAxis, -inf, spatialPos), ref.Prim },
+                                right = { Clip(ref, spatialAxis, spatialPos, inf), ref.Prim };
+                            bool hasLeft = !IsEmpty(left.Bounds),
+                                 hasRight = !IsEmpty(right.Bounds);
+                            if (hasLeft)
+                                leftRefs.push_back(left);
+                            if (hasRight)
+                                rightRefs.push_back(right);
+                            if (!hasLeft && !hasRight)
+                                leftRefs.push_back(ref);
+                        }
+                    }
+                    RefsLeft -= std::min(RefsLeft, leftRefs.size() + rightRefs.size() - n);
+                    split = true;
+                }
+                else if (!makeLeaf && foundObjectSplit)
+                {
+                    for (const Ref& ref : refs)
+                    {
+                        if (ref.Bounds.GetCenter()[objectAxis] < objectPos)
+                            leftRefs.push_back(ref);
+                        else
+                            rightRefs.push_back(ref);
+                    }
+                    split = true;
+                }
+
+                //If the split didn't actually separate anything, fall back to a median split.
+                if (split && (leftRefs.empty() || rightRefs.empty()))
+                {
+                    leftRefs.clear();
+                    rightRefs.clear();
+                    split = false;
+                }
+            }
+
+            //Leaves can't hold more than the maximum number of primitives,
+            //    so split them in half by their centroids if nothing better was found.
+            if (!split && refs.size() > BVHTree::MaxLeafPrims)
+            {
+                Vector3f centroidSize = centroidBounds.GetSize();
+                int axis = (centroidSize.x > centroidSize.y ?
+                                (centroidSize.x > centroidSize.z ? 0 : 2) :
+                                (centroidSize.y > centroidSize.z ? 1 : 2));
+                size_t mid = refs.size() / 2;
+                std::nth_element(refs.begin(), refs.begin() + mid, refs.end(),
+                                 [&](const Ref& a, const Ref& b)
+                                     { return a.Bounds.GetCenter()[axis] < b.Bounds.GetCenter()[axis]; });
+                leftRefs.assign(refs.begin(), refs.begin() + mid);
+                rightRefs.assign(refs.begin() + mid, refs.end());
+                split = true;
+            }
+
+            if (!split)
+            {
+                Nodes[nodeI].Offset = (unsigned int)Indices.size();
+                Nodes[nodeI].NPrims = (unsigned int)refs.size();
+                for (const Ref& ref : refs)
+                    Indices.push_back(ref.Prim);
+                return;
+            }
+
+            //Free up this node's references before going deeper.
+            refs.clear();
+            refs.shrink_to_fit();
+
+            unsigned int childI = (unsigned int)Nodes.size();
+            Nodes[nodeI].Offset = childI;
+            Nodes[nodeI].NPrims = 0;
+            Nodes.resize(Nodes.size() + 2);
+
+            BuildNode(childI, leftRefs, depth + 1);
+            BuildNode(childI + 1, rightRefs, depth + 1);
+        }
+    };
+}
+
+
+void BVHTree::Build(const BoundingBox* primBounds, size_t nPrims, ThreadPool& pool)
+{
+    nodes.clear();
+    primIndices.clear();
+    nBuiltPrims = nPrims;
+    builtCost = 0.0f;
+    if (nPrims == 0)
+    {
+        UpdateWideTree();
+        return;
+    }
+
+    Builder builder(primBounds, nPrims, primIndices, pool);
+
+    //Build the top of the tree.
+    nodes.reserve(nPrims * 2);
+    nodes.resize(1);
+    builder.BuildNode(nodes, 0, 0, nPrims, 0, true);
+
+    //Build the subtrees in parallel.
+    const auto& subtrees = builder.Subtrees;
+    std::vector<std::vector<Node>> subtreeNodes(subtrees.size());
+    pool.ParallelFor(subtrees.size(), [&](size_t i)
+    {
+        subtreeNodes[i].resize(1);
+        builder.BuildNode(subtreeNodes[i], 0, subtrees[i].Start, subtrees[i].End,
+                          subtrees[i].Depth, false);
+    });
+
+    //Stitch the subtrees into the main tree.
+    //Each subtree's root replaces its placeholder node, and the rest of its nodes go on the end.
+    std::vector<size_t> subtreeOffsets(subtrees.size());
+    size_t nNodes = nodes.size();
+    for (size_t i = 0; i < subtrees.size(); ++i)
+    {
+        subtreeOffsets[i] = nNodes;
+        nNodes += subtreeNodes[i].size() - 1;
+    }
+    nodes.resize(nNodes);
+    pool.ParallelFor(subtrees.size(), [&](size_t i)
+    {
+        const std::vector<Node>& src = subtreeNodes[i];
+        unsigned int offsetDelta = (unsigned int)(subtreeOffsets[i] - 1);
+
+        for (size_t j = 0; j < src.size(); ++j)
+        {
+            Node node = src[j];
+            if (!node.IsLeaf())
+                node.Offset += offsetDelta;
+
+            if (j == 0)
+                nodes[subtrees[i].NodeIndex] = node;
+            else
+                nodes[subtreeOffsets[i] + j - 1] = node;
+        }
+    });
+
+    builtCost = GetSAHCost();
+    UpdateWideTree();
+}
+void BVHTree::BuildSpatial(const BoundingBox* primBounds, size_t nPrims, const PrimClipper& clipPrim,
+                           float maxDuplication)
+{
+    nodes.clear();
+    primIndices.clear();
+    nBuiltPrims = nPrims;
+    builtCost = 0.0f;
+    if (nPrims == 0)
+    {
+        UpdateWideTree();
+        return;
+    }
+
+    std::vector<SpatialBuilder::Ref> refs(nPrims);
+    BoundingBox rootBounds = BoundingBox::Empty();
+    for (size_t i = 0; i < nPrims; ++i)
+    {
+        refs[i] = { primBounds[i], (unsigned int)i };
+        rootBounds.Encapsulate(primBounds[i]);
+    }
+
+    size_t maxExtraRefs = (size_t)(std::max(0.0f, maxDuplication) * (float)nPrims);
+    nodes.reserve((nPrims + maxExtraRefs) * 2);
+    primIndices.reserve(nPrims + maxExtraRefs);
+    nodes.resize(1);
+
+    SpatialBuilder builder(clipPrim, maxExtraRefs, rootBounds.GetSurfaceArea(), nodes, primIndices);
+    builder.BuildNode(0, refs, 0);
+
+    builtCost = GetSAHCost();
+    UpdateWideTree();
+}
+
+void BVHTree::Refit(const BoundingBox* primBounds, ThreadPool& pool)
+{
+    //Recalculate the leaves in parallel.
+    pool.ParallelForRanges(nodes.size(), 4096, [&](size_t start, size_t end)
+    {
+        for (size_t i = start; i < end; ++i)
+        {
+            Node& node = nodes[i];
+            if (node.IsLeaf())
+            {
+                node.Bounds = BoundingBox::Empty();
+                for (unsigned int j = 0; j < node.NPrims; ++j)
+                    node.Bounds.Encapsulate(primBounds[primIndices[node.Offset + j]]);
+            }
+        }
+    });
+
+    //Children always come after their parents, so going backwards updates every child before its parent.
+    for (size_t i = nodes.size(); i > 0; --i)
+    {
+        Node& node = nodes[i - 1];
+        if (!node.IsLeaf())
+        {
+            node.Bounds = nodes[node.Offset].Bounds;
+            node.Bounds.Encapsulate(nodes[node.Offset + 1].Bounds);
+        }
+    }
+
+    UpdateWideTree();
+}
+bool BVHTree::Update(const BoundingBox* primBounds, size_t nPrims,
+                     ThreadPool& pool, float maxCostIncrease)
+{
+    if (nPrims == nBuiltPrims && !nodes.empty())
+    {
+        Refit(primBounds, pool);
+        if (!HasDegraded(maxCostIncrease))
+            return false;
+    }
+
+    Build(primBounds, nPrims, pool);
+    return true;
+}
+
+float BVHTree::GetSAHCost() const
+{
+    if (nodes.empty())
+        return 0.0f;
+
+    //Each node's cost is weighted by the chance that a ray hitting the root also hits that node.
+    float totalCost = 0.0f;
+    for (const Node& node : nodes)
+        totalCost += node.Bounds.GetSurfaceArea() * (node.IsLeaf() ? (float)node.NPrims : 1.0f);
+
+    float rootArea = nodes[0].Bounds.GetSurfaceArea();
+    return (rootArea > 0.0f ? (totalCost / rootArea) : 0.0f);
+}
+
+bool BVHTree::SetData(std::vector<Node>&& newNodes, std::vector<unsigned int>&& newPrimIndices,
+                      size_t newNPrims)
+{
+    if (newNodes.empty() != newPrimIndices.empty() || newPrimIndices.size() < newNPrims)
+        return false;
+
+    for (unsigned int prim : newPrimIndices)
+        if (prim >= newNPrims)
+            return false;
+
+    //Make sure every node points to valid data, and the tree isn't too deep.
+    std::vector<unsigned int> depths(newNodes.size(), 0);
+    for (size_t i = 0; i < newNodes.size(); ++i)
+    {
+        const Node& node = newNodes[i];
+        if (depths[i] > MaxDepth)
+            return false;
+
+        if (node.IsLeaf())
+        {
+            if (node.NPrims > MaxLeafPrims ||
+                (size_t)node.Offset + node.NPrims > newPrimIndices.size())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (node.Offset <= i || (size_t)node.Offset + 1 >= newNodes.size())
+                return false;
+            depths[node.Offset] = depths[i] + 1;
+            depths[node.Offset + 1] = depths[i] + 1;
+        }
+    }
+
+    nodes = std::move(newNodes);
+    primIndices = std::move(newPrimIndices);
+    nBuiltPrims = newNPrims;
+    builtCost = GetSAHCost();
+    UpdateWideTree();
+    return true;
+}
+
+void BVHTree::UpdateWideTree()
+{
+#if RT_BVH_COMPRESSED
+    WideBVH<CompressedBVH<MaxDepth>::Width, MaxDepth> wideTree;
+    wideTree.Build(nodes);
+    compressedTree.Build(wideTree);
+#elif RT_BVH_WIDTH != 2
+    wideTree.Build(nodes);
+#endif
+}
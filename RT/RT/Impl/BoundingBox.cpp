@@ -1,23 +1,26 @@
 #include "../Headers/BoundingBox.h"
 
+#include "../Headers/Transform.h"
+
 using namespace RT;
 
 
-namespace
+bool BoundingBox::RayIntersects(const Ray& ray, float tMin, float tMax) const
 {
-    float max(float f1, float f2) { return (f1 > f2) ? f1 : f2; }
-    float min(float f1, float f2) { return (f1 > f2) ? f2 : f1; }
+    //The ray hits the box if the span where it's inside the box overlaps [tMin, tMax].
+    float tEnter;
+    return RayIntersects(ray.GetPos(), ray.GetDir().Reciprocal(), tMin, tMax, tEnter);
 }
-
-bool BoundingBox::RayIntersects(const Ray& ray, float tMin, float tMax) const
+BoundingBox BoundingBox::GetTransformed(const Transform& tr) const
 {
-    Vector3f dirFrac = ray.GetDir().Reciprocal();
-
-    Vector3f minD = (Min - ray.GetPos()) * dirFrac,
-             maxD = (Max - ray.GetPos()) * dirFrac;
-
-    float _tMin = max(max(min(minD.x, maxD.x), min(minD.y, maxD.y)), min(minD.z, maxD.z)),
-          _tMax = min(min(max(minD.x, maxD.x), max(minD.y, maxD.y)), max(minD.z, maxD.z));
-    return (_tMin >= tMin && _tMin <= tMax) ||
-           (_tMax >= tMin && _tMax <= tMax);
+    //Transform all eight corners.
+    BoundingBox b = Empty();
+    for (size_t i = 0; i < 8; ++i)
+    {
+        Vector3f corner((i & 1) == 0 ? Min.x : Max.x,
+                        (i & 2) == 0 ? Min.y : Max.y,
+                        (i & 4) == 0 ? Min.z : Max.z);
+        b.Encapsulate(tr.Point_LocalToWorld(corner));
+    }
+    return b;
 }
\ No newline at end of file
@@ -11,57 +11,49 @@ ADD_SHAPE_REFLECTION_DATA_CPP(ConstantMedium);
 void ConstantMedium::PrecalcData()
 {
     Surface->PrecalcData();
+    Surface->GetBoundingBox(bounds);
+}
+void ConstantMedium::UpdatePrecalcData()
+{
+    Surface->UpdatePrecalcData();
+    Surface->GetBoundingBox(bounds);
 }
 
 bool ConstantMedium::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                              float tMin, float tMax) const
 {
     //Check the bounding box first to save time.
-    BoundingBox surfaceBox;
-    Surface->GetBoundingBox(surfaceBox);
-    if (!surfaceBox.RayIntersects(ray, tMin, tMax))
+    if (!bounds.RayIntersects(ray, tMin, tMax))
         return false;
 
-    constexpr float inf = std::numeric_limits<float>::infinity();
-
     //Get where the ray enters and exits the surface.
-    Vertex enterHit, exitHit;
-    if (Surface->CastRay(ray, enterHit, prng, -inf, inf))
-    {
-        float entranceT = ray.GetT(enterHit.Pos);
-
-        if (Surface->CastRay(ray, exitHit, prng, entranceT + Material::PushoffDist, inf))
-        {
-            float exitT = ray.GetT(exitHit.Pos);
-
-            //Clamp the entrance/exit positions along the ray.
-            entranceT = (entranceT < tMin ? tMin : entranceT);
-            exitT = (exitT > tMax ? tMax : exitT);
-            if (entranceT >= exitT)
-                return false;
-            entranceT = (entranceT < 0.0f ? 0.0f : entranceT);
-
-            //Get the distance through this medium before the ray hits a particle.
-            float distThroughMedium = (exitT - entranceT);
-            float hitDist = -log(prng.NextFloat()) / Density;
-
-            if (hitDist < distThroughMedium)
-            {
-                float outHitDist = entranceT + hitDist;
-                outHit.Pos = ray.GetPos(outHitDist);
-
-                //The medium is constant, so the normal/tangent/bitangent is random.
-                outHit.Normal = prng.NextUnitVector3();
-                outHit.Normal.GetOrthoBasis(outHit.Tangent, outHit.Bitangent);
-                //Make the UV random as well.
-                outHit.UV = Vector2f(prng.NextFloat(), prng.NextFloat());
-
-                return true;
-            }
-        }
-    }
-
-    return false;
+    float entranceT, exitT;
+    if (!Surface->CastRayInterval(ray, prng, Material::PushoffDist, entranceT, exitT))
+        return false;
+
+    //Clamp the entrance/exit positions along the ray.
+    entranceT = (entranceT < tMin ? tMin : entranceT);
+    exitT = (exitT > tMax ? tMax : exitT);
+    if (entranceT >= exitT)
+        return false;
+    entranceT = (entranceT < 0.0f ? 0.0f : entranceT);
+
+    //Get how far through this medium the ray gets before it hits a particle.
+    //The density is per unit of distance, so the distance is converted to "t" for rays that aren't normalized.
+    float tThroughMedium = (exitT - entranceT);
+    float hitT = -log(prng.NextFloat()) / (Density * ray.GetDir().Length());
+    if (hitT >= tThroughMedium)
+        return false;
+
+    outHit.Pos = ray.GetPos(entranceT + hitT);
+
+    //The medium is constant, so the normal/tangent/bitangent is random.
+    outHit.Normal = prng.NextUnitVector3();
+    outHit.Normal.GetOrthoBasis(outHit.Tangent, outHit.Bitangent);
+    //Make the UV random as well.
+    outHit.UV = Vector2f(prng.NextFloat(), prng.NextFloat());
+
+    return true;
 }
 
 void ConstantMedium::WriteData(DataWriter& writer) const
@@ -77,7 +69,5 @@ void ConstantMedium::ReadData(DataReader& reader)
 
     reader.ReadFloat(Density, "Density");
 
-    Shape* outShape;
-    Shape::ReadValue(outShape, reader, "Surface");
-    Surface = outShape;
+    Shape::ReadValue(Surface, reader, "Surface");
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include "../Headers/Quaternion.h"
 
+#include <string.h>
+
 using namespace RT;
 
 
@@ -68,6 +70,10 @@ namespace
 }
 
 
+void DataWriter::WriteFloats(const float* values, size_t nValues, const String& name)
+{
+    WriteBytes((const unsigned char*)values, nValues * sizeof(float), name);
+}
 void DataWriter::WriteVec2f(const Vector2f& v, const String& name)
 {
     WriteDataStructure(Vector2f_Writable(v), name);
@@ -85,6 +91,22 @@ void DataWriter::WriteQuaternion(const Quaternion& q, const String& name)
     WriteDataStructure(Quaternion_Writable(q), name);
 }
 
+void DataReader::ReadFloats(List<float>& outValues, const String& name)
+{
+    List<unsigned char> bytes;
+    ReadBytes(bytes, name);
+
+    if (bytes.GetSize() % sizeof(float) != 0)
+    {
+        ErrorMessage = "Float data has an invalid byte count: ";
+        ErrorMessage += String(bytes.GetSize());
+        throw EXCEPTION_FAILURE;
+    }
+
+    outValues.Resize(bytes.GetSize() / sizeof(float));
+    if (outValues.GetSize() > 0)
+        memcpy(outValues.GetData(), bytes.GetData(), bytes.GetSize());
+}
 void DataReader::ReadVec2f(Vector2f& v, const String& name)
 {
     ReadDataStructure(Vector2f_Readable(v), name);
@@ -0,0 +1,302 @@
+#include "../Headers/Denoiser.h"
+
+#include <assert.h>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    #include <emmintrin.h>
+    #define RT_DENOISE_SIMD 1
+#else
+    #define RT_DENOISE_SIMD 0
+#endif
+
+using namespace RT;
+
+
+namespace
+{
+    //The 1D B3-spline kernel; each tap of the 5x5 kernel is the product of two of these.
+    const float kernel[5] = { 1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+    //Albedos darker than this are treated as being this bright when dividing them out,
+    //    so that nearly-black surfaces don't blow up their noise.
+    const float minAlbedo = 0.01f;
+    //Depths are compared relative to the filtered pixel's depth, which mustn't be zero.
+    const float minDepth = 0.0001f;
+    //Stands in for the sky's infinite depth, so that the sky still matches itself.
+    const float skyDepth = 1.0e30f;
+
+
+    //Approximates "e^x" for non-positive "x", to within about 0.01%.
+    //Splits "x" into a power of two and a fraction, which is approximated with a cubic.
+    //Done the same way as the SIMD version below, so both give the same weights.
+    float FastExp(float x)
+    {
+        float t = std::max(x, -80.0f) * 1.44269504f;
+        float whole = std::floor(t),
+              fraction = t - whole;
+        float result = 1.0f + (fraction * (0.69511647f + (fraction * (0.22764561f + (fraction * 0.07706752f)))));
+
+        int bits;
+        memcpy(&bits, &result, sizeof(float));
+        bits += (int)whole << 23;
+        memcpy(&result, &bits, sizeof(float));
+        return result;
+    }
+#if RT_DENOISE_SIMD
+    __m128 FastExp(__m128 x)
+    {
+        __m128 t = _mm_mul_ps(_mm_max_ps(x, _mm_set1_ps(-80.0f)), _mm_set1_ps(1.44269504f));
+
+        //Round towards negative infinity, rather than towards zero like the conversion does.
+        __m128i wholeI = _mm_cvttps_epi32(t);
+        __m128 whole = _mm_cvtepi32_ps(wholeI);
+        __m128 isTooHigh = _mm_cmpgt_ps(whole, t);
+        whole = _mm_sub_ps(whole, _mm_and_ps(isTooHigh, _mm_set1_ps(1.0f)));
+        wholeI = _mm_cvttps_epi32(whole);
+
+        __m128 fraction = _mm_sub_ps(t, whole);
+        __m128 result = _mm_mul_ps(fraction, _mm_set1_ps(0.07706752f));
+        result = _mm_mul_ps(fraction, _mm_add_ps(result, _mm_set1_ps(0.22764561f)));
+        result = _mm_mul_ps(fraction, _mm_add_ps(result, _mm_set1_ps(0.69511647f)));
+        result = _mm_add_ps(result, _mm_set1_ps(1.0f));
+
+        return _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(result), _mm_slli_epi32(wholeI, 23)));
+    }
+#endif
+
+
+    //An image split into one array per channel, so that neighboring pixels can be loaded together.
+    struct Planes
+    {
+        std::vector<float> R, G, B;
+
+        Planes(size_t nPixels) : R(nPixels), G(nPixels), B(nPixels) { }
+    };
+    //The AOV values used to decide how much neighboring pixels should affect each other.
+    struct Guide
+    {
+        std::vector<float> NX, NY, NZ, Depth, AR, AG, AB;
+
+        Guide(size_t nPixels)
+            : NX(nPixels), NY(nPixels), NZ(nPixels), Depth(nPixels),
+              AR(nPixels), AG(nPixels), AB(nPixels) { }
+    };
+
+    //The settings for one filter pass.
+    struct Pass
+    {
+        size_t Width, Height, Step;
+        float InvColorSigmaSqr, InvNormalSigmaSqr, InvDepthSigma, InvAlbedoSigmaSqr;
+        const Planes* In;
+        Planes* Out;
+        const Guide* G;
+    };
+
+
+    //Filters one pixel, skipping any taps outside the image.
+    void FilterPixel(const Pass& pass, size_t x, size_t y)
+    {
+        const Planes& in = *pass.In;
+        const Guide& g = *pass.G;
+        size_t p = x + (y * pass.Width);
+        float invDepth = pass.InvDepthSigma / std::max(g.Depth[p], minDepth);
+
+        float sumR = 0.0f, sumG = 0.0f, sumB = 0.0f, sumWeight = 0.0f;
+        for (int ky = 0; ky < 5; ++ky)
+        {
+            long long qy = (long long)y + ((ky - 2) * (long long)pass.Step);
+            if (qy < 0 || qy >= (long long)pass.Height)
+                continue;
+
+            for (int kx = 0; kx < 5; ++kx)
+            {
+                long long qx = (long long)x + ((kx - 2) * (long long)pass.Step);
+                if (qx < 0 || qx >= (long long)pass.Width)
+                    continue;
+                size_t q = (size_t)qx + ((size_t)qy * pass.Width);
+
+                float dR = in.R[q] - in.R[p], dG = in.G[q] - in.G[p], dB = in.B[q] - in.B[p],
+                      dNX = g.NX[q] - g.NX[p], dNY = g.NY[q] - g.NY[p], dNZ = g.NZ[q] - g.NZ[p],
+                      dAR = g.AR[q] - g.AR[p], dAG = g.AG[q] - g.AG[p], dAB = g.AB[q] - g.AB[p];
+                float exponent = (((dR * dR) + (dG * dG) + (dB * dB)) * pass.InvColorSigmaSqr) +
+                                 (((dNX * dNX) + (dNY * dNY) + (dNZ * dNZ)) * pass.InvNormalSigmaSqr) +
+                                 (std::abs(g.Depth[q] - g.Depth[p]) * invDepth) +
+                                 (((dAR * dAR) + (dAG * dAG) + (dAB * dAB)) * pass.InvAlbedoSigmaSqr);
+                float weight = kernel[kx] * kernel[ky] * FastExp(-exponent);
+
+                sumR += in.R[q] * weight;
+                sumG += in.G[q] * weight;
+                sumB += in.B[q] * weight;
+                sumWeight += weight;
+            }
+        }
+
+        //The center tap always has a weight, so this never divides by zero.
+        float invSumWeight = 1.0f / sumWeight;
+        pass.Out->R[p] = sumR * invSumWeight;
+        pass.Out->G[p] = sumG * invSumWeight;
+        pass.Out->B[p] = sumB * invSumWeight;
+    }
+
+#if RT_DENOISE_SIMD
+    //Filters the four pixels starting at the given one.
+    //Every tap must be inside the image horizontally; taps outside it vertically are skipped.
+    void FilterPixels4(const Pass& pass, size_t x, size_t y)
+    {
+        const Planes& in = *pass.In;
+        const Guide& g = *pass.G;
+        size_t p = x + (y * pass.Width);
+
+        __m128 pR = _mm_loadu_ps(&in.R[p]), pG = _mm_loadu_ps(&in.G[p]), pB = _mm_loadu_ps(&in.B[p]),
+               pNX = _mm_loadu_ps(&g.NX[p]), pNY = _mm_loadu_ps(&g.NY[p]), pNZ = _mm_loadu_ps(&g.NZ[p]),
+               pAR = _mm_loadu_ps(&g.AR[p]), pAG = _mm_loadu_ps(&g.AG[p]), pAB = _mm_loadu_ps(&g.AB[p]),
+               pDepth = _mm_loadu_ps(&g.Depth[p]);
+        __m128 invColorSigmaSqr = _mm_set1_ps(pass.InvColorSigmaSqr),
+               invNormalSigmaSqr = _mm_set1_ps(pass.InvNormalSigmaSqr),
+               invAlbedoSigmaSqr = _mm_set1_ps(pass.InvAlbedoSigmaSqr),
+               invDepth = _mm_div_ps(_mm_set1_ps(pass.InvDepthSigma), _mm_max_ps(pDepth, _mm_set1_ps(minDepth))),
+               signMask = _mm_set1_ps(-0.0f);
+
+        __m128 sumR = _mm_setzero_ps(), sumG = _mm_setzero_ps(), sumB = _mm_setzero_ps(),
+               sumWeight = _mm_setzero_ps();
+        for (int ky = 0; ky < 5; ++ky)
+        {
+            long long qy = (long long)y + ((ky - 2) * (long long)pass.Step);
+            if (qy < 0 || qy >= (long long)pass.Height)
+                continue;
+
+            for (int kx = 0; kx < 5; ++kx)
+            {
+                size_t q = (size_t)((long long)x + ((kx - 2) * (long long)pass.Step)) + ((size_t)qy * pass.Width);
+
+                __m128 qR = _mm_loadu_ps(&in.R[q]), qG = _mm_loadu_ps(&in.G[q]), qB = _mm_loadu_ps(&in.B[q]);
+                __m128 dR = _mm_sub_ps(qR, pR), dG = _mm_sub_ps(qG, pG), dB = _mm_sub_ps(qB, pB),
+                       dNX = _mm_sub_ps(_mm_loadu_ps(&g.NX[q]), pNX),
+                       dNY = _mm_sub_ps(_mm_loadu_ps(&g.NY[q]), pNY),
+                       dNZ = _mm_sub_ps(_mm_loadu_ps(&g.NZ[q]), pNZ),
+                       dAR = _mm_sub_ps(_mm_loadu_ps(&g.AR[q]), pAR),
+                       dAG = _mm_sub_ps(_mm_loadu_ps(&g.AG[q]), pAG),
+                       dAB = _mm_sub_ps(_mm_loadu_ps(&g.AB[q]), pAB),
+                       dDepth = _mm_andnot_ps(signMask, _mm_sub_ps(_mm_loadu_ps(&g.Depth[q]), pDepth));
+
+                __m128 colorDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dR, dR), _mm_mul_ps(dG, dG)), _mm_mul_ps(dB, dB)),
+                       normalDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dNX, dNX), _mm_mul_ps(dNY, dNY)),
+                                               _mm_mul_ps(dNZ, dNZ)),
+                       albedoDist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dAR, dAR), _mm_mul_ps(dAG, dAG)),
+                                               _mm_mul_ps(dAB, dAB));
+                __m128 exponent = _mm_add_ps(_mm_mul_ps(colorDist, invColorSigmaSqr),
+                                             _mm_mul_ps(normalDist, invNormalSigmaSqr));
+                exponent = _mm_add_ps(exponent, _mm_mul_ps(dDepth, invDepth));
+                exponent = _mm_add_ps(exponent, _mm_mul_ps(albedoDist, invAlbedoSigmaSqr));
+                __m128 weight = _mm_mul_ps(_mm_set1_ps(kernel[kx] * kernel[ky]),
+                                           FastExp(_mm_sub_ps(_mm_setzero_ps(), exponent)));
+
+                sumR = _mm_add_ps(sumR, _mm_mul_ps(qR, weight));
+                sumG = _mm_add_ps(sumG, _mm_mul_ps(qG, weight));
+                sumB = _mm_add_ps(sumB, _mm_mul_ps(qB, weight));
+                sumWeight = _mm_add_ps(sumWeight, weight);
+            }
+        }
+
+        __m128 invSumWeight = _mm_div_ps(_mm_set1_ps(1.0f), sumWeight);
+        _mm_storeu_ps(&pass.Out->R[p], _mm_mul_ps(sumR, invSumWeight));
+        _mm_storeu_ps(&pass.Out->G[p], _mm_mul_ps(sumG, invSumWeight));
+        _mm_storeu_ps(&pass.Out->B[p], _mm_mul_ps(sumB, invSumWeight));
+    }
+#endif
+
+    void FilterRow(const Pass& pass, size_t y)
+    {
+        size_t x = 0;
+#if RT_DENOISE_SIMD
+        //Groups of four are only used where all their taps are inside the image,
+        //    so they don't need to check each one.
+        size_t reach = 2 * pass.Step;
+        for (; x < reach && x < pass.Width; ++x)
+            FilterPixel(pass, x, y);
+        for (; x + 4 + reach <= pass.Width; x += 4)
+            FilterPixels4(pass, x, y);
+#endif
+        for (; x < pass.Width; ++x)
+            FilterPixel(pass, x, y);
+    }
+}
+
+
+void Denoiser::Denoise(const Texture2D& image, const AOVBuffers& features,
+                       Texture2D& outImage, ThreadPool& pool) const
+{
+    size_t width = image.GetWidth(),
+           height = image.GetHeight(),
+           nPixels = width * height;
+    assert(features.GetWidth() == width && features.GetHeight() == height);
+    assert(outImage.GetWidth() == width && outImage.GetHeight() == height);
+
+    //Split the image and its features into planes, and divide out the albedo.
+    Planes planesA(nPixels), planesB(nPixels);
+    Guide guide(nPixels);
+    std::vector<Vector3f> albedos(nPixels);
+    pool.ParallelFor(height, [&](size_t y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            size_t p = x + (y * width);
+            const AOVBuffers::Pixel& f = features.Get(x, y);
+            Vector3f color = image.GetColor(x, y);
+
+            albedos[p] = Vector3f(std::max(f.Albedo.x, minAlbedo),
+                                  std::max(f.Albedo.y, minAlbedo),
+                                  std::max(f.Albedo.z, minAlbedo));
+            planesA.R[p] = color.x / albedos[p].x;
+            planesA.G[p] = color.y / albedos[p].y;
+            planesA.B[p] = color.z / albedos[p].z;
+
+            guide.NX[p] = f.Normal.x;
+            guide.NY[p] = f.Normal.y;
+            guide.NZ[p] = f.Normal.z;
+            guide.Depth[p] = (std::isfinite(f.Depth) ? f.Depth : skyDepth);
+            guide.AR[p] = f.Albedo.x;
+            guide.AG[p] = f.Albedo.y;
+            guide.AB[p] = f.Albedo.z;
+        }
+    });
+
+    //Run each pass, going back and forth between the two sets of planes.
+    Pass pass;
+    pass.Width = width;
+    pass.Height = height;
+    pass.G = &guide;
+    pass.InvNormalSigmaSqr = 1.0f / (NormalSigma * NormalSigma);
+    pass.InvDepthSigma = 1.0f / DepthSigma;
+    pass.InvAlbedoSigmaSqr = 1.0f / (AlbedoSigma * AlbedoSigma);
+    Planes *in = &planesA, *out = &planesB;
+    float colorSigma = ColorSigma;
+    for (size_t i = 0; i < NPasses; ++i)
+    {
+        pass.In = in;
+        pass.Out = out;
+        pass.Step = (size_t)1 << i;
+        pass.InvColorSigmaSqr = 1.0f / (colorSigma * colorSigma);
+        pool.ParallelFor(height, [&](size_t y) { FilterRow(pass, y); });
+
+        std::swap(in, out);
+        colorSigma *= 0.5f;
+    }
+
+    //Put the albedo back in.
+    const Planes& result = *in;
+    pool.ParallelFor(height, [&](size_t y)
+    {
+        for (size_t x = 0; x < width; ++x)
+        {
+            size_t p = x + (y * width);
+            outImage.SetColor(x, y, Vector3f(result.R[p] * albedos[p].x,
+                                             result.G[p] * albedos[p].y,
+                                             result.B[p] * albedos[p].z));
+        }
+    });
+}
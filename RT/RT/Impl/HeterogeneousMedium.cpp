@@ -0,0 +1,291 @@
+#include "../Headers/HeterogeneousMedium.h"
+
+#include <algorithm>
+
+#include "../Headers/Material.h"
+#include "../Headers/MaterialValueGraph.h"
+#include "../Headers/ThreadPool.h"
+#include "../Headers/Samplers.h"
+
+using namespace RT;
+
+
+ADD_SHAPE_REFLECTION_DATA_CPP(HeterogeneousMedium);
+
+
+void HeterogeneousMedium::PrecalcData()
+{
+    Surface->PrecalcData();
+    BuildMajorants();
+}
+void HeterogeneousMedium::UpdatePrecalcData()
+{
+    Surface->UpdatePrecalcData();
+    BuildMajorants();
+}
+void HeterogeneousMedium::BuildMajorants()
+{
+    Surface->GetBoundingBox(bounds);
+
+    const unsigned int size = MajorantGridSize;
+    cellSize = bounds.GetSize() / (float)size;
+    for (int axis = 0; axis < 3; ++axis)
+        invCellSize[axis] = (cellSize[axis] > 0.0f ? (1.0f / cellSize[axis]) : 0.0f);
+
+    majorants.resize(size * size * size);
+    ThreadPool::GetGlobal().ParallelFor(size, [&](size_t z)
+    {
+        FastRand prng((int)z, 3463);
+        unsigned int gridSizes[3] = { GridSizeX, GridSizeY, GridSizeZ };
+
+        for (unsigned int y = 0; y < size; ++y)
+        {
+            for (unsigned int x = 0; x < size; ++x)
+            {
+                Vector3f cellMin = bounds.Min + (cellSize * Vector3f((float)x, (float)y, (float)z));
+                float& majorant = majorants[x + (y * size) + (z * size * size)];
+                majorant = 0.0f;
+
+                if (DensityGrid.GetSize() > 0)
+                {
+                    //The grid is blended trilinearly, so the density can't be higher than
+                    //    the highest grid value around this cell.
+                    unsigned int first[3], last[3];
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        float scale = (float)gridSizes[axis] / (float)size;
+                        float min = ((float)((axis == 0) ? x : ((axis == 1) ? y : z)) * scale) - 0.5f,
+                              max = min + scale;
+                        first[axis] = (unsigned int)std::max(0.0f, floorf(min));
+                        last[axis] = (unsigned int)std::min((float)gridSizes[axis] - 1.0f,
+                                                            std::max(0.0f, ceilf(max)));
+                    }
+
+                    for (unsigned int gZ = first[2]; gZ <= last[2]; ++gZ)
+                        for (unsigned int gY = first[1]; gY <= last[1]; ++gY)
+                            for (unsigned int gX = first[0]; gX <= last[0]; ++gX)
+                                majorant = std::max(majorant,
+                                                    DensityGrid[gX + (gY * GridSizeX) + (gZ * GridSizeX * GridSizeY)]);
+                    majorant *= DensityScale;
+                }
+                else
+                {
+                    const unsigned int nSamples = MajorantSamplesPerAxis;
+                    for (unsigned int sZ = 0; sZ < nSamples; ++sZ)
+                        for (unsigned int sY = 0; sY < nSamples; ++sY)
+                            for (unsigned int sX = 0; sX < nSamples; ++sX)
+                            {
+                                Vector3f t((float)sX, (float)sY, (float)sZ);
+                                Vector3f pos = cellMin + (cellSize * t / (float)(nSamples - 1));
+                                majorant = std::max(majorant,
+                                                    GetDensity(pos, Ray(pos, Vector3f::Y()), prng));
+                            }
+                    majorant *= MajorantPadding;
+                }
+            }
+        }
+    });
+}
+
+bool HeterogeneousMedium::GetInterval(const Ray& ray, FastRand& prng, float tMin, float tMax,
+                                      float& outEnterT, float& outExitT) const
+{
+    if (!bounds.RayIntersects(ray, tMin, tMax))
+        return false;
+
+    if (!Surface->CastRayInterval(ray, prng, Material::PushoffDist, outEnterT, outExitT))
+        return false;
+
+    //Clamp the entrance/exit positions along the ray.
+    outEnterT = std::max(outEnterT, std::max(tMin, 0.0f));
+    outExitT = std::min(outExitT, tMax);
+    return outEnterT < outExitT;
+}
+
+template<typename CellVisitor>
+void HeterogeneousMedium::WalkMajorants(const Ray& ray, float tMin, float tMax, CellVisitor visitCell) const
+{
+    const int size = (int)MajorantGridSize;
+
+    //Find the cell the ray starts in, and when it crosses into the next cell along each axis.
+    Vector3f startPos = ray.GetPos(tMin),
+             invDir = ray.GetDir().Reciprocal();
+    int cell[3], step[3];
+    float tNext[3], tDelta[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float cellF = (startPos[axis] - bounds.Min[axis]) * invCellSize[axis];
+        cell[axis] = std::min(size - 1, std::max(0, (int)cellF));
+
+        float dir = ray.GetDir()[axis];
+        if (dir == 0.0f)
+        {
+            step[axis] = 0;
+            tNext[axis] = std::numeric_limits<float>::infinity();
+            tDelta[axis] = std::numeric_limits<float>::infinity();
+        }
+        else
+        {
+            step[axis] = (dir > 0.0f ? 1 : -1);
+            float nextPlane = bounds.Min[axis] + (cellSize[axis] * (float)(cell[axis] + (dir > 0.0f ? 1 : 0)));
+            tNext[axis] = (nextPlane - ray.GetPos()[axis]) * invDir[axis];
+            tDelta[axis] = cellSize[axis] * fabsf(invDir[axis]);
+        }
+    }
+
+    float tCellEnter = tMin;
+    while (tCellEnter < tMax)
+    {
+        int axis = (tNext[0] < tNext[1]) ?
+                       ((tNext[0] < tNext[2]) ? 0 : 2) :
+                       ((tNext[1] < tNext[2]) ? 1 : 2);
+        float tCellExit = std::min(tNext[axis], tMax);
+
+        float majorant = majorants[cell[0] + (cell[1] * size) + (cell[2] * size * size)];
+        if (tCellExit > tCellEnter && visitCell(tCellEnter, tCellExit, majorant))
+            return;
+
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= size)
+            return;
+        tCellEnter = std::max(tCellEnter, tCellExit);
+        tNext[axis] += tDelta[axis];
+    }
+}
+
+bool HeterogeneousMedium::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                                  float tMin, float tMax) const
+{
+    float entranceT, exitT;
+    if (!GetInterval(ray, prng, tMin, tMax, entranceT, exitT))
+        return false;
+
+    //Delta tracking: take steps as if the whole cell had its maximum density,
+    //    and at each one, randomly decide whether a particle was actually there
+    //    based on how the real density compares to the maximum.
+    float dirLength = ray.GetDir().Length();
+    bool hitAnything = false;
+    float hitT;
+    WalkMajorants(ray, entranceT, exitT, [&](float tEnter, float tExit, float majorant)
+    {
+        if (majorant <= 0.0f)
+            return false;
+
+        float invMajorant = 1.0f / (majorant * dirLength);
+        float t = tEnter;
+        while (true)
+        {
+            t -= log(prng.NextFloat()) * invMajorant;
+            if (t >= tExit)
+                return false;
+
+            Vector3f pos = ray.GetPos(t);
+            if (prng.NextFloat() * majorant < GetDensity(pos, ray, prng))
+            {
+                hitAnything = true;
+                hitT = t;
+                return true;
+            }
+        }
+    });
+    if (!hitAnything)
+        return false;
+
+    outHit.Pos = ray.GetPos(hitT);
+
+    //The particles are randomly oriented, so the normal/tangent/bitangent is random.
+    outHit.Normal = prng.NextUnitVector3();
+    outHit.Normal.GetOrthoBasis(outHit.Tangent, outHit.Bitangent);
+    //Make the UV random as well.
+    outHit.UV = Vector2f(prng.NextFloat(), prng.NextFloat());
+
+    return true;
+}
+
+float HeterogeneousMedium::GetDensity(const Vector3f& worldPos, const Ray& ray, FastRand& prng) const
+{
+    if (DensityGrid.GetSize() > 0)
+        return DensityScale * GetGridDensity(worldPos);
+
+    //MaterialValues draw from a sampler, but a walk through the medium takes an unknown number of steps,
+    //    so give it plain random numbers continuing on from this medium's stream.
+    Vertex surface;
+    surface.Pos = worldPos;
+    Sampler_Random sampler(prng.NextInt());
+    return DensityScale * (float)Density->GetValue(ray, sampler, this, &surface);
+}
+float HeterogeneousMedium::GetGridDensity(const Vector3f& worldPos) const
+{
+    unsigned int gridSizes[3] = { GridSizeX, GridSizeY, GridSizeZ };
+
+    //Get the two grid values to blend between along each axis.
+    unsigned int min[3], max[3];
+    float t[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float gridPos = ((worldPos[axis] - bounds.Min[axis]) * invCellSize[axis] *
+                         (float)gridSizes[axis] / (float)MajorantGridSize) - 0.5f;
+        gridPos = std::max(0.0f, std::min((float)gridSizes[axis] - 1.0f, gridPos));
+
+        min[axis] = (unsigned int)gridPos;
+        max[axis] = std::min(min[axis] + 1, gridSizes[axis] - 1);
+        t[axis] = gridPos - (float)min[axis];
+    }
+
+    auto get = [&](unsigned int x, unsigned int y, unsigned int z)
+        { return DensityGrid[x + (y * GridSizeX) + (z * GridSizeX * GridSizeY)]; };
+    auto lerp = [](float a, float b, float t) { return a + ((b - a) * t); };
+
+    float y0 = lerp(lerp(get(min[0], min[1], min[2]), get(max[0], min[1], min[2]), t[0]),
+                    lerp(get(min[0], max[1], min[2]), get(max[0], max[1], min[2]), t[0]),
+                    t[1]),
+          y1 = lerp(lerp(get(min[0], min[1], max[2]), get(max[0], min[1], max[2]), t[0]),
+                    lerp(get(min[0], max[1], max[2]), get(max[0], max[1], max[2]), t[0]),
+                    t[1]);
+    return lerp(y0, y1, t[2]);
+}
+
+void HeterogeneousMedium::WriteData(DataWriter& writer) const
+{
+    Shape::WriteData(writer);
+
+    Shape::WriteValue(*Surface, writer, "Surface");
+
+    MaterialValueGraph graph(List<const MaterialValue*>(Density.Get()));
+    writer.WriteDataStructure(graph, "Density");
+    writer.WriteFloat(MajorantPadding, "MajorantPadding");
+
+    writer.WriteUInt(GridSizeX, "GridSizeX");
+    writer.WriteUInt(GridSizeY, "GridSizeY");
+    writer.WriteUInt(GridSizeZ, "GridSizeZ");
+    writer.WriteFloats(DensityGrid.GetData(), DensityGrid.GetSize(), "DensityGrid");
+
+    writer.WriteFloat(DensityScale, "DensityScale");
+}
+void HeterogeneousMedium::ReadData(DataReader& reader)
+{
+    Shape::ReadData(reader);
+
+    Shape::ReadValue(Surface, reader, "Surface");
+
+    MaterialValueGraph graph;
+    reader.ReadDataStructure(graph, "Density");
+    Density = graph.GetRootVals()[0];
+    reader.ReadFloat(MajorantPadding, "MajorantPadding");
+
+    reader.ReadUInt(GridSizeX, "GridSizeX");
+    reader.ReadUInt(GridSizeY, "GridSizeY");
+    reader.ReadUInt(GridSizeZ, "GridSizeZ");
+    reader.ReadFloats(DensityGrid, "DensityGrid");
+    if (DensityGrid.GetSize() > 0 &&
+        DensityGrid.GetSize() != (size_t)GridSizeX * (size_t)GridSizeY * (size_t)GridSizeZ)
+    {
+        reader.ErrorMessage = "Density grid should have ";
+        reader.ErrorMessage += String((size_t)GridSizeX * (size_t)GridSizeY * (size_t)GridSizeZ);
+        reader.ErrorMessage += " values but it had ";
+        reader.ErrorMessage += String(DensityGrid.GetSize());
+        throw DataReader::EXCEPTION_FAILURE;
+    }
+
+    reader.ReadFloat(DensityScale, "DensityScale");
+}
\ No newline at end of file
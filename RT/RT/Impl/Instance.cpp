@@ -0,0 +1,124 @@
+#include "../Headers/Instance.h"
+
+using namespace RT;
+
+
+ADD_SHAPE_REFLECTION_DATA_CPP(Instance);
+
+
+namespace
+{
+    thread_local const ConstShapeToID* currentGeometryToID = nullptr;
+    thread_local const IDToShape* currentIDToGeometry = nullptr;
+}
+
+
+Instance::GeometryIDScope::GeometryIDScope(const ConstShapeToID* geometryToID,
+                                           const IDToShape* idToGeometry)
+    : prevGeometryToID(currentGeometryToID), prevIDToGeometry(currentIDToGeometry)
+{
+    currentGeometryToID = geometryToID;
+    currentIDToGeometry = idToGeometry;
+}
+Instance::GeometryIDScope::~GeometryIDScope()
+{
+    currentGeometryToID = prevGeometryToID;
+    currentIDToGeometry = prevIDToGeometry;
+}
+
+
+void Instance::PrecalcData()
+{
+    BoundingBox geometryBounds;
+    Geometry->GetBoundingBox(geometryBounds);
+    bounds = geometryBounds.GetTransformed(Tr);
+}
+
+bool Instance::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                       float tMin, float tMax) const
+{
+    float tScale;
+    Ray localRay = GetLocalRay(ray, tScale);
+
+    if (!Geometry->CastRay(localRay, outHit, prng, tMin * tScale, tMax * tScale))
+        return false;
+
+    outHit.Pos = Tr.Point_LocalToWorld(outHit.Pos);
+    outHit.Normal = Tr.Normal_LocalToWorld(outHit.Normal).Normalize();
+    outHit.Tangent = Tr.Dir_LocalToWorld(outHit.Tangent).Normalize();
+    outHit.Bitangent = outHit.Normal.Cross(outHit.Tangent);
+    return true;
+}
+
+bool Instance::CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                               float& outEnterT, float& outExitT) const
+{
+    float tScale;
+    Ray localRay = GetLocalRay(ray, tScale);
+
+    if (!Geometry->CastRayInterval(localRay, prng, minThickness * tScale, outEnterT, outExitT))
+        return false;
+
+    outEnterT /= tScale;
+    outExitT /= tScale;
+    return true;
+}
+Ray Instance::GetLocalRay(const Ray& ray, float& outTScale) const
+{
+    //Transform the ray into the geometry's space.
+    //The geometry expects a normalized ray, so the ray's "t" values have to be scaled to match:
+    //    moving "t" along the world ray moves "t * localLength" along the normalized local one.
+    Vector3f localDir = Tr.Dir_WorldToLocal(ray.GetDir());
+    float localLength = localDir.Length();
+    outTScale = localLength;
+    return Ray(Tr.Point_WorldToLocal(ray.GetPos()), localDir / localLength);
+}
+
+void Instance::WriteData(DataWriter& writer) const
+{
+    Shape::WriteData(writer);
+
+    const unsigned int* id = (currentGeometryToID == nullptr ?
+                                  nullptr :
+                                  currentGeometryToID->TryGet(Geometry.Get()));
+    if (id != nullptr)
+        writer.WriteUInt(*id, "GeometryID");
+    else
+        Shape::WriteValue(*Geometry, writer, "Geometry");
+}
+void Instance::ReadData(DataReader& reader)
+{
+    Shape::ReadData(reader);
+
+    //If the geometry was written with an ID, look it up.
+    if (currentIDToGeometry != nullptr)
+    {
+        unsigned int id;
+        bool hasID = true;
+        try
+        {
+            reader.ReadUInt(id, "GeometryID");
+        }
+        catch (int)
+        {
+            reader.ErrorMessage = "";
+            hasID = false;
+        }
+
+        if (hasID)
+        {
+            const SharedPtr<Shape>* geometry = currentIDToGeometry->TryGet(id);
+            if (geometry == nullptr)
+            {
+                reader.ErrorMessage = "Instance refers to nonexistent geometry ID ";
+                reader.ErrorMessage += String((size_t)id);
+                throw DataReader::EXCEPTION_FAILURE;
+            }
+
+            Geometry = *geometry;
+            return;
+        }
+    }
+
+    Shape::ReadValue(Geometry, reader, "Geometry");
+}
@@ -2,6 +2,8 @@
 
 #include "../Headers/ThirdParty/base64.h"
 #include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
 
 using namespace RT;
 
@@ -9,6 +11,32 @@ using namespace RT;
 #pragma warning( disable : 4996 )
 
 
+namespace
+{
+    //Finds the shortest decimal string that reads back as exactly the given float,
+    //    and returns the double it represents.
+    //This way, a value like 0.9f is stored as "0.9" instead of "0.899999976158142".
+    double ToShortestDouble(float f)
+    {
+        if (!std::isfinite(f))
+            return (double)f;
+
+        char buffer[32];
+        for (int precision = 6; precision < 9; ++precision)
+        {
+            snprintf(buffer, sizeof(buffer), "%.*g", precision, f);
+            double d = strtod(buffer, nullptr);
+            if ((float)d == f)
+                return d;
+        }
+
+        //9 significant digits is always enough to round-trip a float.
+        snprintf(buffer, sizeof(buffer), "%.9g", f);
+        return strtod(buffer, nullptr);
+    }
+}
+
+
 bool RT_API JsonSerialization::ToJSONFile(const String& filePath, const IWritable& toWrite,
                                           bool compact, String& outErrorMsg)
 {
@@ -129,7 +157,7 @@ void JsonWriter::WriteUInt(unsigned int value, const String& name)
 }
 void JsonWriter::WriteFloat(float value, const String& name)
 {
-    GetToUse()[name.CStr()] = value;
+    GetToUse()[name.CStr()] = ToShortestDouble(value);
 }
 void JsonWriter::WriteDouble(double value, const String& name)
 {
@@ -152,8 +180,8 @@ void JsonWriter::WriteString(const String& value, const String& name)
 }
 void JsonWriter::WriteBytes(const unsigned char* bytes, size_t nBytes, const String& name)
 {
-    String str = base64::encode(bytes, nBytes).c_str();
-    WriteString(str, name);
+    //Base64 never contains characters that need escaping, so skip "WriteString()".
+    GetToUse()[name.CStr()] = base64::encode(bytes, nBytes);
 }
 void JsonWriter::WriteDataStructure(const IWritable& toSerialize, const String& name)
 {
@@ -182,11 +210,13 @@ String JsonReader::Reload(const String& filePath)
     std::streampos size = fileS.tellg();
     fileS.seekg(0, std::ios::beg);
 
-    std::vector<char> fileData;
+    //Note that in text mode, fewer characters may be read than the file's size.
+    std::string fileData;
     fileData.resize((size_t)size);
-    fileS.read(fileData.data(), size);
+    fileS.read(&fileData[0], size);
+    fileData.resize((size_t)fileS.gcount());
 
-    doc = nlohmann::json::parse(std::string(fileData.data()));
+    doc = nlohmann::json::parse(fileData);
 
     return "";
 }
@@ -208,6 +238,12 @@ nlohmann::json::const_iterator JsonReader::GetItem(const String& name)
     return element;
 }
 
+bool JsonReader::HasElement(const String& name)
+{
+    const nlohmann::json& jsn = GetToUse();
+    return jsn.find(name.CStr()) != jsn.end();
+}
+
 void JsonReader::ReadBool(bool& outB, const String& name)
 {
     auto& element = GetItem(name);
@@ -274,15 +310,19 @@ void JsonReader::ReadString(String& outStr, const String& name)
 }
 void JsonReader::ReadBytes(List<unsigned char>& outBytes, const String& name)
 {
-    String str;
-    ReadString(str, name);
+    //Base64 never contains escaped characters, so skip "ReadString()".
+    auto& element = GetItem(name);
+    Assert(element->is_string(), "Expected a base64 string but got something else");
 
     std::vector<unsigned char> _outBytes;
-    base64::decode(str.CStr(), _outBytes);
+    base64::decode(element->get_ref<const std::string&>(), _outBytes);
 
     outBytes.Resize(_outBytes.size());
-    memcpy_s(outBytes.GetData(), outBytes.GetSize(),
-             _outBytes.data(), _outBytes.size());
+    if (_outBytes.size() > 0)
+    {
+        memcpy_s(outBytes.GetData(), outBytes.GetSize(),
+                 _outBytes.data(), _outBytes.size());
+    }
 }
 void JsonReader::ReadDataStructure(IReadable& outData, const String& name)
 {
@@ -290,7 +330,16 @@ void JsonReader::ReadDataStructure(IReadable& outData, const String& name)
     Assert(element->is_object(), "Expected a data structure but got something else");
     
     JsonReader subReader(&(*element));
-    outData.ReadData(subReader);
+    try
+    {
+        outData.ReadData(subReader);
+    }
+    catch (int)
+    {
+        //Pass the error up, so the message isn't lost along with the sub-reader.
+        ErrorMessage = subReader.ErrorMessage;
+        throw;
+    }
 }
 
 
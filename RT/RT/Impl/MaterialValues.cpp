@@ -82,10 +82,10 @@ String MV_Tex2D::Reload(const String& _filePath,
 }
 
 
-Vectorf MV_Swizzle::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_Swizzle::GetValue(const Ray& ray, Sampler& sampler,
                              const Shape* shpe, const Vertex* surface) const
 {
-    Vectorf in = Val->GetValue(ray, prng, shpe, surface);
+    Vectorf in = Val->GetValue(ray, sampler, shpe, surface);
     Vectorf out;
 
     out.NValues = (Dimensions)NValues;
@@ -126,14 +126,14 @@ Dimensions MV_Map::GetNDims() const
                        Max(DestMin->GetNDims(),
                            DestMax->GetNDims()))));
 }
-Vectorf MV_Map::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_Map::GetValue(const Ray& ray, Sampler& sampler,
                          const Shape* shpe, const Vertex* surface) const
 {
-    auto x = X->GetValue(ray, prng, shpe, surface),
-         srcMin = SrcMin->GetValue(ray, prng, shpe, surface),
-         srcMax = SrcMax->GetValue(ray, prng, shpe, surface),
-         destMin = DestMin->GetValue(ray, prng, shpe, surface),
-         destMax = DestMax->GetValue(ray, prng, shpe, surface);
+    auto x = X->GetValue(ray, sampler, shpe, surface),
+         srcMin = SrcMin->GetValue(ray, sampler, shpe, surface),
+         srcMax = SrcMax->GetValue(ray, sampler, shpe, surface),
+         destMin = DestMin->GetValue(ray, sampler, shpe, surface),
+         destMax = DestMax->GetValue(ray, sampler, shpe, surface);
 
     auto t = srcMin.OperateOn(Mathf::InvLerp, srcMax, x);
     return destMin.OperateOn(Mathf::Lerp, destMax, t);
@@ -163,22 +163,22 @@ void MV_Map::SetChild(size_t i, const Ptr& newChild)
     }
 }
 
-Vectorf MV_Cross::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_Cross::GetValue(const Ray& ray, Sampler& sampler,
                            const Shape* shpe, const Vertex* surface) const
 {
-    Vector3f a = A->GetValue(ray, prng, shpe, surface),
-             b = B->GetValue(ray, prng, shpe, surface);
+    Vector3f a = A->GetValue(ray, sampler, shpe, surface),
+             b = B->GetValue(ray, sampler, shpe, surface);
     return a.Cross(b);
 }
 
-Vectorf MV_PureNoise::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_PureNoise::GetValue(const Ray& ray, Sampler& sampler,
                                const Shape* shpe,
                                const Vertex* surface) const
 {
     Vectorf noiseVal;
     noiseVal.NValues = NDims;
     for (size_t i = 0; i < NDims; ++i)
-        noiseVal[i] = prng.NextFloat();
+        noiseVal[i] = sampler.NextFloat();
     return noiseVal;
 }
 void MV_PureNoise::WriteData(DataWriter& data, const String& namePrefix,
@@ -609,11 +609,11 @@ namespace NoiseFuncs
                                                                    WorleyDist_Manhattan1(p1.z, p2.z) +
                                                                    WorleyDist_Manhattan1(p1.w, p2.w); }
 }
-Vectorf MV_PerlinNoise::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_PerlinNoise::GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe,
                                  const Vertex* surface) const
 {
-    Vectorf x = X->GetValue(ray, prng, shpe, surface);
+    Vectorf x = X->GetValue(ray, sampler, shpe, surface);
     switch (x.NValues)
     {
         case RT::Dimensions::One: return NoiseFuncs::Perlin(x.x);
@@ -623,13 +623,13 @@ Vectorf MV_PerlinNoise::GetValue(const Ray& ray, FastRand& prng,
         default: assert(false); return 0.5f;
     }
 }
-Vectorf MV_WorleyNoise::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_WorleyNoise::GetValue(const Ray& ray, Sampler& sampler,
                                  const Shape* shpe,
                                  const Vertex* surface) const
 {
     //Get the inputs.
-    Vectorf x = X->GetValue(ray, prng, shpe, surface);
-    Vectorf variance = Variance->GetValue(ray, prng, shpe, surface);
+    Vectorf x = X->GetValue(ray, sampler, shpe, surface);
+    Vectorf variance = Variance->GetValue(ray, sampler, shpe, surface);
     Dimensions size = Max(x.NValues, variance.NValues);
 
     //Get the two closest distances.
@@ -761,7 +761,7 @@ void MV_WorleyNoise::ReadData(DataReader& data, const String& namePrefix,
 
 #pragma region Helper macro definitions
 
-#define GET_VAL(ptr) (ptr->GetValue(ray, prng, shpe, surface))
+#define GET_VAL(ptr) (ptr->GetValue(ray, sampler, shpe, surface))
 
 #define COMMA(thing1, thing2) thing1, thing2
 #define COMMA3(thing1, thing2, thing3) thing1, thing2, thing3
@@ -779,7 +779,7 @@ void MV_WorleyNoise::ReadData(DataReader& data, const String& namePrefix,
             d = Max(d, listParamName[i]->GetNDims()); \
         return d; \
     } \
-    Vectorf MV_##name::GetValue(const Ray& ray, FastRand& prng, \
+    Vectorf MV_##name::GetValue(const Ray& ray, Sampler& sampler, \
                                 const Shape* shpe, const Vertex* surface) const \
     { \
         if (listParamName.size() == 0) \
@@ -816,14 +816,14 @@ void MV_WorleyNoise::ReadData(DataReader& data, const String& namePrefix,
 
 #define IMPL_SIMPLE_FUNC1(name, valFuncBody) \
     ADD_MVAL_REFLECTION_DATA_CPP(MV_##name); \
-    Vectorf MV_##name::GetValue(const Ray& ray, FastRand& prng, \
+    Vectorf MV_##name::GetValue(const Ray& ray, Sampler& sampler, \
                                 const Shape* shpe, const Vertex* surface) const \
     { \
         valFuncBody \
     }
 #define IMPL_SIMPLE_FUNC(name, valFuncBody, dimsFuncBody) \
     ADD_MVAL_REFLECTION_DATA_CPP(MV_##name); \
-    Vectorf MV_##name::GetValue(const Ray& ray, FastRand& prng, \
+    Vectorf MV_##name::GetValue(const Ray& ray, Sampler& sampler, \
                                 const Shape* shpe, const Vertex* surface) const \
     { \
         valFuncBody \
@@ -859,7 +859,7 @@ Dimensions MV_Append::GetNDims() const
         d = (Dimensions)((unsigned char)d + ToCombine[i]->GetNDims());
     return d;
 }
-Vectorf MV_Append::GetValue(const Ray& ray, FastRand& prng,
+Vectorf MV_Append::GetValue(const Ray& ray, Sampler& sampler,
                             const Shape* shpe, const Vertex* surface) const
 {
     if (ToCombine.size() == 0)
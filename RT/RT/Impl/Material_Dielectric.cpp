@@ -8,11 +8,11 @@ ADD_MATERIAL_REFLECTION_DATA_CPP(Material_Dielectric);
 
 
 bool Material_Dielectric::Scatter(const Ray& rIn, const Vertex& surface,
-                                  const Shape& shpe, FastRand& prng,
+                                  const Shape& shpe, Sampler& sampler,
                                   Vector3f& attenuation, Vector3f& emission,
                                   Ray& rOut) const
 {
-    float indexOfRefraction = (float)IndexOfRefraction->GetValue(rIn, prng, &shpe, &surface);
+    float indexOfRefraction = (float)IndexOfRefraction->GetValue(rIn, sampler, &shpe, &surface);
 
     float ratioOfIndices;
     Vector3f outwardNormal;
@@ -45,7 +45,7 @@ bool Material_Dielectric::Scatter(const Ray& rIn, const Vertex& surface,
         reflectionChance = 1.01f;
     }
 
-    if (prng.NextFloat() < reflectionChance)
+    if (sampler.NextFloat() < reflectionChance)
         rOut = Ray(surface.Pos, rIn.GetDir().Reflect(surface.Normal));
     else
         rOut = Ray(surface.Pos, refracted);
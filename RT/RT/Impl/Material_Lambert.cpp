@@ -8,15 +8,15 @@ ADD_MATERIAL_REFLECTION_DATA_CPP(Material_Lambert);
 
 
 bool Material_Lambert::Scatter(const Ray& rIn, const Vertex& surface,
-                               const Shape& shpe, FastRand& prng,
+                               const Shape& shpe, Sampler& sampler,
                                Vector3f& attenuation, Vector3f& emission,
                                Ray& rOut) const
 {
-    attenuation = Albedo->GetValue(rIn, prng, &shpe, &surface);
-    emission = Emissive->GetValue(rIn, prng, &shpe, &surface);
+    attenuation = Albedo->GetValue(rIn, sampler, &shpe, &surface);
+    emission = Emissive->GetValue(rIn, sampler, &shpe, &surface);
 
     Vector3f newPos = surface.Pos + (surface.Normal * PushoffDist);
-    Vector3f targetPos = surface.Pos + surface.Normal + prng.NextUnitVector3();
+    Vector3f targetPos = surface.Pos + surface.Normal + sampler.NextUnitVector3();
     rOut = Ray(newPos, (targetPos - newPos).Normalize());
 
     return true;
@@ -8,12 +8,12 @@ ADD_MATERIAL_REFLECTION_DATA_CPP(Material_Medium);
 
 
 bool Material_Medium::Scatter(const Ray& rIn, const Vertex& surface,
-                              const Shape& shpe, FastRand& prng,
+                              const Shape& shpe, Sampler& sampler,
                               Vector3f& attenuation, Vector3f& emission,
                               Ray& rOut) const
 {
-    attenuation = Albedo->GetValue(rIn, prng, &shpe, &surface);
-    rOut = Ray(rIn.GetPos(), prng.NextUnitVector3());
+    attenuation = Albedo->GetValue(rIn, sampler, &shpe, &surface);
+    rOut = Ray(rIn.GetPos(), sampler.NextUnitVector3());
     return true;
 }
 
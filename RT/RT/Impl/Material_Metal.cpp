@@ -8,17 +8,17 @@ ADD_MATERIAL_REFLECTION_DATA_CPP(Material_Metal);
 
 
 bool Material_Metal::Scatter(const Ray& rIn, const Vertex& surf,
-                             const Shape& shpe, FastRand& prng,
+                             const Shape& shpe, Sampler& sampler,
                              Vector3f& atten, Vector3f& emission,
                              Ray& rOut) const
 {
-    atten = Albedo->GetValue(rIn, prng, &shpe, &surf);
-    emission = Emissive->GetValue(rIn, prng, &shpe, &surf);
+    atten = Albedo->GetValue(rIn, sampler, &shpe, &surf);
+    emission = Emissive->GetValue(rIn, sampler, &shpe, &surf);
 
     //TODO: See if this "normalize" is necessary.
     Vector3f reflected = rIn.GetDir().Reflect(surf.Normal).Normalize();
     //Add randomness based on roughness.
-    reflected += (prng.NextUnitVector3() * (float)Roughness->GetValue(rIn, prng, &shpe, &surf));
+    reflected += (sampler.NextUnitVector3() * (float)Roughness->GetValue(rIn, sampler, &shpe, &surf));
 
     //If the ray is pointing into the surface, count it as absorbed.
     if (reflected.Dot(surf.Normal) > 0.0f)
@@ -0,0 +1,20 @@
+#include "../Headers/Matrix3x4f.h"
+
+using namespace RT;
+
+
+Matrix3x4f::Matrix3x4f(const Matrix4f& m)
+{
+    for (int row = 0; row < 3; ++row)
+        for (int col = 0; col < 4; ++col)
+            Get(row, col) = m.Get(row, col);
+}
+
+Matrix4f Matrix3x4f::ToMatrix4f() const
+{
+    Matrix4f m;
+    for (int row = 0; row < 3; ++row)
+        for (int col = 0; col < 4; ++col)
+            m.Get(row, col) = Get(row, col);
+    return m;
+}
\ No newline at end of file
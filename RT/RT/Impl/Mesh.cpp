@@ -1,16 +1,39 @@
 #include "../Headers/Mesh.h"
 
+#include "../Headers/BVHCache.h"
+
 using namespace RT;
 
 
 ADD_SHAPE_REFLECTION_DATA_CPP(Mesh);
 
+bool Mesh::UseSpatialSplitsByDefault = false;
+float Mesh::SpatialSplitBudget = 0.5f;
+
 namespace
 {
-    template<typename T>
-    T Min(T a, T b) { return (a < b) ? a : b; }
-    template<typename T>
-    T Max(T a, T b) { return (a > b) ? a : b; }
+    //Vertices are serialized as a flat array of floats:
+    //    position, normal, tangent, bitangent, then UV.
+    const size_t nFloatsPerVertex = 14;
+
+    float* WriteVertexFloats(const Vertex& v, float* pOut)
+    {
+        *(pOut++) = v.Pos.x;       *(pOut++) = v.Pos.y;       *(pOut++) = v.Pos.z;
+        *(pOut++) = v.Normal.x;    *(pOut++) = v.Normal.y;    *(pOut++) = v.Normal.z;
+        *(pOut++) = v.Tangent.x;   *(pOut++) = v.Tangent.y;   *(pOut++) = v.Tangent.z;
+        *(pOut++) = v.Bitangent.x; *(pOut++) = v.Bitangent.y; *(pOut++) = v.Bitangent.z;
+        *(pOut++) = v.UV.x;        *(pOut++) = v.UV.y;
+        return pOut;
+    }
+    const float* ReadVertexFloats(Vertex& v, const float* pIn)
+    {
+        v.Pos.x = *(pIn++);       v.Pos.y = *(pIn++);       v.Pos.z = *(pIn++);
+        v.Normal.x = *(pIn++);    v.Normal.y = *(pIn++);    v.Normal.z = *(pIn++);
+        v.Tangent.x = *(pIn++);   v.Tangent.y = *(pIn++);   v.Tangent.z = *(pIn++);
+        v.Bitangent.x = *(pIn++); v.Bitangent.y = *(pIn++); v.Bitangent.z = *(pIn++);
+        v.UV.x = *(pIn++);        v.UV.y = *(pIn++);
+        return pIn;
+    }
 }
 
 
@@ -27,62 +50,129 @@ void Mesh::PrecalcData()
 {
     if (Tris.GetSize() == 0)
     {
-        bounds.Min = Vector3f();
-        bounds.Max = Vector3f();
+        worldBounds = BoundingBox();
+        bvh.Build(nullptr, 0);
+        return;
+    }
+
+    std::vector<BoundingBox> triBounds;
+    unsigned long long hash = PrecalcTris(triBounds);
+    BuildBVH(triBounds, &hash);
+
+    UpdateWorldBounds();
+}
+void Mesh::UpdatePrecalcData()
+{
+    if (Tris.GetSize() == 0 || bvh.IsEmpty())
+    {
+        PrecalcData();
+        return;
+    }
+
+    //Refit the existing BVH instead of building a new one, if it's still good enough.
+    //The cache isn't used, since the animated vertices are unlikely to ever be seen again.
+    std::vector<BoundingBox> triBounds;
+    PrecalcTris(triBounds);
+    if (bvh.GetNPrims() == Tris.GetSize())
+        bvh.Refit(triBounds.data());
+    if (bvh.GetNPrims() != Tris.GetSize() || bvh.HasDegraded())
+        BuildBVH(triBounds, nullptr);
+
+    UpdateWorldBounds();
+}
+void Mesh::BuildBVH(const std::vector<BoundingBox>& triBounds, const unsigned long long* hash)
+{
+    bool useSpatialSplits = (SplitMode == SpatialSplits ||
+                             (SplitMode == SceneDefault && UseSpatialSplitsByDefault));
+
+    //The BVH is in local space, so the transform doesn't affect it.
+    //Spatial-split BVHs also depend on the split budget.
+    const char* cacheCategory = "Mesh";
+    BVHCache::Hasher hasher(hash == nullptr ? 0 : *hash);
+    if (useSpatialSplits)
+    {
+        cacheCategory = "MeshSBVH";
+        hasher.Add(SpatialSplitBudget);
     }
+    if (hash != nullptr && BVHCache::TryLoad(cacheCategory, hasher.Value, Tris.GetSize(), bvh))
+        return;
+
+    if (useSpatialSplits)
+        bvh.BuildSpatial(triBounds.data(), triBounds.size(),
+                         [&](unsigned int tri, int axis, float min, float max)
+                             { return Tris[tri].GetClippedBounds(axis, min, max); },
+                         SpatialSplitBudget);
+    else
+        bvh.Build(triBounds.data(), triBounds.size());
 
-    bounds.Min = Tris[0].Verts[0].Pos;
-    bounds.Max = Tris[0].Verts[0].Pos;
+    if (hash != nullptr)
+        BVHCache::Save(cacheCategory, hasher.Value, bvh);
+}
+unsigned long long Mesh::PrecalcTris(std::vector<BoundingBox>& outTriBounds)
+{
+    //Precalculate each triangle and get its bounds.
+    //Also hash the vertex positions, so a previously-built BVH can be loaded from the cache.
+    //The triangles are hashed in fixed-size blocks so that the hash doesn't depend on the thread count.
+    const size_t blockSize = 4096;
+    size_t nBlocks = (Tris.GetSize() + blockSize - 1) / blockSize;
+    outTriBounds.resize(Tris.GetSize());
+    std::vector<unsigned long long> blockHashes(nBlocks);
 
-    for (size_t tri = 0; tri < Tris.GetSize(); ++tri)
+    ThreadPool::GetGlobal().ParallelFor(nBlocks, [&](size_t block)
     {
-        Tris[tri].PrecalcData();
-        for (size_t i = 0; i < 3; ++i)
+        BVHCache::Hasher hasher;
+        size_t end = (block + 1) * blockSize;
+        end = (end > Tris.GetSize() ? Tris.GetSize() : end);
+        for (size_t tri = block * blockSize; tri < end; ++tri)
         {
-            bounds.Min.x = Min(bounds.Min.x, Tris[tri].Verts[i].Pos.x);
-            bounds.Min.y = Min(bounds.Min.y, Tris[tri].Verts[i].Pos.y);
-            bounds.Min.z = Min(bounds.Min.z, Tris[tri].Verts[i].Pos.z);
-            bounds.Max.x = Max(bounds.Max.x, Tris[tri].Verts[i].Pos.x);
-            bounds.Max.y = Max(bounds.Max.y, Tris[tri].Verts[i].Pos.y);
-            bounds.Max.z = Max(bounds.Max.z, Tris[tri].Verts[i].Pos.z);
+            Tris[tri].PrecalcData();
+
+            outTriBounds[tri] = BoundingBox::Empty();
+            for (size_t i = 0; i < 3; ++i)
+            {
+                outTriBounds[tri].Encapsulate(Tris[tri].Verts[i].Pos);
+                hasher.Add(Tris[tri].Verts[i].Pos);
+            }
         }
-    }
+        blockHashes[block] = hasher.Value;
+    });
+
+    BVHCache::Hasher hasher;
+    hasher.Add(Tris.GetSize());
+    hasher.AddBytes(blockHashes.data(), blockHashes.size() * sizeof(unsigned long long));
+    return hasher.Value;
+}
+void Mesh::UpdateWorldBounds()
+{
+    worldBounds = bvh.GetBounds().GetTransformed(Tr);
 
     const float EPSILON = 0.001f;
-    if (std::fabsf(bounds.Min.x - bounds.Max.x) < EPSILON)
-        bounds.Max.x += EPSILON;
-    if (std::fabsf(bounds.Min.y - bounds.Max.y) < EPSILON)
-        bounds.Max.y += EPSILON;
-    if (std::fabsf(bounds.Min.z - bounds.Max.z) < EPSILON)
-        bounds.Max.z += EPSILON;
+    if (std::fabsf(worldBounds.Min.x - worldBounds.Max.x) < EPSILON)
+        worldBounds.Max.x += EPSILON;
+    if (std::fabsf(worldBounds.Min.y - worldBounds.Max.y) < EPSILON)
+        worldBounds.Max.y += EPSILON;
+    if (std::fabsf(worldBounds.Min.z - worldBounds.Max.z) < EPSILON)
+        worldBounds.Max.z += EPSILON;
 }
 bool Mesh::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                    float tMin, float tMax) const
 {
-    //TODO: Try not bothering to normalize the local ray's direction.
-    Ray newRay(Tr.Point_WorldToLocal(ray.GetPos()),
-               Tr.Dir_WorldToLocal(ray.GetDir()).Normalize());
-
-    if (!bounds.RayIntersects(newRay, tMin, tMax))
-        return false;
+    Ray newRay = Tr.Ray_WorldToLocal(ray);
 
     const Triangle* closest = nullptr;
-    float hitDist = std::numeric_limits<float>().infinity();
-    for (size_t i = 0; i < Tris.GetSize(); ++i)
+    bvh.CastRay(newRay, tMin, tMax, [&](unsigned int triI, float& hitDist)
     {
         float tempT;
         Vector3f tempPos;
-
-        if (Tris[i].RayIntersect(newRay, tempPos, tempT, tMin, tMax))
+        if (Tris[triI].RayIntersect(newRay, tempPos, tempT, tMin, hitDist))
         {
-            if (tempT < hitDist)
-            {
-                hitDist = tempT;
-                outHit.Pos = tempPos;
-                closest = &Tris[i];
-            }
+            hitDist = tempT;
+            outHit.Pos = tempPos;
+            closest = &Tris[triI];
+            return true;
         }
-    }
+        return false;
+    });
 
     if (closest != nullptr)
     {
@@ -93,24 +183,64 @@ bool Mesh::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
     return false;
 }
 
+bool Mesh::CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                           float& outEnterT, float& outExitT) const
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+
+    Ray newRay = Tr.Ray_WorldToLocal(ray);
+
+    //Track the two closest crossings found so far, and skip anything farther than the second one.
+    //Triangles that share an edge can both be hit at nearly the same spot,
+    //    so crossings closer than "minThickness" to the first one are merged into it.
+    float ts[2] = { inf, inf };
+    bvh.CastRay(newRay, -inf, inf, [&](unsigned int triI, float& hitDist)
+    {
+        float t;
+        Vector3f pos;
+        if (!Tris[triI].RayIntersect(newRay, pos, t, -inf, hitDist))
+            return false;
+
+        if (fabsf(t - ts[0]) < minThickness)
+        {
+            ts[0] = (t < ts[0] ? t : ts[0]);
+        }
+        else if (t < ts[0])
+        {
+            ts[1] = ts[0];
+            ts[0] = t;
+        }
+        else if (t < ts[1])
+        {
+            ts[1] = t;
+        }
+
+        hitDist = ts[1];
+        return true;
+    });
+
+    if (ts[1] == inf)
+        return false;
+
+    outEnterT = ts[0];
+    outExitT = ts[1];
+    return true;
+}
+
 void Mesh::WriteData(DataWriter& writer) const
 {
     Shape::WriteData(writer);
 
-    //Convert data to vertices for a more compact/simplified format.
-    std::vector<Vertex> verts;
-    verts.reserve(Tris.GetSize() * 3);
+    //Convert data to a flat array of vertex floats for a more compact/faster format.
+    std::vector<float> vertData;
+    vertData.resize(Tris.GetSize() * 3 * nFloatsPerVertex);
+    float* pVertData = vertData.data();
     for (size_t i = 0; i < Tris.GetSize(); ++i)
-    {
-        verts.push_back(Tris[i].Verts[0]);
-        verts.push_back(Tris[i].Verts[1]);
-        verts.push_back(Tris[i].Verts[2]);
-    }
+        for (size_t j = 0; j < 3; ++j)
+            pVertData = WriteVertexFloats(Tris[i].Verts[j], pVertData);
 
-    writer.WriteList<Vertex>(verts.data(), verts.size(),
-                             [](DataWriter& wr, const Vertex& v, const String& name)
-                                 { wr.WriteDataStructure(Vertex_Writable(v), name); },
-                             "Vertices");
+    writer.WriteFloats(vertData.data(), vertData.size(), "VertexData");
+    writer.WriteByte((unsigned char)SplitMode, "SplitMode");
 }
 void Mesh::ReadData(DataReader& reader)
 {
@@ -118,13 +248,50 @@ void Mesh::ReadData(DataReader& reader)
 
     //Data is stored as vertices in the serializer.
     std::vector<Vertex> verts;
-    reader.ReadList<Vertex>(&verts,
-                            [](void* pList, size_t nElements)
-                                { ((std::vector<Vertex>*)pList)->resize(nElements); },
-                            [](DataReader& rd, void* pList, size_t i, const String& name)
-                                { rd.ReadDataStructure(Vertex_Readable((*(std::vector<Vertex>*)pList)[i]),
-                                                       name); },
-                            "Vertices");
+    if (reader.HasElement("VertexData"))
+    {
+        List<float> vertData;
+        reader.ReadFloats(vertData, "VertexData");
+
+        if (vertData.GetSize() % nFloatsPerVertex != 0)
+        {
+            reader.ErrorMessage = "Mesh vertex data should have ";
+            reader.ErrorMessage += String(nFloatsPerVertex);
+            reader.ErrorMessage += " floats per vertex, but it had ";
+            reader.ErrorMessage += String(vertData.GetSize());
+            reader.ErrorMessage += " floats";
+            throw DataReader::EXCEPTION_FAILURE;
+        }
+
+        verts.resize(vertData.GetSize() / nFloatsPerVertex);
+        const float* pVertData = vertData.GetData();
+        for (size_t i = 0; i < verts.size(); ++i)
+            pVertData = ReadVertexFloats(verts[i], pVertData);
+    }
+    else
+    {
+        //Older files store each vertex as its own data structure.
+        reader.ReadList<Vertex>(&verts,
+                                [](void* pList, size_t nElements)
+                                    { ((std::vector<Vertex>*)pList)->resize(nElements); },
+                                [](DataReader& rd, void* pList, size_t i, const String& name)
+                                    { rd.ReadDataStructure(Vertex_Readable((*(std::vector<Vertex>*)pList)[i]),
+                                                           name); },
+                                "Vertices");
+    }
+
+    //Older files don't have a split mode.
+    try
+    {
+        unsigned char splitMode;
+        reader.ReadByte(splitMode, "SplitMode");
+        SplitMode = (SplitModes)splitMode;
+    }
+    catch (int)
+    {
+        reader.ErrorMessage = "";
+        SplitMode = SceneDefault;
+    }
 
     Tris.Clear();
     Tris.Reserve(verts.size() / 3);
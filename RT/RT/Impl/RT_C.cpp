@@ -1,9 +1,102 @@
 #include "../Headers/RT_C.h"
 
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <sys/stat.h>
+
 using namespace RT;
 
 #define C_RT_API_IMPL
 
+
+namespace
+{
+    float adaptiveTargetError = 0.0f;
+    unsigned int adaptiveMaxSamples = 0;
+
+    unsigned int cropMinX = 0, cropMinY = 0,
+                 cropWidth = 0, cropHeight = 0;
+    bool IsCropping() { return cropWidth > 0 && cropHeight > 0; }
+
+
+    //The scene used by the last preview, kept loaded and precalculated
+    //    so that previews of it (e.x. each time the camera moves) can start tracing right away.
+    //It's reloaded if its file has been modified since it was loaded.
+    struct PreviewScene
+    {
+        std::string Path;
+        long long ModifiedTime = -1, FileSize = -1;
+        std::unique_ptr<Tracer> Scene;
+    };
+    PreviewScene previewScene;
+    std::mutex previewSceneLock;
+
+    //Gets the scene at the given path for a preview, loading it if it isn't the cached one.
+    //Returns null if it couldn't be loaded. "previewSceneLock" must be held while using it.
+    Tracer* GetPreviewScene(const char* path)
+    {
+        struct stat fileInfo;
+        if (stat(path, &fileInfo) != 0)
+            return nullptr;
+
+        if (previewScene.Scene != nullptr && previewScene.Path == path &&
+            previewScene.ModifiedTime == (long long)fileInfo.st_mtime &&
+            previewScene.FileSize == (long long)fileInfo.st_size)
+        {
+            return previewScene.Scene.get();
+        }
+
+        previewScene.Scene.reset();
+        std::unique_ptr<Tracer> scene(new Tracer());
+        String err;
+        JsonSerialization::FromJSONFile(path, *scene, err);
+        if (err.GetSize() > 0)
+            return nullptr;
+        scene->PrecalcData();
+
+        previewScene.Path = path;
+        previewScene.ModifiedTime = (long long)fileInfo.st_mtime;
+        previewScene.FileSize = (long long)fileInfo.st_size;
+        previewScene.Scene = std::move(scene);
+        return previewScene.Scene.get();
+    }
+
+
+    Camera MakeCamera(unsigned int imgWidth, unsigned int imgHeight,
+                      float camPosX, float camPosY, float camPosZ,
+                      float camForwardX, float camForwardY, float camForwardZ,
+                      float camUpX, float camUpY, float camUpZ)
+    {
+        Vector3f camForward = Vector3f(camForwardX, camForwardY, camForwardZ).Normalize(),
+                 camUp = Vector3f(camUpX, camUpY, camUpZ).Normalize();
+        return Camera(Vector3f(camPosX, camPosY, camPosZ),
+                      camForward, camForward.Cross(camUp).Cross(camForward).Normalize(),
+                      (float)imgWidth / (float)imgHeight, false);
+    }
+
+    //Copies the given texture's colors into the given array, in the layout described by "rt_GenerateImage()".
+    void CopyColors(const Texture2D& tex, float* outColors)
+    {
+        size_t elementsWide = tex.GetWidth() * 3;
+        for (size_t y = 0; y < tex.GetHeight(); ++y)
+        {
+            size_t indexOffset = y * elementsWide;
+
+            for (size_t x = 0; x < tex.GetWidth(); ++x)
+            {
+                Vector3f col = tex.GetColor(x, y);
+                size_t index = (x * 3) + indexOffset;
+
+                outColors[index] = col.x;
+                outColors[index + 1] = col.y;
+                outColors[index + 2] = col.z;
+            }
+        }
+    }
+}
+
 C_RT_API_IMPL float* rt_GenerateImage(unsigned int imgWidth, unsigned int imgHeight,
                                       unsigned int samplesPerPixel,
                                       unsigned int maxBounces, unsigned int nThreads,
@@ -14,11 +107,10 @@ C_RT_API_IMPL float* rt_GenerateImage(unsigned int imgWidth, unsigned int imgHei
                                       const char* sceneJSONPath)
 {
     //Set up the camera.
-    Vector3f camForward = Vector3f(camForwardX, camForwardY, camForwardZ).Normalize(),
-             camUp = Vector3f(camUpX, camUpY, camUpZ).Normalize();
-    Camera cam(Vector3f(camPosX, camPosY, camPosZ),
-               camForward, camForward.Cross(camUp).Cross(camForward).Normalize(),
-               (float)imgWidth / (float)imgHeight, false);
+    Camera cam = MakeCamera(imgWidth, imgHeight,
+                            camPosX, camPosY, camPosZ,
+                            camForwardX, camForwardY, camForwardZ,
+                            camUpX, camUpY, camUpZ);
 
     //Load the scene.
     Tracer tracer;
@@ -29,29 +121,80 @@ C_RT_API_IMPL float* rt_GenerateImage(unsigned int imgWidth, unsigned int imgHei
 
 
     //Run the trace.
-    Texture2D tex(imgWidth, imgHeight);
-    tracer.TraceFullImage(cam, tex, nThreads, maxBounces, vertFOVDegrees,
-                          aperture, focusDist, samplesPerPixel);
+    //If only a crop window is being rendered, the output is just the crop window's pixels.
+    size_t outWidth = (IsCropping() ? cropWidth : imgWidth),
+           outHeight = (IsCropping() ? cropHeight : imgHeight);
+    Texture2D tex(outWidth, outHeight);
+    if (IsCropping())
+        tracer.TraceCropImage(cam, tex, imgWidth, imgHeight, cropMinX, cropMinY, cropWidth, cropHeight,
+                              nThreads, maxBounces, vertFOVDegrees, aperture, focusDist, samplesPerPixel);
+    else if (adaptiveTargetError > 0.0f)
+        tracer.TraceAdaptiveImage(cam, tex, nThreads, maxBounces, vertFOVDegrees, aperture, focusDist,
+                                  samplesPerPixel, adaptiveMaxSamples, adaptiveTargetError);
+    else
+        tracer.TraceFullImage(cam, tex, nThreads, maxBounces, vertFOVDegrees,
+                              aperture, focusDist, samplesPerPixel);
 
     //Copy out the color data.
-    size_t elementsWide = imgWidth * 3;
-    size_t nElements = elementsWide * imgHeight;
-    float* colors = new float[nElements];
-    for (size_t y = 0; y < imgHeight; ++y)
-    {
-        size_t indexOffset = y * elementsWide;
+    float* colors = new float[outWidth * outHeight * 3];
+    CopyColors(tex, colors);
+    return colors;
+}
+C_RT_API_IMPL void rt_GeneratePreviewImage(unsigned int imgWidth, unsigned int imgHeight,
+                                           unsigned int maxBounces, unsigned int nThreads,
+                                           float vertFOVDegrees, float aperture, float focusDist,
+                                           float camPosX, float camPosY, float camPosZ,
+                                           float camForwardX, float camForwardY, float camForwardZ,
+                                           float camUpX, float camUpY, float camUpZ,
+                                           const char* sceneJSONPath,
+                                           rt_PreviewPassCallback onPass)
+{
+    Camera cam = MakeCamera(imgWidth, imgHeight,
+                            camPosX, camPosY, camPosZ,
+                            camForwardX, camForwardY, camForwardZ,
+                            camUpX, camUpY, camUpZ);
 
-        for (size_t x = 0; x < imgWidth; ++x)
-        {
-            Vector3f col = tex.GetColor(x, y);
-            size_t index = (x * 3) + indexOffset;
+    std::lock_guard<std::mutex> lock(previewSceneLock);
+    Tracer* tracer = GetPreviewScene(sceneJSONPath);
+    if (tracer == nullptr)
+        return;
 
-            colors[index] = col.x;
-            colors[index + 1] = col.y;
-            colors[index + 2] = col.z;
-        }
-    }
-    return colors;
+    Texture2D tex(imgWidth, imgHeight);
+    std::vector<float> colors(imgWidth * imgHeight * 3);
+    tracer->TracePreviewImage(cam, tex, nThreads, maxBounces, vertFOVDegrees, aperture, focusDist,
+                             [&](const Texture2D& passTex, size_t blockSize)
+                             {
+                                 CopyColors(passTex, colors.data());
+                                 onPass(colors.data(), (unsigned int)blockSize);
+                             });
+}
+
+C_RT_API_IMPL void rt_SetBVHCacheFolder(const char* folderPath)
+{
+    BVHCache::SetFolder(folderPath == nullptr ? "" : folderPath);
+}
+C_RT_API_IMPL void rt_SetSpatialSplits(int enabled, float budget)
+{
+    Mesh::UseSpatialSplitsByDefault = (enabled != 0);
+    Mesh::SpatialSplitBudget = budget;
+}
+C_RT_API_IMPL void rt_SetSampler(int samplerType)
+{
+    assert(samplerType >= Sampler::Random && samplerType <= Sampler::BlueNoiseSobol);
+    Sampler::DefaultType = (Sampler::Types)samplerType;
+}
+C_RT_API_IMPL void rt_SetAdaptiveSampling(float targetError, unsigned int maxSamplesPerPixel)
+{
+    adaptiveTargetError = targetError;
+    adaptiveMaxSamples = maxSamplesPerPixel;
+}
+
+C_RT_API_IMPL void rt_SetCropWindow(unsigned int minX, unsigned int minY, unsigned int width, unsigned int height)
+{
+    cropMinX = minX;
+    cropMinY = minY;
+    cropWidth = width;
+    cropHeight = height;
 }
 
 C_RT_API_IMPL void rt_ReleaseImage(float* img)
@@ -77,6 +220,8 @@ unsigned char rt_GetError(unsigned int imgWidth, unsigned int imgHeight, unsigne
 
     if (imgWidth == 0 || imgHeight < nThreads)
         return rt_ERRORCODE_BAD_SIZE();
+    if (IsCropping() && (cropMinX + cropWidth > imgWidth || cropMinY + cropHeight > imgHeight))
+        return rt_ERRORCODE_BAD_SIZE();
 
     Tracer tr;
     String err;
@@ -0,0 +1,146 @@
+#include "../Headers/RenderBuffer.h"
+
+#include <assert.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+using namespace RT;
+
+
+namespace
+{
+    //Identifies the file format, and must be changed whenever the pixel data layout changes.
+    const char checkpointMagic[8] = { 'R', 'T', 'C', 'K', 'P', 'T', '0', '1' };
+
+    struct CheckpointHeader
+    {
+        char Magic[8];
+        unsigned long long SettingsHash;
+        unsigned long long Width, Height;
+        unsigned long long PixelSize;
+    };
+}
+
+
+const float RenderBuffer::MinErrorLuminance = 1.0f / 16.0f;
+
+
+void RenderBuffer::Resize(size_t newWidth, size_t newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    pixels.resize(width * height);
+    Clear();
+}
+void RenderBuffer::Clear()
+{
+    for (Pixel& p : pixels)
+        p = Pixel();
+}
+
+size_t RenderBuffer::GetTotalSamples() const
+{
+    size_t total = 0;
+    for (const Pixel& p : pixels)
+        total += p.NSamples;
+    return total;
+}
+
+Vector3f RenderBuffer::GetColor(size_t x, size_t y) const
+{
+    const Pixel& p = pixels[x + (y * width)];
+    if (p.NSamples == 0)
+        return Vector3f();
+    return p.ColorSum / (float)p.NSamples;
+}
+float RenderBuffer::GetRelativeError(size_t x, size_t y) const
+{
+    const Pixel& p = pixels[x + (y * width)];
+    if (p.NSamples < 2)
+        return std::numeric_limits<float>::infinity();
+
+    float n = (float)p.NSamples,
+          mean = GetLuminance(p.ColorSum) / n;
+    float variance = ((p.LuminanceSqrSum / n) - (mean * mean)) * (n / (n - 1.0f));
+    float standardError = sqrtf(std::max(0.0f, variance) / n);
+    return standardError / std::max(mean, MinErrorLuminance);
+}
+
+void RenderBuffer::CopyTo(Texture2D& outTex) const
+{
+    assert(outTex.GetWidth() == width && outTex.GetHeight() == height);
+    for (size_t y = 0; y < height; ++y)
+        for (size_t x = 0; x < width; ++x)
+            outTex.SetColor(x, y, GetColor(x, y));
+}
+
+String RenderBuffer::SaveCheckpoint(const String& path, unsigned long long settingsHash) const
+{
+    CheckpointHeader header;
+    memcpy(header.Magic, checkpointMagic, sizeof(checkpointMagic));
+    header.SettingsHash = settingsHash;
+    header.Width = width;
+    header.Height = height;
+    header.PixelSize = sizeof(Pixel);
+
+    //Write to a temp file first, then swap it in,
+    //    so that the old checkpoint survives if this one gets interrupted.
+    String tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath.CStr(), std::ios_base::binary | std::ios_base::trunc);
+        if (!file.is_open())
+            return String("couldn't open ") + tempPath;
+
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)pixels.data(), pixels.size() * sizeof(Pixel));
+        if (!file)
+        {
+            file.close();
+            remove(tempPath.CStr());
+            return String("couldn't write to ") + tempPath;
+        }
+    }
+
+    //Replacing the old file has to be a single step, so there's always a whole checkpoint on disk.
+    //On Windows, "rename()" fails if the destination exists, so a different function is needed.
+#ifdef OS_WINDOWS
+    bool replaced = (MoveFileExA(tempPath.CStr(), path.CStr(), MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+    bool replaced = (rename(tempPath.CStr(), path.CStr()) == 0);
+#endif
+    if (!replaced)
+    {
+        remove(tempPath.CStr());
+        return String("couldn't replace ") + path;
+    }
+    return "";
+}
+String RenderBuffer::LoadCheckpoint(const String& path, unsigned long long settingsHash)
+{
+    std::ifstream file(path.CStr(), std::ios_base::binary);
+    if (!file.is_open())
+        return String("couldn't open ") + path;
+
+    CheckpointHeader header;
+    if (!file.read((char*)&header, sizeof(header)) ||
+        memcmp(header.Magic, checkpointMagic, sizeof(checkpointMagic)) != 0 ||
+        header.PixelSize != sizeof(Pixel))
+    {
+        return path + " isn't a checkpoint file, or is from a different version";
+    }
+    if (header.SettingsHash != settingsHash)
+        return path + " was rendered with different settings";
+
+    std::vector<Pixel> newPixels((size_t)(header.Width * header.Height));
+    if (!file.read((char*)newPixels.data(), newPixels.size() * sizeof(Pixel)))
+        return path + " is incomplete";
+
+    width = (size_t)header.Width;
+    height = (size_t)header.Height;
+    pixels = std::move(newPixels);
+    return "";
+}
\ No newline at end of file
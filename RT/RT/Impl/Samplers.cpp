@@ -0,0 +1,256 @@
+#include "../Headers/Samplers.h"
+
+#include <vector>
+#include <cmath>
+
+using namespace RT;
+
+
+Sampler::Types Sampler::DefaultType = Sampler::Sobol;
+
+Sampler* Sampler::Create(Types type)
+{
+    switch (type)
+    {
+        case Random: return new Sampler_Random();
+        case Sobol: return new Sampler_Sobol();
+        case BlueNoiseSobol: return new Sampler_BlueNoise();
+
+        default: assert(false); return new Sampler_Random();
+    }
+}
+
+
+namespace
+{
+    unsigned int Hash(unsigned int x) { return FastRand::Mix(x); }
+    unsigned int HashCombine(unsigned int seed, unsigned int value)
+    {
+        return seed ^ (Hash(value) + 0x9e3779b9U + (seed << 6) + (seed >> 2));
+    }
+
+    unsigned int ReverseBits(unsigned int x)
+    {
+        x = ((x >> 1) & 0x55555555U) | ((x & 0x55555555U) << 1);
+        x = ((x >> 2) & 0x33333333U) | ((x & 0x33333333U) << 2);
+        x = ((x >> 4) & 0x0F0F0F0FU) | ((x & 0x0F0F0F0FU) << 4);
+        x = ((x >> 8) & 0x00FF00FFU) | ((x & 0x00FF00FFU) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    //A random permutation of the given number where each bit only depends on the bits below it.
+    //From Laine and Karras' "Stratified Sampling for Stochastic Transparency", with Burley's constants.
+    unsigned int LaineKarrasPermutation(unsigned int x, unsigned int seed)
+    {
+        x += seed;
+        x ^= x * 0x6c50b47cU;
+        x ^= x * 0xb82f1e52U;
+        x ^= x * 0xc7afe638U;
+        x ^= x * 0x8d22f6e6U;
+        return x;
+    }
+    //Owen-scrambles the given number: each bit is flipped based on a hash of the bits above it.
+    unsigned int NestedUniformScramble(unsigned int x, unsigned int seed)
+    {
+        return ReverseBits(LaineKarrasPermutation(ReverseBits(x), seed));
+    }
+
+    //The first two dimensions of the Sobol sequence.
+    //The first is just the Van der Corput sequence.
+    unsigned int Sobol0(unsigned int index) { return ReverseBits(index); }
+    unsigned int Sobol1(unsigned int index)
+    {
+        unsigned int result = 0;
+        for (unsigned int v = 1U << 31; index != 0; index >>= 1, v ^= v >> 1)
+            if ((index & 1) != 0)
+                result ^= v;
+        return result;
+    }
+
+    //Turns the given 32 bits into a float in [0, 1), using the top 24 so every value is exact.
+    float ToFloat(unsigned int x) { return (float)(x >> 8) * (1.0f / 16777216.0f); }
+
+
+    //Generates a tiling blue-noise texture with the void-and-cluster method (Ulichney, 1993).
+    //Each pixel gets a unique rank, so the values are evenly spread over [0, 1)
+    //    and any threshold of them is a well-spaced set of pixels.
+    std::vector<float> GenerateBlueNoise()
+    {
+        const int size = (int)Sampler_BlueNoise::TileSize,
+                  nPixels = size * size;
+        const float sigma = 1.5f;
+
+        //The Gaussian weight of each wrapped-around offset between two pixels.
+        std::vector<float> kernel(nPixels);
+        for (int y = 0; y < size; ++y)
+        {
+            int dy = (y > size / 2 ? (size - y) : y);
+            for (int x = 0; x < size; ++x)
+            {
+                int dx = (x > size / 2 ? (size - x) : x);
+                kernel[x + (y * size)] = expf(-(float)((dx * dx) + (dy * dy)) / (2.0f * sigma * sigma));
+            }
+        }
+
+        //"Energy" is how crowded each pixel is by the pixels that are turned on.
+        std::vector<char> pattern(nPixels, 0);
+        std::vector<float> energy(nPixels, 0.0f);
+        auto setPixel = [&](std::vector<char>& pat, std::vector<float>& en, int i, bool on)
+        {
+            pat[i] = (on ? 1 : 0);
+            float sign = (on ? 1.0f : -1.0f);
+            int pX = i % size,
+                pY = i / size;
+            for (int y = 0; y < size; ++y)
+            {
+                const float* kernelRow = &kernel[((y - pY) & (size - 1)) * size];
+                float* energyRow = &en[y * size];
+                for (int x = 0; x < size; ++x)
+                    energyRow[x] += sign * kernelRow[(x - pX) & (size - 1)];
+            }
+        };
+        //Finds the most crowded "on" pixel.
+        auto findTightestCluster = [&](const std::vector<char>& pat, const std::vector<float>& en)
+        {
+            int best = -1;
+            for (int i = 0; i < nPixels; ++i)
+                if (pat[i] != 0 && (best < 0 || en[i] > en[best]))
+                    best = i;
+            return best;
+        };
+        //Finds the least crowded "off" pixel.
+        auto findLargestVoid = [&](const std::vector<char>& pat, const std::vector<float>& en)
+        {
+            int best = -1;
+            for (int i = 0; i < nPixels; ++i)
+                if (pat[i] == 0 && (best < 0 || en[i] < en[best]))
+                    best = i;
+            return best;
+        };
+
+        //Start with a random tenth of the pixels,
+        //    then move the most crowded pixel into the biggest gap until that doesn't change anything.
+        FastRand prng(0x5eed);
+        int nInitial = nPixels / 10;
+        for (int placed = 0; placed < nInitial; )
+        {
+            int i = (int)((unsigned int)prng.NextInt() % (unsigned int)nPixels);
+            if (pattern[i] == 0)
+            {
+                setPixel(pattern, energy, i, true);
+                placed += 1;
+            }
+        }
+        for (int iteration = 0; iteration < nPixels; ++iteration)
+        {
+            int cluster = findTightestCluster(pattern, energy);
+            setPixel(pattern, energy, cluster, false);
+            int gap = findLargestVoid(pattern, energy);
+            setPixel(pattern, energy, gap, true);
+            if (gap == cluster)
+                break;
+        }
+
+        //Rank the initial pixels by taking them away, most crowded first.
+        std::vector<int> ranks(nPixels);
+        {
+            std::vector<char> pattern2 = pattern;
+            std::vector<float> energy2 = energy;
+            for (int rank = nInitial - 1; rank >= 0; --rank)
+            {
+                int cluster = findTightestCluster(pattern2, energy2);
+                setPixel(pattern2, energy2, cluster, false);
+                ranks[cluster] = rank;
+            }
+        }
+        //Rank the rest by filling in the biggest gap each time.
+        //The kernel weights add up to the same total everywhere, so once more than half the pixels are on,
+        //    the biggest gap is still the tightest cluster of "off" pixels, and the usual third phase isn't needed.
+        for (int rank = nInitial; rank < nPixels; ++rank)
+        {
+            int gap = findLargestVoid(pattern, energy);
+            setPixel(pattern, energy, gap, true);
+            ranks[gap] = rank;
+        }
+
+        std::vector<float> values(nPixels);
+        for (int i = 0; i < nPixels; ++i)
+            values[i] = ((float)ranks[i] + 0.5f) / (float)nPixels;
+        return values;
+    }
+    const std::vector<float>& GetBlueNoise()
+    {
+        static const std::vector<float> blueNoise = GenerateBlueNoise();
+        return blueNoise;
+    }
+}
+
+
+void Sampler_Random::StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int sampleIndex)
+{
+    dimension = 0;
+    prng = FastRand::ForSample(pixelX, pixelY, sampleIndex);
+}
+
+
+void Sampler_Sobol::StartSample(unsigned int pixelX, unsigned int pixelY, unsigned int _sampleIndex)
+{
+    dimension = 0;
+    sampleIndex = _sampleIndex;
+    pixelSeed = HashCombine(Hash(pixelX), pixelY);
+    prng = FastRand::ForSample(pixelX, pixelY, sampleIndex);
+}
+void Sampler_Sobol::GetPoint(unsigned int dim, float& outX, float* outY) const
+{
+    //Shuffle the order of the points, then scramble each of the two dimensions separately.
+    unsigned int seed = HashCombine(pixelSeed, dim);
+    unsigned int index = NestedUniformScramble(sampleIndex, seed);
+
+    outX = ToFloat(NestedUniformScramble(Sobol0(index), HashCombine(seed, 0)));
+    if (outY != nullptr)
+        *outY = ToFloat(NestedUniformScramble(Sobol1(index), HashCombine(seed, 1)));
+}
+float Sampler_Sobol::NextFloat()
+{
+    float x;
+    GetPoint(dimension, x, nullptr);
+    dimension += 1;
+    return x;
+}
+Vector2f Sampler_Sobol::Next2D()
+{
+    Vector2f p;
+    GetPoint(dimension, p.x, &p.y);
+    dimension += 2;
+    return p;
+}
+
+
+void Sampler_BlueNoise::StartSample(unsigned int _pixelX, unsigned int _pixelY, unsigned int _sampleIndex)
+{
+    Sampler_Sobol::StartSample(_pixelX, _pixelY, _sampleIndex);
+    pixelX = _pixelX;
+    pixelY = _pixelY;
+    pixelSeed = 0;
+}
+float Sampler_BlueNoise::GetOffset(unsigned int dim) const
+{
+    //Use a different shift of the texture for each dimension, so the dimensions aren't correlated.
+    unsigned int shift = Hash(dim + 1);
+    unsigned int x = (pixelX + shift) % TileSize,
+                 y = (pixelY + (shift >> 16)) % TileSize;
+    return GetBlueNoise()[x + (y * TileSize)];
+}
+float Sampler_BlueNoise::NextFloat()
+{
+    //Shift the point by the blue noise, wrapping around (a "Cranley-Patterson rotation").
+    float x = Sampler_Sobol::NextFloat() + GetOffset(dimension - 1);
+    return x - floorf(x);
+}
+Vector2f Sampler_BlueNoise::Next2D()
+{
+    Vector2f p = Sampler_Sobol::Next2D();
+    p.x += GetOffset(dimension - 2);
+    p.y += GetOffset(dimension - 1);
+    return Vector2f(p.x - floorf(p.x), p.y - floorf(p.y));
+}
\ No newline at end of file
@@ -69,4 +69,31 @@ Shape::ShapeFactory Shape::GetFactory(const String& typeName)
 
     assert(foundFactory != nullptr);
     return foundFactory;
+}
+
+bool Shape::CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                            float& outEnterT, float& outExitT) const
+{
+    constexpr float inf = std::numeric_limits<float>::infinity();
+
+    Vertex enterHit, exitHit;
+    if (!CastRay(ray, enterHit, prng, -inf, inf))
+        return false;
+    outEnterT = ray.GetT(enterHit.Pos);
+
+    if (!CastRay(ray, exitHit, prng, outEnterT + minThickness, inf))
+        return false;
+    outExitT = ray.GetT(exitHit.Pos);
+
+    return true;
+}
+
+void Shape::ReadValue(SharedPtr<Shape>& shpe, DataReader& reader, const String& name)
+{
+    String typeName;
+    reader.ReadString(typeName, name + "Type");
+
+    if (shpe.Get() == nullptr || !(shpe->GetTypeName() == typeName))
+        shpe.Reset(Create(typeName));
+    reader.ReadDataStructure(*shpe, name + "Value");
 }
\ No newline at end of file
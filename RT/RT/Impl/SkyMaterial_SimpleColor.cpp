@@ -7,9 +7,9 @@ using namespace RT;
 ADD_SKYMAT_REFLECTION_DATA_CPP(SkyMaterial_SimpleColor);
 
 
-Vector3f SkyMaterial_SimpleColor::GetColor(const Ray& ray, FastRand& prng) const
+Vector3f SkyMaterial_SimpleColor::GetColor(const Ray& ray, Sampler& sampler) const
 {
-    return Color->GetValue(ray, prng);
+    return Color->GetValue(ray, sampler);
 }
 
 void SkyMaterial_SimpleColor::WriteData(DataWriter& writer) const
@@ -9,13 +9,13 @@ using namespace RT;
 ADD_SKYMAT_REFLECTION_DATA_CPP(SkyMaterial_VerticalGradient);
 
 
-Vector3f SkyMaterial_VerticalGradient::GetColor(const Ray& ray, FastRand& prng) const
+Vector3f SkyMaterial_VerticalGradient::GetColor(const Ray& ray, Sampler& sampler) const
 {
-    Vector3f dir = SkyDir->GetValue(ray, prng);
+    Vector3f dir = SkyDir->GetValue(ray, sampler);
     float dirValue = ray.GetDir().Dot(dir.Normalize());
 
-    return Vector3f::Lerp(BottomCol->GetValue(ray, prng),
-                          TopCol->GetValue(ray, prng),
+    return Vector3f::Lerp(BottomCol->GetValue(ray, sampler),
+                          TopCol->GetValue(ray, sampler),
                           0.5f + (0.5f * dirValue));
 }
 void SkyMaterial_VerticalGradient::WriteData(DataWriter& writer) const
@@ -15,6 +15,21 @@ namespace
 
 void Sphere::PrecalcData()
 {
+    const Vector3f& scale = Tr.GetScale();
+    isUniform = (scale.x > 0.0f && scale.x == scale.y && scale.x == scale.z);
+    if (isUniform)
+    {
+        worldCenter = Tr.GetPos();
+        worldRadius = scale.x;
+
+        const Quaternion& rot = Tr.GetRot();
+        isRotated = (rot.x != 0.0f || rot.y != 0.0f || rot.z != 0.0f);
+
+        Vector3f extents(worldRadius, worldRadius, worldRadius);
+        bounds = BoundingBox(worldCenter - extents, worldCenter + extents);
+        return;
+    }
+
     //http://stackoverflow.com/questions/4368961/calculating-an-aabb-for-a-transformed-sphere
 
     float sVals[4][4] = { { 1.0f, 0.0f, 0.0f, 0.0f },
@@ -52,13 +67,16 @@ void Sphere::GetBoundingBox(BoundingBox& outB) const
 bool Sphere::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
                      float tMin, float tMax) const
 {
+    if (isUniform)
+        return CastRayUniform(ray, outHit, tMin, tMax);
+
     //http://stackoverflow.com/questions/6533856/ray-sphere-intersection
 
     //Transform the ray to local space.
     //Note that this sphere has a radius of 1.0 in that space.
-
-    Ray newRay(Tr.Point_WorldToLocal(ray.GetPos()),
-               Tr.Dir_WorldToLocal(ray.GetDir()).Normalize());
+    //Distances along the local ray are the same as along the world ray,
+    //    so the hit distances can be checked against tMin and tMax directly.
+    Ray newRay = Tr.Ray_WorldToLocal(ray);
 
     float a = newRay.GetDir().Dot(newRay.GetDir()),
           b = 2.0f * newRay.GetDir().Dot(newRay.GetPos()),
@@ -71,69 +89,101 @@ bool Sphere::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
         return false;
     }
 
-    //Find the intersection distance,
-    //    either along the local-space ray or the world-space ray.
+    float inv2a = 0.5f / a,
+          temp = sqrtf(discriminant);
+    float t1 = (-b - temp) * inv2a,
+          t2 = (-b + temp) * inv2a;
+
+    bool t1Invalid = (t1 < tMin || t1 > tMax),
+         t2Invalid = (t2 < tMin || t2 > tMax);
+
     float outDist;
-    bool outDistIsLocal;
-    if (discriminant == 0.0f)
-    {
-        outDist = -b / (2.0f * a);
-        outDistIsLocal = true;
-    }
-    else
-    {
-        float inv2a = 0.5f / a,
-              temp = sqrtf(discriminant);
-        float t1 = (-b - temp) * inv2a,
-              t2 = (-b + temp) * inv2a;
-
-        //Get the world-space t values for comparison against tMin and tMax.
-        //Common edge-case: if tMin is 0 and tMax is +INF, no need to bother.
-        if (tMin == 0.0f && tMax == std::numeric_limits<float>::infinity())
-        {
-            outDistIsLocal = true;
-        }
-        else
-        {
-            outDistIsLocal = false;
-
-            Vector3f localHit1 = newRay.GetPos(t1),
-                     localHit2 = newRay.GetPos(t2);
-            Vector3f worldHit1 = Tr.Point_LocalToWorld(localHit1),
-                     worldHit2 = Tr.Point_LocalToWorld(localHit2);
-
-            t1 = ray.GetT(worldHit1);
-            t2 = ray.GetT(worldHit2);
-        }
-
-        bool t1Invalid = (t1 < tMin || t1 > tMax),
-             t2Invalid = (t2 < tMin || t2 > tMax);
-
-        if (t2Invalid)
-            if (t1Invalid)
-                return false;
-            else
-                outDist = t1;
-        else if (t1Invalid)
-            outDist = t2;
+    if (t2Invalid)
+        if (t1Invalid)
+            return false;
         else
-            outDist = min(t1, t2);
-    }
+            outDist = t1;
+    else if (t1Invalid)
+        outDist = t2;
+    else
+        outDist = min(t1, t2);
     
     //Calculate world-space intersection data.
-    Vector3f localHit, worldHit;
-    if (outDistIsLocal)
+    Vector3f localHit = newRay.GetPos(outDist),
+             worldHit = ray.GetPos(outDist);
+    FillInData(outHit, localHit, worldHit);
+
+    return true;
+}
+bool Sphere::CastRayInterval(const Ray& ray, FastRand& prng, float minThickness,
+                             float& outEnterT, float& outExitT) const
+{
+    //Both crossings come out of the same intersection equation.
+    if (isUniform)
     {
-        localHit = newRay.GetPos(outDist);
-        worldHit = Tr.Point_LocalToWorld(localHit);
+        Vector3f toRay = ray.GetPos() - worldCenter;
+        float invDirLengthSqr = 1.0f / ray.GetDir().Dot(ray.GetDir());
+        float tClosest = -toRay.Dot(ray.GetDir()) * invDirLengthSqr;
+        Vector3f closestOffset = toRay + (ray.GetDir() * tClosest);
+
+        float discriminant = ((worldRadius * worldRadius) - closestOffset.Dot(closestOffset)) * invDirLengthSqr;
+        if (discriminant < 0.0f)
+            return false;
+
+        float root = sqrtf(discriminant);
+        outEnterT = tClosest - root;
+        outExitT = tClosest + root;
     }
     else
     {
-        worldHit = ray.GetPos(outDist);
-        localHit = Tr.Point_WorldToLocal(worldHit);
+        Ray newRay = Tr.Ray_WorldToLocal(ray);
+
+        float a = newRay.GetDir().Dot(newRay.GetDir()),
+              b = 2.0f * newRay.GetDir().Dot(newRay.GetPos()),
+              c = newRay.GetPos().Dot(newRay.GetPos()) - 1.0f;
+
+        float discriminant = (b * b) - (4.0f * a * c);
+        if (discriminant < 0.0f)
+            return false;
+
+        float inv2a = 0.5f / a,
+              temp = sqrtf(discriminant);
+        outEnterT = (-b - temp) * inv2a;
+        outExitT = (-b + temp) * inv2a;
     }
-    FillInData(outHit, localHit, worldHit);
 
+    return (outExitT >= outEnterT + minThickness);
+}
+bool Sphere::CastRayUniform(const Ray& ray, Vertex& outHit, float tMin, float tMax) const
+{
+    //Find where the ray comes closest to the center, then step backwards and forwards from there to the surface.
+    //This is much more precise than the usual "b^2 - 4ac" for small or faraway spheres.
+    //Some materials don't quite normalize their rays, so the direction's length is still accounted for.
+    Vector3f toRay = ray.GetPos() - worldCenter;
+    float invDirLengthSqr = 1.0f / ray.GetDir().Dot(ray.GetDir());
+    float tClosest = -toRay.Dot(ray.GetDir()) * invDirLengthSqr;
+    Vector3f closestOffset = toRay + (ray.GetDir() * tClosest);
+
+    float discriminant = ((worldRadius * worldRadius) - closestOffset.Dot(closestOffset)) * invDirLengthSqr;
+    if (discriminant < 0.0f)
+        return false;
+
+    float root = sqrtf(discriminant);
+    float t = tClosest - root;
+    if (t < tMin)
+        t = tClosest + root;
+    if (t < tMin || t > tMax)
+        return false;
+
+    outHit.Pos = ray.GetPos(t);
+
+    //The local normal only differs from the world one by this sphere's rotation.
+    Vector3f worldNormal = (outHit.Pos - worldCenter).Normalize(),
+             localNormal = worldNormal;
+    if (isRotated)
+        localNormal = Tr.Dir_WorldToLocal(worldNormal).Normalize();
+
+    GetSurfaceData(WrapAxis, localNormal, worldNormal, outHit);
     return true;
 }
 void Sphere::FillInData(Vertex& v, Vector3f localIntersectPos, Vector3f worldIntersectPos) const
@@ -141,17 +191,22 @@ void Sphere::FillInData(Vertex& v, Vector3f localIntersectPos, Vector3f worldInt
     v.Pos = worldIntersectPos;
 
     Vector3f localNormal = localIntersectPos.Normalize(); //TODO: Is normalization necessary?
-
-    v.Normal = Tr.Normal_LocalToWorld(localNormal).Normalize();
+    GetSurfaceData(WrapAxis, localNormal, Tr.Normal_LocalToWorld(localNormal).Normalize(), v);
+}
+void Sphere::GetSurfaceData(unsigned char wrapAxis,
+                            const Vector3f& localNormal, const Vector3f& worldNormal,
+                            Vertex& v)
+{
+    v.Normal = worldNormal;
     v.Tangent = v.Normal.Cross(fabs(v.Normal.x) == 1.0f ? Vector3f::Y() : Vector3f::X()).Normalize();
     v.Bitangent = v.Normal.Cross(v.Tangent);
     
-    size_t otherAxis1 = (WrapAxis == 0 ? 2 : (WrapAxis - 1)),
-           otherAxis2 = (WrapAxis == 2 ? 0 : (WrapAxis + 1));
+    size_t otherAxis1 = (wrapAxis == 0 ? 2 : (wrapAxis - 1)),
+           otherAxis2 = (wrapAxis == 2 ? 0 : (wrapAxis + 1));
     const float invPi = 1.0f / (float)M_PI,
                 inv2Pi = 0.5f * invPi;
     v.UV.x = 0.5f + (inv2Pi * atan2(localNormal[otherAxis2], localNormal[otherAxis1]));
-    v.UV.y = 0.5f - (invPi * asin(localNormal[WrapAxis]));
+    v.UV.y = 0.5f - (invPi * asin(localNormal[wrapAxis]));
 }
 
 void Sphere::WriteData(DataWriter& writer) const
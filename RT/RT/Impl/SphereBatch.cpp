@@ -0,0 +1,261 @@
+#include "../Headers/SphereBatch.h"
+
+#include <algorithm>
+
+#include "../Headers/Sphere.h"
+#include "../Headers/BVHCache.h"
+
+using namespace RT;
+
+
+ADD_SHAPE_REFLECTION_DATA_CPP(SphereBatch);
+
+
+namespace
+{
+    //Spreads the lowest 10 bits of the given number out so that there are two zero bits between each of them.
+    unsigned int SpreadBits(unsigned int x)
+    {
+        x = (x | (x << 16)) & 0x030000FF;
+        x = (x | (x << 8)) & 0x0300F00F;
+        x = (x | (x << 4)) & 0x030C30C3;
+        x = (x | (x << 2)) & 0x09249249;
+        return x;
+    }
+    //Gets the Morton code of the given position inside the given bounds,
+    //    so that sorting by it puts nearby positions close together.
+    unsigned int GetMortonCode(const Vector3f& pos, const BoundingBox& bounds)
+    {
+        Vector3f size = bounds.GetSize();
+        unsigned int code = 0;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float t = (size[axis] > 0.0f ? ((pos[axis] - bounds.Min[axis]) / size[axis]) : 0.0f);
+            unsigned int cell = (unsigned int)std::min(1023.0f, std::max(0.0f, t * 1024.0f));
+            code |= SpreadBits(cell) << axis;
+        }
+        return code;
+    }
+}
+
+
+void SphereBatch::PrecalcData()
+{
+    size_t nSpheres = GetNSpheres();
+    const float* spheres = Spheres.GetData();
+    if (nSpheres == 0)
+    {
+        groups.clear();
+        worldBounds = BoundingBox();
+        bvh.Build(nullptr, 0);
+        return;
+    }
+
+    //Sort the spheres along a Morton curve, so that each group of them is spatially coherent.
+    BoundingBox centerBounds = BoundingBox::Empty();
+    for (size_t i = 0; i < nSpheres; ++i)
+        centerBounds.Encapsulate(Vector3f(spheres[i * 4], spheres[(i * 4) + 1], spheres[(i * 4) + 2]));
+
+    std::vector<unsigned int> mortonCodes(nSpheres), order(nSpheres);
+    ThreadPool::GetGlobal().ParallelForRanges(nSpheres, 4096, [&](size_t start, size_t end)
+    {
+        for (size_t i = start; i < end; ++i)
+        {
+            Vector3f center(spheres[i * 4], spheres[(i * 4) + 1], spheres[(i * 4) + 2]);
+            mortonCodes[i] = GetMortonCode(center, centerBounds);
+            order[i] = (unsigned int)i;
+        }
+    });
+    std::stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b)
+                         { return mortonCodes[a] < mortonCodes[b]; });
+
+    //Fill in the groups and get their bounds.
+    size_t nGroups = (nSpheres + GroupSize - 1) / GroupSize;
+    groups.resize(nGroups);
+    std::vector<BoundingBox> groupBounds(nGroups);
+    ThreadPool::GetGlobal().ParallelForRanges(nGroups, 1024, [&](size_t start, size_t end)
+    {
+        for (size_t groupI = start; groupI < end; ++groupI)
+        {
+            Group& group = groups[groupI];
+            group.NSpheres = (unsigned int)std::min((size_t)GroupSize, nSpheres - (groupI * GroupSize));
+            groupBounds[groupI] = BoundingBox::Empty();
+
+            for (unsigned int i = 0; i < GroupSize; ++i)
+            {
+                if (i >= group.NSpheres)
+                {
+                    group.X[i] = group.Y[i] = group.Z[i] = group.Radius[i] = 0.0f;
+                    continue;
+                }
+
+                const float* sphere = &spheres[order[(groupI * GroupSize) + i] * 4];
+                group.X[i] = sphere[0];
+                group.Y[i] = sphere[1];
+                group.Z[i] = sphere[2];
+                group.Radius[i] = sphere[3];
+
+                Vector3f center(sphere[0], sphere[1], sphere[2]),
+                         extents(sphere[3], sphere[3], sphere[3]);
+                groupBounds[groupI].Encapsulate(BoundingBox(center - extents, center + extents));
+            }
+        }
+    });
+
+    //The groups only depend on the spheres, so their BVH can be cached by a hash of them.
+    BVHCache::Hasher hasher;
+    hasher.Add(nSpheres);
+    hasher.AddBytes(spheres, Spheres.GetSize() * sizeof(float));
+    if (!BVHCache::TryLoad("SphereBatch", hasher.Value, nGroups, bvh))
+    {
+        bvh.Build(groupBounds.data(), groupBounds.size());
+        BVHCache::Save("SphereBatch", hasher.Value, bvh);
+    }
+
+    worldBounds = bvh.GetBounds().GetTransformed(Tr);
+}
+
+bool SphereBatch::CastRay(const Ray& ray, Vertex& outHit, FastRand& prng,
+                          float tMin, float tMax) const
+{
+    Ray localRay = Tr.Ray_WorldToLocal(ray);
+    float invDirLengthSqr = 1.0f / localRay.GetDir().Dot(localRay.GetDir());
+
+    int closestGroup = -1,
+        closestSphere = -1;
+    float closestT;
+    bvh.CastRay(localRay, tMin, tMax, [&](unsigned int groupI, float& hitT)
+    {
+        float t;
+        int sphere = CastRay(groups[groupI], localRay, invDirLengthSqr, tMin, hitT, t);
+        if (sphere < 0)
+            return false;
+
+        hitT = t;
+        closestT = t;
+        closestGroup = (int)groupI;
+        closestSphere = sphere;
+        return true;
+    });
+
+    if (closestGroup < 0)
+        return false;
+
+    const Group& group = groups[closestGroup];
+    Vector3f center(group.X[closestSphere], group.Y[closestSphere], group.Z[closestSphere]),
+             localHit = localRay.GetPos(closestT);
+    Vector3f localNormal = (localHit - center).Normalize();
+
+    outHit.Pos = Tr.Point_LocalToWorld(localHit);
+    Sphere::GetSurfaceData(WrapAxis, localNormal, Tr.Normal_LocalToWorld(localNormal).Normalize(), outHit);
+    return true;
+}
+int SphereBatch::CastRay(const Group& group, const Ray& ray, float invDirLengthSqr,
+                         float tMin, float tMax, float& outT)
+{
+    //For each sphere, find where the ray comes closest to its center,
+    //    then step backwards and forwards from there to the surface.
+    //This is much more precise than the usual "b^2 - 4ac" when the spheres are small compared to their distance.
+    float ts[GroupSize];
+    unsigned int hitMask = 0;
+
+#if RT_BVH_SIMD
+    __m128 posX = _mm_set1_ps(ray.GetPos().x), posY = _mm_set1_ps(ray.GetPos().y), posZ = _mm_set1_ps(ray.GetPos().z),
+           dirX = _mm_set1_ps(ray.GetDir().x), dirY = _mm_set1_ps(ray.GetDir().y), dirZ = _mm_set1_ps(ray.GetDir().z),
+           invDirLengthSqrs = _mm_set1_ps(invDirLengthSqr),
+           tMins = _mm_set1_ps(tMin), tMaxes = _mm_set1_ps(tMax),
+           zero = _mm_setzero_ps();
+    for (unsigned int i = 0; i < GroupSize; i += 4)
+    {
+        __m128 toRayX = _mm_sub_ps(posX, _mm_loadu_ps(group.X + i)),
+               toRayY = _mm_sub_ps(posY, _mm_loadu_ps(group.Y + i)),
+               toRayZ = _mm_sub_ps(posZ, _mm_loadu_ps(group.Z + i)),
+               radius = _mm_loadu_ps(group.Radius + i);
+
+        __m128 tClosest = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toRayX, dirX), _mm_mul_ps(toRayY, dirY)),
+                                                _mm_mul_ps(toRayZ, dirZ)),
+                                     invDirLengthSqrs);
+        tClosest = _mm_sub_ps(zero, tClosest);
+
+        __m128 offsetX = _mm_add_ps(toRayX, _mm_mul_ps(dirX, tClosest)),
+               offsetY = _mm_add_ps(toRayY, _mm_mul_ps(dirY, tClosest)),
+               offsetZ = _mm_add_ps(toRayZ, _mm_mul_ps(dirZ, tClosest));
+        __m128 offsetSqr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(offsetX, offsetX), _mm_mul_ps(offsetY, offsetY)),
+                                      _mm_mul_ps(offsetZ, offsetZ));
+
+        __m128 discriminant = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(radius, radius), offsetSqr), invDirLengthSqrs),
+               root = _mm_sqrt_ps(_mm_max_ps(discriminant, zero));
+        __m128 t1 = _mm_sub_ps(tClosest, root),
+               t2 = _mm_add_ps(tClosest, root);
+
+        //Use the nearer root unless it's behind "tMin".
+        __m128 useT1 = _mm_cmpge_ps(t1, tMins);
+        __m128 t = _mm_or_ps(_mm_and_ps(useT1, t1), _mm_andnot_ps(useT1, t2));
+
+        __m128 isHit = _mm_and_ps(_mm_cmpge_ps(discriminant, zero),
+                                  _mm_and_ps(_mm_cmpge_ps(t, tMins), _mm_cmple_ps(t, tMaxes)));
+        _mm_storeu_ps(ts + i, t);
+        hitMask |= (unsigned int)_mm_movemask_ps(isHit) << i;
+    }
+#else
+    for (unsigned int i = 0; i < GroupSize; ++i)
+    {
+        Vector3f toRay = ray.GetPos() - Vector3f(group.X[i], group.Y[i], group.Z[i]);
+        float tClosest = -toRay.Dot(ray.GetDir()) * invDirLengthSqr;
+        Vector3f closestOffset = toRay + (ray.GetDir() * tClosest);
+
+        float discriminant = ((group.Radius[i] * group.Radius[i]) - closestOffset.Dot(closestOffset)) *
+                             invDirLengthSqr;
+        if (discriminant < 0.0f)
+            continue;
+
+        float root = sqrtf(discriminant);
+        ts[i] = tClosest - root;
+        if (ts[i] < tMin)
+            ts[i] = tClosest + root;
+        if (ts[i] >= tMin && ts[i] <= tMax)
+            hitMask |= (1 << i);
+    }
+#endif
+
+    hitMask &= (1 << group.NSpheres) - 1;
+
+    int closest = -1;
+    for (unsigned int i = 0; i < GroupSize; ++i)
+    {
+        if ((hitMask & (1 << i)) != 0 && (closest < 0 || ts[i] < outT))
+        {
+            closest = (int)i;
+            outT = ts[i];
+        }
+    }
+    return closest;
+}
+
+void SphereBatch::WriteData(DataWriter& writer) const
+{
+    Shape::WriteData(writer);
+    writer.WriteFloats(Spheres.GetData(), Spheres.GetSize(), "Spheres");
+    writer.WriteByte(WrapAxis, "WrapAxis");
+}
+void SphereBatch::ReadData(DataReader& reader)
+{
+    Shape::ReadData(reader);
+
+    reader.ReadFloats(Spheres, "Spheres");
+    if (Spheres.GetSize() % 4 != 0)
+    {
+        reader.ErrorMessage = "Sphere batch data should have four floats per sphere, but it had ";
+        reader.ErrorMessage += String(Spheres.GetSize());
+        reader.ErrorMessage += " floats";
+        throw DataReader::EXCEPTION_FAILURE;
+    }
+
+    reader.ReadByte(WrapAxis, "WrapAxis");
+    if (WrapAxis > 2)
+    {
+        reader.ErrorMessage = "Sphere batch wrap axis should be [0, 2] but it was ";
+        reader.ErrorMessage += String(WrapAxis);
+        throw DataReader::EXCEPTION_FAILURE;
+    }
+}
\ No newline at end of file
@@ -23,109 +23,110 @@ misrepresented as being the original source code.
 
 Ren Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+NOTE: This is an altered version of the original source.
+Encoding and decoding were rewritten to use lookup tables and pre-sized output,
+    since they are used for large blocks of mesh data.
+
 */
 
 
 #include "../../Headers/ThirdParty/base64.h"
 
-#include <iostream>
 
-static const std::string base64_chars =
+static const char base64_chars[] =
 "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
 "abcdefghijklmnopqrstuvwxyz"
 "0123456789+/";
 
 
-static inline bool is_base64(unsigned char c)
+namespace
 {
-    return (isalnum(c) || (c == '+') || (c == '/'));
+    //Maps each character to its 6-bit value, or to 0xff if it isn't a base64 character.
+    struct DecodeTable
+    {
+        unsigned char Values[256];
+        DecodeTable()
+        {
+            for (int i = 0; i < 256; ++i)
+                Values[i] = 0xff;
+            for (int i = 0; i < 64; ++i)
+                Values[(unsigned char)base64_chars[i]] = (unsigned char)i;
+        }
+    };
+    const DecodeTable decodeTable;
 }
 
+
 std::string base64::encode(unsigned char const* bytes_to_encode, size_t in_len)
 {
     std::string ret;
-    int i = 0;
-    int j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
+    ret.resize(((in_len + 2) / 3) * 4);
+    char* out = &ret[0];
 
-    while (in_len--)
+    size_t i = 0;
+    for (; i + 2 < in_len; i += 3)
     {
-        char_array_3[i++] = *(bytes_to_encode++);
-        if (i == 3)
-        {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-
-            for (i = 0; (i <4); i++)
-                ret += base64_chars[char_array_4[i]];
-            i = 0;
-        }
+        unsigned int triple = ((unsigned int)bytes_to_encode[i] << 16) |
+                              ((unsigned int)bytes_to_encode[i + 1] << 8) |
+                              (unsigned int)bytes_to_encode[i + 2];
+        *(out++) = base64_chars[(triple >> 18) & 0x3f];
+        *(out++) = base64_chars[(triple >> 12) & 0x3f];
+        *(out++) = base64_chars[(triple >> 6) & 0x3f];
+        *(out++) = base64_chars[triple & 0x3f];
     }
 
-    if (i)
+    size_t nLeft = in_len - i;
+    if (nLeft > 0)
     {
-        for (j = i; j < 3; j++)
-            char_array_3[j] = '\0';
-
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-        char_array_4[3] = char_array_3[2] & 0x3f;
-
-        for (j = 0; (j < i + 1); j++)
-            ret += base64_chars[char_array_4[j]];
-
-        while ((i++ < 3))
-            ret += '=';
-
+        unsigned int triple = ((unsigned int)bytes_to_encode[i] << 16);
+        if (nLeft > 1)
+            triple |= ((unsigned int)bytes_to_encode[i + 1] << 8);
+
+        *(out++) = base64_chars[(triple >> 18) & 0x3f];
+        *(out++) = base64_chars[(triple >> 12) & 0x3f];
+        *(out++) = (nLeft > 1 ? base64_chars[(triple >> 6) & 0x3f] : '=');
+        *(out++) = '=';
     }
 
     return ret;
-
 }
 
 void base64::decode(std::string const& encoded_string, std::vector<unsigned char>& ret)
 {
-    int in_len = encoded_string.size();
-    int i = 0;
-    int j = 0;
-    int in_ = 0;
-    unsigned char char_array_4[4], char_array_3[3];
+    const unsigned char* in = (const unsigned char*)encoded_string.data();
+    size_t in_len = encoded_string.size();
 
-    while (in_len-- && (encoded_string[in_] != '=') && is_base64(encoded_string[in_]))
-    {
-        char_array_4[i++] = encoded_string[in_]; in_++;
-        if (i == 4)
-        {
-            for (i = 0; i <4; i++)
-                char_array_4[i] = base64_chars.find(char_array_4[i]);
+    //Stop at the first padding or non-base64 character, like the original implementation.
+    size_t nValid = 0;
+    while (nValid < in_len && decodeTable.Values[in[nValid]] != 0xff)
+        nValid += 1;
 
-            char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-            char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-            char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    size_t startSize = ret.size();
+    ret.resize(startSize + ((nValid * 3) / 4));
+    unsigned char* out = ret.data() + startSize;
 
-            for (i = 0; (i < 3); i++)
-                ret.push_back(char_array_3[i]);
-            i = 0;
-        }
+    size_t i = 0;
+    for (; i + 3 < nValid; i += 4)
+    {
+        unsigned int quad = ((unsigned int)decodeTable.Values[in[i]] << 18) |
+                            ((unsigned int)decodeTable.Values[in[i + 1]] << 12) |
+                            ((unsigned int)decodeTable.Values[in[i + 2]] << 6) |
+                            (unsigned int)decodeTable.Values[in[i + 3]];
+        *(out++) = (unsigned char)(quad >> 16);
+        *(out++) = (unsigned char)(quad >> 8);
+        *(out++) = (unsigned char)quad;
     }
 
-    if (i)
+    size_t nLeft = nValid - i;
+    if (nLeft > 1)
     {
-        for (j = i; j <4; j++)
-            char_array_4[j] = 0;
-
-        for (j = 0; j <4; j++)
-            char_array_4[j] = base64_chars.find(char_array_4[j]);
-
-        char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-        char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-        char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-        for (j = 0; (j < i - 1); j++)
-            ret.push_back(char_array_3[j]);
+        unsigned int quad = ((unsigned int)decodeTable.Values[in[i]] << 18) |
+                            ((unsigned int)decodeTable.Values[in[i + 1]] << 12);
+        if (nLeft > 2)
+            quad |= ((unsigned int)decodeTable.Values[in[i + 2]] << 6);
+
+        *(out++) = (unsigned char)(quad >> 16);
+        if (nLeft > 2)
+            *(out++) = (unsigned char)(quad >> 8);
     }
-}
\ No newline at end of file
+}
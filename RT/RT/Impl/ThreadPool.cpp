@@ -0,0 +1,167 @@
+#include "../Headers/ThreadPool.h"
+
+#include <atomic>
+#include <algorithm>
+#include <exception>
+
+using namespace RT;
+
+
+struct ThreadPool::Batch
+{
+    const std::function<void(size_t)>* Job;
+    size_t Count;
+
+    std::atomic<size_t> NextIndex, NDone;
+
+    //The first exception thrown by the job, which is rethrown on the thread that started it.
+    //Once there is one, the rest of the indices are skipped. Guarded by the pool's mutex.
+    std::exception_ptr Error;
+    std::atomic<bool> HasFailed;
+
+    Batch(const std::function<void(size_t)>* job, size_t count)
+        : Job(job), Count(count), NextIndex(0), NDone(0), HasFailed(false) { }
+};
+
+
+ThreadPool& ThreadPool::GetGlobal()
+{
+    //The pool is intentionally never destroyed;
+    //    joining threads while the DLL is unloading can deadlock on Windows.
+    static ThreadPool* pool = new ThreadPool();
+    return *pool;
+}
+
+ThreadPool::ThreadPool(size_t nThreads)
+{
+    if (nThreads == 0)
+        nThreads = std::thread::hardware_concurrency();
+    if (nThreads == 0)
+        nThreads = 1;
+
+    //The thread that starts a job counts as one of the threads.
+    for (size_t i = 1; i < nThreads; ++i)
+        workers.push_back(std::thread([this]() { RunWorker(); }));
+}
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutx);
+        isStopping = true;
+    }
+    hasWork.notify_all();
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 0)
+        return;
+
+    //If there's nothing to split, don't bother with the other threads.
+    if (count == 1 || workers.empty())
+    {
+        for (size_t i = 0; i < count; ++i)
+            job(i);
+        return;
+    }
+
+    auto batch = std::make_shared<Batch>(&job, count);
+
+    //Newer batches go to the front, so that jobs started from inside other jobs finish quickly.
+    {
+        std::lock_guard<std::mutex> lock(mutx);
+        batches.push_front(batch);
+    }
+    hasWork.notify_all();
+
+    RunBatch(*batch);
+
+    //Wait for the other threads to finish the indices they took.
+    std::unique_lock<std::mutex> lock(mutx);
+    auto found = std::find(batches.begin(), batches.end(), batch);
+    if (found != batches.end())
+        batches.erase(found);
+    finishedWork.wait(lock, [&batch, count]() { return batch->NDone == count; });
+
+    if (batch->Error)
+        std::rethrow_exception(batch->Error);
+}
+void ThreadPool::ParallelForRanges(size_t count, size_t minChunkSize,
+                                   const std::function<void(size_t, size_t)>& job)
+{
+    if (count == 0)
+        return;
+
+    //Use a few chunks per thread so that uneven chunks still balance out.
+    minChunkSize = (minChunkSize > 0 ? minChunkSize : 1);
+    size_t nChunks = std::min(GetNThreads() * 4, (count + minChunkSize - 1) / minChunkSize);
+    nChunks = (nChunks > 0 ? nChunks : 1);
+    size_t chunkSize = (count + nChunks - 1) / nChunks;
+
+    ParallelFor(nChunks, [&](size_t chunk)
+    {
+        size_t start = chunk * chunkSize,
+               end = std::min(count, start + chunkSize);
+        if (start < end)
+            job(start, end);
+    });
+}
+
+void ThreadPool::RunWorker()
+{
+    while (true)
+    {
+        std::shared_ptr<Batch> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutx);
+            hasWork.wait(lock, [this]() { return isStopping || !batches.empty(); });
+            if (isStopping)
+                return;
+
+            batch = batches.front();
+
+            //If every index in the batch has been taken, nobody else needs to see it.
+            if (batch->NextIndex >= batch->Count)
+            {
+                batches.pop_front();
+                continue;
+            }
+        }
+
+        RunBatch(*batch);
+    }
+}
+void ThreadPool::RunBatch(Batch& batch)
+{
+    size_t i;
+    while ((i = batch.NextIndex++) < batch.Count)
+    {
+        //An exception mustn't escape a worker thread, or skip the starting thread's wait for the others.
+        //The index still counts as done, so the batch finishes either way.
+        if (!batch.HasFailed)
+        {
+            try
+            {
+                (*batch.Job)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutx);
+                if (!batch.Error)
+                    batch.Error = std::current_exception();
+                batch.HasFailed = true;
+            }
+        }
+
+        if (++batch.NDone == batch.Count)
+        {
+            //Lock the mutex so the notification can't slip in
+            //    between the waiting thread checking the count and going to sleep.
+            std::lock_guard<std::mutex> lock(mutx);
+            finishedWork.notify_all();
+        }
+    }
+}
@@ -2,9 +2,19 @@
 
 #include <assert.h>
 
-#include "../Headers/FastRand.h"
+#include "../Headers/Samplers.h"
 #include "../Headers/Material.h"
 #include "../Headers/SkyMaterial.h"
+#include "../Headers/ThreadPool.h"
+#include "../Headers/BVHCache.h"
+#include "../Headers/Instance.h"
+#include "../Headers/ConstantMedium.h"
+#include "../Headers/HeterogeneousMedium.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
 
 
 #ifdef OS_WINDOWS
@@ -21,19 +31,233 @@ namespace
 {
     float max(float f1, float f2) { return (f1 > f2) ? f1 : f2; }
     float min(float f1, float f2) { return (f1 > f2) ? f2 : f1; }
+
+
+    //Records how deeply the instanced geometry inside the given shape is nested, keeping the deepest.
+    void FindGeometryDepths(const SharedPtr<Shape>& shape, size_t depth,
+                            std::unordered_map<const Shape*, size_t>& depths,
+                            std::vector<SharedPtr<Shape>>& outGeometry)
+    {
+        if (const Instance* instance = dynamic_cast<const Instance*>(shape.Get()))
+        {
+            const SharedPtr<Shape>& geometry = instance->Geometry;
+            auto found = depths.find(geometry.Get());
+            if (found == depths.end())
+            {
+                depths[geometry.Get()] = depth + 1;
+                outGeometry.push_back(geometry);
+            }
+            else if (found->second < depth + 1)
+            {
+                found->second = depth + 1;
+            }
+            else
+            {
+                return;
+            }
+            FindGeometryDepths(geometry, depth + 1, depths, outGeometry);
+        }
+        else if (const ConstantMedium* medium = dynamic_cast<const ConstantMedium*>(shape.Get()))
+        {
+            FindGeometryDepths(medium->Surface, depth, depths, outGeometry);
+        }
+        else if (const HeterogeneousMedium* medium = dynamic_cast<const HeterogeneousMedium*>(shape.Get()))
+        {
+            FindGeometryDepths(medium->Surface, depth, depths, outGeometry);
+        }
+    }
+    //Gets every unique piece of geometry that needs precalculating before the given objects,
+    //    including geometry used by instances nested inside other geometry or used as a medium's surface.
+    //An instance's bounds come from its geometry, so the geometry is grouped by how deeply it's nested,
+    //    and each group must be precalculated before the next one.
+    void GetGeometryToPrecalc(const List<ShapeAndMat>& objects,
+                              std::vector<std::vector<SharedPtr<Shape>>>& outGroups)
+    {
+        std::unordered_map<const Shape*, size_t> depths;
+        std::vector<SharedPtr<Shape>> geometry;
+        for (size_t i = 0; i < objects.GetSize(); ++i)
+            FindGeometryDepths(objects[i].Shpe, 0, depths, geometry);
+
+        size_t maxDepth = 0;
+        for (const auto& depth : depths)
+            maxDepth = std::max(maxDepth, depth.second);
+        outGroups.clear();
+        outGroups.resize(maxDepth);
+        for (const SharedPtr<Shape>& g : geometry)
+            outGroups[maxDepth - depths[g.Get()]].push_back(g);
+    }
+    //Gets every unique piece of geometry used by instances in the given objects, however deeply nested,
+    //    in the same order as "GetGeometryToPrecalc()".
+    //Geometry that's nested inside other geometry comes before it.
+    void GetInstancedGeometry(const List<ShapeAndMat>& objects, std::vector<SharedPtr<Shape>>& outGeometry)
+    {
+        std::vector<std::vector<SharedPtr<Shape>>> groups;
+        GetGeometryToPrecalc(objects, groups);
+        for (const std::vector<SharedPtr<Shape>>& group : groups)
+            outGeometry.insert(outGeometry.end(), group.begin(), group.end());
+    }
+
+
+    //Objects whose bounds have at least this fraction of the whole scene's surface area
+    //    are left out of the object BVH, since they'd make every node above them just as large.
+    const float largeObjectFraction = 0.25f;
+    //At most this many (finite) objects are left out of the BVH for being too large;
+    //    the largest ones are picked first.
+    const size_t maxLargeObjects = 8;
+
+
+    //The number of sampler dimensions used to generate a camera ray: one for the lens, two for the pixel.
+    const unsigned int cameraDimensions = 3;
+    //The number of sampler dimensions set aside for each bounce of a ray.
+    //Bounces that use fewer leave the rest unused, so every bounce of every sample
+    //    starts at the same dimension and lines up with the same bounce of the pixel's other samples.
+    const unsigned int dimensionsPerBounce = 8;
+
+    bool IsUnbounded(const BoundingBox& b)
+    {
+        bool isEmpty = !(b.Min.x <= b.Max.x && b.Min.y <= b.Max.y && b.Min.z <= b.Max.z);
+        return !isEmpty &&
+               !(std::isfinite(b.Min.x) && std::isfinite(b.Min.y) && std::isfinite(b.Min.z) &&
+                 std::isfinite(b.Max.x) && std::isfinite(b.Max.y) && std::isfinite(b.Max.z));
+    }
+
+    //Splits the objects into the ones that go into the object BVH and the ones that are tested separately:
+    //    unbounded objects, plus any that are huge compared to the rest of the scene (e.x. ground planes).
+    //Also outputs the bounds of the objects going into the BVH.
+    void SplitObjects(const std::vector<BoundingBox>& objectBounds,
+                      std::vector<unsigned int>& outBounded, std::vector<unsigned int>& outUnbounded,
+                      std::vector<BoundingBox>& outBoundedBounds)
+    {
+        outBounded.clear();
+        outUnbounded.clear();
+        outBoundedBounds.clear();
+
+        BoundingBox sceneBounds = BoundingBox::Empty();
+        for (const BoundingBox& b : objectBounds)
+            if (!IsUnbounded(b))
+                sceneBounds.Encapsulate(b);
+        float sceneArea = sceneBounds.GetSurfaceArea();
+
+        std::vector<unsigned int> largeObjects;
+        for (unsigned int i = 0; i < (unsigned int)objectBounds.size(); ++i)
+        {
+            if (IsUnbounded(objectBounds[i]))
+                outUnbounded.push_back(i);
+            else if (sceneArea > 0.0f && objectBounds[i].GetSurfaceArea() >= sceneArea * largeObjectFraction)
+                largeObjects.push_back(i);
+        }
+
+        //If there are too many large objects, only keep the largest ones out of the BVH.
+        std::sort(largeObjects.begin(), largeObjects.end(), [&](unsigned int a, unsigned int b)
+            { return objectBounds[a].GetSurfaceArea() > objectBounds[b].GetSurfaceArea(); });
+        if (largeObjects.size() > maxLargeObjects)
+            largeObjects.resize(maxLargeObjects);
+        outUnbounded.insert(outUnbounded.end(), largeObjects.begin(), largeObjects.end());
+        std::sort(outUnbounded.begin(), outUnbounded.end());
+
+        for (unsigned int i = 0, unboundedI = 0; i < (unsigned int)objectBounds.size(); ++i)
+        {
+            if (unboundedI < outUnbounded.size() && outUnbounded[unboundedI] == i)
+            {
+                unboundedI += 1;
+            }
+            else
+            {
+                outBounded.push_back(i);
+                outBoundedBounds.push_back(objectBounds[i]);
+            }
+        }
+    }
 }
 
 
 namespace
 {
+    //Generates the camera rays for each pixel of an image.
+    struct CameraRays
+    {
+        const Camera& Cam;
+        float InvWidth, InvHeight, LensRadius,
+              AspectRatioSqr, HalfWidthBase, HalfHeightBase,
+              FocusDist;
+
+        CameraRays(const Camera& cam, size_t width, size_t height,
+                   float verticalFOVDegrees, float aperture, float focusDist)
+            : Cam(cam), FocusDist(focusDist)
+        {
+            InvWidth = 1.0f / (float)(width - 1);
+            InvHeight = 1.0f / (float)(height - 1);
+            LensRadius = aperture / 2.0f;
+
+            float aspectRatio = InvHeight / InvWidth;
+            AspectRatioSqr = aspectRatio * aspectRatio;
+
+            //Generate the ray's start on a disc of diameter "aperture" surrounding the circle.
+            //Generate the target pixel's world position using a pixel grid projected forward to "focusDist".
+            //To do this, we need some trig.
+            float theta = verticalFOVDegrees * (float)M_PI / 180.0f;
+            //Get the half-width/height when focus distance is 1.
+            HalfHeightBase = tanf(theta / 2.0f);
+            HalfWidthBase = HalfHeightBase * cam.WidthOverHeight;
+        }
+
+        //Gets a random ray through the given pixel.
+        Ray Get(size_t x, size_t y, Sampler& sampler) const
+        {
+            //A measure from -1.0 to +1.0 of the camera-space position of the pixel.
+            float fY = -1.0 + (2.0f * (float)y * InvHeight);
+            float fX = -1.0f + (2.0f * (float)x * InvWidth);
+            fX *= AspectRatioSqr;
+
+            Vector2f lensOffset = sampler.NextUnitVector2() * LensRadius;
+            Vector3f worldLensOffset = (Cam.GetSideways() * lensOffset.x) +
+                                       (Cam.GetUpward() * lensOffset.y);
+
+            Vector2f pixelOffset = sampler.Next2D();
+            pixelOffset.x *= InvWidth;
+            pixelOffset.y *= InvHeight;
+
+            //Get the pixel position when the focus distance is 1,
+            //    then scale that up based on the actual focus distance.
+            //The trig works out so that it's a linear scale.
+            Vector3f pixelPos = Cam.Pos +
+                                (Cam.GetForward() * FocusDist) +
+                                (Cam.GetSideways() * (fX + pixelOffset.x) * HalfHeightBase * FocusDist) +
+                                (Cam.GetUpward() * (fY + pixelOffset.y) * HalfWidthBase * FocusDist);
+
+            Vector3f rayStart = Cam.Pos + worldLensOffset;
+            return Ray(rayStart, (pixelPos - rayStart).Normalize());
+        }
+    };
+
+    //Traces the given sample of the given pixel and returns its color.
+    //If "outFeatures" isn't null, it's filled in with what the camera ray hit.
+    Vector3f TraceCameraSample(const Tracer& tracer, const CameraRays& rays,
+                               size_t x, size_t y, unsigned int sampleIndex,
+                               size_t maxBounces, Sampler& sampler,
+                               AOVBuffers::Pixel* outFeatures = nullptr)
+    {
+        sampler.StartSample((unsigned int)x, (unsigned int)y, sampleIndex);
+        Ray r = rays.Get(x, y, sampler);
+
+        Vector3f color;
+        Vertex hit;
+        float dist;
+        tracer.TraceRay(0, maxBounces, r, sampler, color, hit, dist, outFeatures);
+        return color;
+    }
+
+
     struct ThreadDat
     {
         const Tracer* tracer;
         const Camera* cam;
         Texture2D* tex;
+        AOVBuffers* aovs;
         float verticalFOVDegrees, aperture, focusDist;
         size_t samples, bounces;
-        
+        Sampler::Types samplerType;
+
         size_t startY, endY;
     };
 
@@ -47,7 +271,7 @@ namespace
         ThreadDat& d = *(ThreadDat*)pDat;
         d.tracer->TraceImage(*d.cam, *d.tex, d.startY, d.endY, d.bounces,
                              d.verticalFOVDegrees, d.aperture, d.focusDist,
-                             d.samples);
+                             d.samples, d.samplerType, d.aovs);
         return 0;
     }
 }
@@ -60,9 +284,7 @@ void ShapeAndMat::WriteData(DataWriter& writer) const
 }
 void ShapeAndMat::ReadData(DataReader& reader)
 {
-    Shape* sPtr;
-    Shape::ReadValue(sPtr, reader, "Shape");
-    Shpe.Reset(sPtr);
+    Shape::ReadValue(Shpe, reader, "Shape");
 
     Material* mPtr;
     Material::ReadValue(mPtr, reader, "Material");
@@ -75,27 +297,102 @@ Tracer::Tracer(SkyMaterial* skyMat, const List<ShapeAndMat>& objects)
 {
 }
 
+void Tracer::PrecalcData()
+{
+    ThreadPool& pool = ThreadPool::GetGlobal();
+
+    //Geometry shared between instances has to be precalculated once, before the instances themselves.
+    std::vector<std::vector<SharedPtr<Shape>>> instancedGeometry;
+    GetGeometryToPrecalc(Objects, instancedGeometry);
+    for (std::vector<SharedPtr<Shape>>& group : instancedGeometry)
+        pool.ParallelFor(group.size(), [&](size_t i) { group[i]->PrecalcData(); });
+
+    //Shapes like meshes split their own work across the pool too,
+    //    so one big mesh doesn't hold up the rest of the scene.
+    std::vector<BoundingBox> objectBounds(Objects.GetSize());
+    pool.ParallelFor(Objects.GetSize(), [&](size_t i)
+    {
+        Objects[i].Shpe->PrecalcData();
+        Objects[i].Shpe->GetBoundingBox(objectBounds[i]);
+    });
+
+    std::vector<BoundingBox> boundedObjectBounds;
+    SplitObjects(objectBounds, boundedObjects, unboundedObjects, boundedObjectBounds);
+
+    //The object BVH only depends on the objects' world-space bounds,
+    //    which cover both their geometry and their transforms.
+    BVHCache::Hasher hasher;
+    hasher.Add(boundedObjectBounds.size());
+    hasher.AddBytes(boundedObjectBounds.data(), boundedObjectBounds.size() * sizeof(BoundingBox));
+    if (!BVHCache::TryLoad("Scene", hasher.Value, boundedObjectBounds.size(), objectBVH))
+    {
+        objectBVH.Build(boundedObjectBounds.data(), boundedObjectBounds.size(), pool);
+        BVHCache::Save("Scene", hasher.Value, objectBVH);
+    }
+}
+void Tracer::UpdatePrecalcData()
+{
+    ThreadPool& pool = ThreadPool::GetGlobal();
+
+    std::vector<std::vector<SharedPtr<Shape>>> instancedGeometry;
+    GetGeometryToPrecalc(Objects, instancedGeometry);
+    for (std::vector<SharedPtr<Shape>>& group : instancedGeometry)
+        pool.ParallelFor(group.size(), [&](size_t i) { group[i]->UpdatePrecalcData(); });
+
+    std::vector<BoundingBox> objectBounds(Objects.GetSize());
+    pool.ParallelFor(Objects.GetSize(), [&](size_t i)
+    {
+        Objects[i].Shpe->UpdatePrecalcData();
+        Objects[i].Shpe->GetBoundingBox(objectBounds[i]);
+    });
+
+    //Objects may have grown or shrunk enough to move in or out of the BVH.
+    //The BVH can still be refit in that case, since it only sees a list of bounds;
+    //    it gets rebuilt if that makes it too inefficient.
+    std::vector<BoundingBox> boundedObjectBounds;
+    SplitObjects(objectBounds, boundedObjects, unboundedObjects, boundedObjectBounds);
+    objectBVH.Update(boundedObjectBounds.data(), boundedObjectBounds.size(), pool);
+}
+
 const ShapeAndMat* Tracer::TraceRay(const Ray& ray, Vertex& outHit, FastRand& prng, float& outDist) const
 {
     outDist = std::numeric_limits<float>().infinity();
     int closestShape = -1;
 
     //Get the closest intersection with a shape.
-    for (size_t i = 0; i < Objects.GetSize(); ++i)
+    //Shapes and the BVH cull by the ray's "t" value rather than by distance,
+    //    and the two only match for normalized rays (rough metal, for one, scatters rays that aren't),
+    //    so the closest hit's "t" is tracked separately.
+    float invDirLength = 1.0f / ray.GetDir().Length(),
+          closestT = std::numeric_limits<float>().infinity();
+    auto testObject = [&](unsigned int i, float& tMax)
     {
-        float tempDist;
         Vertex tempHit;
-        if (Objects[i].Shpe->CastRay(ray, tempHit, prng))
+        if (Objects[i].Shpe->CastRay(ray, tempHit, prng, 0.0f, tMax))
         {
-            tempDist = tempHit.Pos.Distance(ray.GetPos());
+            float tempDist = tempHit.Pos.Distance(ray.GetPos());
             if (tempDist < outDist)
             {
                 outDist = tempDist;
                 outHit = tempHit;
-                closestShape = i;
+                closestShape = (int)i;
+                closestT = tempDist * invDirLength;
+                tMax = closestT;
+                return true;
             }
         }
+        return false;
+    };
+
+    //Test the objects outside the BVH first, since a close hit on one (e.x. the ground)
+    //    lets the BVH skip everything behind it.
+    for (unsigned int i : unboundedObjects)
+    {
+        float tMax = closestT;
+        testObject(i, tMax);
     }
+    objectBVH.CastRay(ray, 0.0f, closestT, [&](unsigned int i, float& tMax)
+        { return testObject(boundedObjects[i], tMax); });
 
     if (closestShape < 0)
         return nullptr;
@@ -103,30 +400,45 @@ const ShapeAndMat* Tracer::TraceRay(const Ray& ray, Vertex& outHit, FastRand& pr
         return &Objects[closestShape];
 }
 bool Tracer::TraceRay(size_t bounce, size_t maxBounces,
-                      Ray& ray, FastRand& prng,
-                      Vector3f& outColor, Vertex& outHit, float& outDist) const
+                      Ray& ray, Sampler& sampler,
+                      Vector3f& outColor, Vertex& outHit, float& outDist,
+                      AOVBuffers::Pixel* outFeatures) const
 {
+    sampler.SkipToDimension(cameraDimensions + ((unsigned int)bounce * dimensionsPerBounce));
+
     if (bounce >= maxBounces)
     {
         //The ray went too far; assume it's fully attenuated.
         outColor = Vector3f();
+        if (outFeatures != nullptr)
+            *outFeatures = AOVBuffers::Pixel();
         return false;
     }
 
-    const ShapeAndMat* hit = TraceRay(ray, outHit, prng, outDist);
+    const ShapeAndMat* hit = TraceRay(ray, outHit, sampler.GetPRNG(), outDist);
 
     //Get the color of the shape's surface.
     if (hit != nullptr)
     {
         Ray newR;
         Vector3f atten, emissive;
-        bool scattered = hit->Mat->Scatter(ray, outHit, *hit->Shpe, prng, atten, emissive, newR);
+        bool scattered = hit->Mat->Scatter(ray, outHit, *hit->Shpe, sampler, atten, emissive, newR);
+
+        //The attenuation is the material's albedo, so it doesn't need to be evaluated again.
+        if (outFeatures != nullptr)
+        {
+            outFeatures->Albedo = atten;
+            outFeatures->Normal = outHit.Normal;
+            outFeatures->Depth = outDist;
+            outFeatures->ObjectIndex = (int)(hit - Objects.GetData());
+        }
+
         if (scattered)
         {
             Vector3f bounceCol;
             Vertex bounceHit;
             float bounceDist;
-            TraceRay(bounce + 1, maxBounces, newR, prng, bounceCol, bounceHit, bounceDist);
+            TraceRay(bounce + 1, maxBounces, newR, sampler, bounceCol, bounceHit, bounceDist);
 
             outColor = emissive + (atten * bounceCol);
         }
@@ -139,85 +451,317 @@ bool Tracer::TraceRay(size_t bounce, size_t maxBounces,
     }
 
     //No shape was hit, so get the color of the sky.
-    outColor = SkyMat->GetColor(ray, prng);
+    outColor = SkyMat->GetColor(ray, sampler);
+    if (outFeatures != nullptr)
+    {
+        *outFeatures = AOVBuffers::Pixel();
+        outFeatures->Albedo = outColor;
+    }
     return false;
 }
 
 void Tracer::TraceImage(const Camera& cam, Texture2D& tex,
                         size_t startY, size_t endY, size_t maxBounces,
                         float verticalFOVDegrees, float aperture, float focusDist,
-                        size_t nSamples) const
+                        size_t nSamples, Sampler::Types samplerType,
+                        AOVBuffers* aovs) const
 {
-    float invSamples = 1.0f / (float)nSamples,
-          invWidth = 1.0f / (float)(tex.GetWidth() - 1),
-          invHeight = 1.0f / (float)(tex.GetHeight() - 1),
-          lensRadius = aperture / 2.0f;
-    float aspectRatio = invHeight / invWidth,
-          aspectRatioSqr = aspectRatio * aspectRatio;
-
-    //Generate the ray's start on a disc of diameter "aperture" surrounding the circle.
-    //Generate the target pixel's world position using a pixel grid projected forward to "focusDist".
-    //To do this, we need some trig.
-    float theta = verticalFOVDegrees * (float)M_PI / 180.0f;
-    //Get the half-width/height when focus distance is 1.
-    float halfHeightBase = tanf(theta / 2.0f),
-          halfWidthBase = halfHeightBase * cam.WidthOverHeight;
+    assert(aovs == nullptr || (aovs->GetWidth() == tex.GetWidth() && aovs->GetHeight() == tex.GetHeight()));
+
+    UniquePtr<Sampler> sampler(Sampler::Create(samplerType));
+    CameraRays rays(cam, tex.GetWidth(), tex.GetHeight(), verticalFOVDegrees, aperture, focusDist);
+    float invSamples = 1.0f / (float)nSamples;
 
     for (size_t y = startY; y <= endY; ++y)
     {
-        //A measure from -1.0 to +1.0 of the camera-space Y position of the pixel.
-        float fY = -1.0 + (2.0f * (float)y * invHeight);
-
         for (size_t x = 0; x < tex.GetWidth(); ++x)
         {
-            //A measure from -1.0 to +1.0 of the camera-space X position of the pixel.
-            float fX = -1.0f + (2.0f * (float)x * invWidth);
-            fX *= aspectRatioSqr;
-
             //Average the result of a bunch of random samples inside the pixel.
-
             Vector3f color(0.0f, 0.0f, 0.0f);
+            if (aovs == nullptr)
+            {
+                for (size_t i = 0; i < nSamples; ++i)
+                    color += TraceCameraSample(*this, rays, x, y, (unsigned int)i, maxBounces, *sampler);
+            }
+            else
+            {
+                //The depth and object come from the first sample, since they can't be averaged.
+                AOVBuffers::Pixel& features = aovs->Get(x, y);
+                AOVBuffers::Pixel sampleFeatures;
+                for (size_t i = 0; i < nSamples; ++i)
+                {
+                    color += TraceCameraSample(*this, rays, x, y, (unsigned int)i, maxBounces, *sampler,
+                                               &sampleFeatures);
+                    if (i == 0)
+                    {
+                        features = sampleFeatures;
+                    }
+                    else
+                    {
+                        features.Albedo += sampleFeatures.Albedo;
+                        features.Normal += sampleFeatures.Normal;
+                    }
+                }
+                features.Albedo *= invSamples;
+                features.Normal *= invSamples;
+            }
+            color *= invSamples;
 
-            FastRand fr((int)x, (int)y);
+            tex.SetColor(x, y, color);
+        }
+    }
+}
 
+void Tracer::TracePass(const Camera& cam, RenderBuffer& buffer, ThreadPool& pool,
+                       size_t maxBounces, float verticalFOVDegrees, float aperture, float focusDist,
+                       const std::function<size_t(size_t x, size_t y)>& getNSamples,
+                       Sampler::Types samplerType) const
+{
+    TracePass(cam, buffer, buffer.GetWidth(), buffer.GetHeight(), 0, 0, pool,
+              maxBounces, verticalFOVDegrees, aperture, focusDist, getNSamples, samplerType);
+}
+void Tracer::TracePass(const Camera& cam, RenderBuffer& buffer,
+                       size_t imageWidth, size_t imageHeight, size_t bufferMinX, size_t bufferMinY,
+                       ThreadPool& pool,
+                       size_t maxBounces, float verticalFOVDegrees, float aperture, float focusDist,
+                       const std::function<size_t(size_t x, size_t y)>& getNSamples,
+                       Sampler::Types samplerType) const
+{
+    assert(bufferMinX + buffer.GetWidth() <= imageWidth && bufferMinY + buffer.GetHeight() <= imageHeight);
+    CameraRays rays(cam, imageWidth, imageHeight, verticalFOVDegrees, aperture, focusDist);
+
+    //Rows are handed out to threads one at a time, so threads that get cheap rows just take more of them.
+    pool.ParallelFor(buffer.GetHeight(), [&](size_t y)
+    {
+        UniquePtr<Sampler> sampler(Sampler::Create(samplerType));
+        for (size_t x = 0; x < buffer.GetWidth(); ++x)
+        {
+            size_t nSamples = getNSamples(x, y);
+            unsigned int firstSample = buffer.GetNSamples(x, y);
             for (size_t i = 0; i < nSamples; ++i)
             {
-                Vector2f lensOffset = fr.NextUnitVector2() * lensRadius;
-                Vector3f worldLensOffset = (cam.GetSideways() * lensOffset.x) +
-                                           (cam.GetUpward() * lensOffset.y);
-
-                Vector2f pixelOffset(fr.NextFloat() * invWidth,
-                                     fr.NextFloat() * invHeight);
-
-                //Get the pixel position when the focus distance is 1,
-                //    then scale that up based on the actual focus distance.
-                //The trig works out so that it's a linear scale.
-                Vector3f pixelPos = cam.Pos +
-                                    (cam.GetForward() * focusDist) +
-                                    (cam.GetSideways() * (fX + pixelOffset.x) * halfHeightBase * focusDist) +
-                                    (cam.GetUpward() * (fY + pixelOffset.y) * halfWidthBase * focusDist);
-
-                Vector3f rayStart = cam.Pos + worldLensOffset;
-                Ray r(rayStart, (pixelPos - rayStart).Normalize());
-
-                Vector3f tempCol;
-                Vertex outHit;
-                float outDist;
-                TraceRay(0, maxBounces, r, fr, tempCol, outHit, outDist);
-
-                color += tempCol;
+                Vector3f color = TraceCameraSample(*this, rays, bufferMinX + x, bufferMinY + y,
+                                                   firstSample + (unsigned int)i, maxBounces, *sampler);
+                buffer.AddSample(x, y, color);
             }
-            color *= invSamples;
+        }
+    });
+}
 
-            tex.SetColor(x, y, color);
+void Tracer::TraceCropImage(const Camera& cam, Texture2D& tex,
+                            size_t imageWidth, size_t imageHeight,
+                            size_t cropMinX, size_t cropMinY, size_t cropWidth, size_t cropHeight,
+                            size_t nThreads, size_t maxBounces,
+                            float verticalFOVDegrees, float aperture, float focusDist,
+                            size_t nSamples, Sampler::Types samplerType) const
+{
+    assert(cropMinX + cropWidth <= imageWidth && cropMinY + cropHeight <= imageHeight);
+    bool isCropSized = (tex.GetWidth() == cropWidth && tex.GetHeight() == cropHeight);
+    assert(isCropSized || (tex.GetWidth() == imageWidth && tex.GetHeight() == imageHeight));
+
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+    RenderBuffer buffer(cropWidth, cropHeight);
+    TracePass(cam, buffer, imageWidth, imageHeight, cropMinX, cropMinY, pool,
+              maxBounces, verticalFOVDegrees, aperture, focusDist,
+              [&](size_t x, size_t y) { return nSamples; }, samplerType);
+
+    size_t offsetX = (isCropSized ? 0 : cropMinX),
+           offsetY = (isCropSized ? 0 : cropMinY);
+    for (size_t y = 0; y < cropHeight; ++y)
+        for (size_t x = 0; x < cropWidth; ++x)
+            tex.SetColor(offsetX + x, offsetY + y, buffer.GetColor(x, y));
+}
+
+size_t Tracer::TraceAdaptiveImage(const Camera& cam, Texture2D& tex,
+                                  size_t nThreads, size_t maxBounces,
+                                  float verticalFOVDegrees, float aperture, float focusDist,
+                                  size_t minSamples, size_t maxSamples, float targetError,
+                                  Sampler::Types samplerType) const
+{
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+    RenderBuffer buffer(tex.GetWidth(), tex.GetHeight());
+
+    //The error can't be estimated with less than two samples.
+    maxSamples = std::max(maxSamples, minSamples);
+    minSamples = std::min(std::max(minSamples, (size_t)2), maxSamples);
+    TracePass(cam, buffer, pool, maxBounces, verticalFOVDegrees, aperture, focusDist,
+              [&](size_t x, size_t y) { return minSamples; }, samplerType);
+
+    //Pixels are judged in tiles: a tile keeps going as long as any of its pixels are too noisy.
+    //A pixel whose few samples happened to agree could look converged on its own,
+    //    but it's unlikely that a whole tile would.
+    size_t nTilesX = (tex.GetWidth() + AdaptiveTileSize - 1) / AdaptiveTileSize,
+           nTilesY = (tex.GetHeight() + AdaptiveTileSize - 1) / AdaptiveTileSize;
+    std::vector<char> isTileActive(nTilesX * nTilesY);
+    while (true)
+    {
+        bool anyActive = false;
+        for (size_t tileY = 0; tileY < nTilesY; ++tileY)
+        {
+            for (size_t tileX = 0; tileX < nTilesX; ++tileX)
+            {
+                bool isActive = false;
+                size_t endX = std::min((tileX + 1) * AdaptiveTileSize, tex.GetWidth()),
+                       endY = std::min((tileY + 1) * AdaptiveTileSize, tex.GetHeight());
+                for (size_t y = tileY * AdaptiveTileSize; y < endY && !isActive; ++y)
+                    for (size_t x = tileX * AdaptiveTileSize; x < endX && !isActive; ++x)
+                        isActive = (buffer.GetNSamples(x, y) < maxSamples &&
+                                    buffer.GetRelativeError(x, y) > targetError);
+
+                isTileActive[tileX + (tileY * nTilesX)] = (isActive ? 1 : 0);
+                anyActive |= isActive;
+            }
         }
+        if (!anyActive)
+            break;
+
+        //Each pass doubles the samples of every pixel that's still going,
+        //    so only a few passes are needed to get from the minimum to the maximum.
+        TracePass(cam, buffer, pool, maxBounces, verticalFOVDegrees, aperture, focusDist,
+                  [&](size_t x, size_t y) -> size_t
+                  {
+                      if (isTileActive[(x / AdaptiveTileSize) + ((y / AdaptiveTileSize) * nTilesX)] == 0)
+                          return 0;
+                      size_t nSamples = buffer.GetNSamples(x, y);
+                      return std::min(nSamples, maxSamples - nSamples);
+                  },
+                  samplerType);
+    }
+
+    buffer.CopyTo(tex);
+    return buffer.GetTotalSamples();
+}
+
+size_t Tracer::TraceTimedImage(const Camera& cam, Texture2D& tex,
+                               size_t nThreads, size_t maxBounces,
+                               float verticalFOVDegrees, float aperture, float focusDist,
+                               float budgetSeconds, Sampler::Types samplerType) const
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point startTime = Clock::now();
+
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+    RenderBuffer buffer(tex.GetWidth(), tex.GetHeight());
+
+    //Start with a single sample, to measure how long a sample takes.
+    //After that, each pass doubles the samples so far,
+    //    until the time left is only enough for a smaller pass.
+    size_t nSamples = 0,
+           nPassSamples = 1;
+    while (nPassSamples > 0)
+    {
+        TracePass(cam, buffer, pool, maxBounces, verticalFOVDegrees, aperture, focusDist,
+                  [&](size_t x, size_t y) { return nPassSamples; }, samplerType);
+        nSamples += nPassSamples;
+
+        //Samples can finish faster than the clock's resolution, making the number that fit infinite,
+        //    so it's capped before converting to an integer.
+        double elapsed = std::chrono::duration<double>(Clock::now() - startTime).count(),
+               secondsPerSample = elapsed / nSamples,
+               secondsLeft = budgetSeconds - elapsed,
+               nSamplesThatFit = secondsLeft / secondsPerSample;
+        if (secondsLeft <= 0.0)
+            nPassSamples = 0;
+        else if (nSamplesThatFit >= (double)nSamples)
+            nPassSamples = nSamples;
+        else
+            nPassSamples = (size_t)nSamplesThatFit;
+    }
+
+    buffer.CopyTo(tex);
+    return nSamples;
+}
+
+void Tracer::TraceCheckpointedImage(const Camera& cam, RenderBuffer& buffer,
+                                    size_t nThreads, size_t maxBounces,
+                                    float verticalFOVDegrees, float aperture, float focusDist,
+                                    size_t nSamples, float checkpointSeconds,
+                                    const std::function<void(const RenderBuffer&)>& onCheckpoint,
+                                    Sampler::Types samplerType) const
+{
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point lastCheckpoint = Clock::now();
+
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+
+    //Passes are sized to take about as long as the checkpoint interval,
+    //    based on how long the passes so far have taken per sample.
+    size_t nPassSamples = 1,
+           nSamplesSinceCheckpoint = 0;
+    while (true)
+    {
+        bool isDone = true;
+        for (size_t y = 0; y < buffer.GetHeight() && isDone; ++y)
+            for (size_t x = 0; x < buffer.GetWidth() && isDone; ++x)
+                isDone = (buffer.GetNSamples(x, y) >= nSamples);
+        if (isDone)
+            break;
+
+        TracePass(cam, buffer, pool, maxBounces, verticalFOVDegrees, aperture, focusDist,
+                  [&](size_t x, size_t y) -> size_t
+                  {
+                      size_t nPixelSamples = buffer.GetNSamples(x, y);
+                      return (nPixelSamples >= nSamples ? 0 : std::min(nPassSamples, nSamples - nPixelSamples));
+                  },
+                  samplerType);
+        nSamplesSinceCheckpoint += nPassSamples;
+
+        double elapsed = std::chrono::duration<double>(Clock::now() - lastCheckpoint).count();
+        if (elapsed >= checkpointSeconds)
+        {
+            onCheckpoint(buffer);
+            lastCheckpoint = Clock::now();
+            nSamplesSinceCheckpoint = 0;
+        }
+        else
+        {
+            //Samples can finish faster than the clock's resolution, making this infinite,
+            //    so cap it at the full sample count before converting to an integer.
+            double secondsPerSample = elapsed / nSamplesSinceCheckpoint,
+                   nSamplesThatFit = (checkpointSeconds - elapsed) / secondsPerSample;
+            nPassSamples = (nSamplesThatFit >= (double)nSamples ?
+                                nSamples :
+                                std::max((size_t)1, (size_t)nSamplesThatFit));
+        }
+    }
+
+    onCheckpoint(buffer);
+}
+
+void Tracer::TracePreviewImage(const Camera& cam, Texture2D& tex,
+                               size_t nThreads, size_t maxBounces,
+                               float verticalFOVDegrees, float aperture, float focusDist,
+                               const std::function<void(const Texture2D&, size_t blockSize)>& onPass,
+                               Sampler::Types samplerType) const
+{
+    ThreadPool pool(nThreads > 1 ? nThreads : 1);
+    RenderBuffer buffer(tex.GetWidth(), tex.GetHeight());
+
+    //Each block's traced pixel is its top-left one, which is also the top-left pixel
+    //    of one of the smaller blocks in the next pass, so no pixel is ever traced twice.
+    for (size_t blockSize = PreviewFirstBlockSize; blockSize > 0; blockSize /= 2)
+    {
+        TracePass(cam, buffer, pool, maxBounces, verticalFOVDegrees, aperture, focusDist,
+                  [&](size_t x, size_t y) -> size_t
+                  {
+                      return (x % blockSize == 0 && y % blockSize == 0 &&
+                              buffer.GetNSamples(x, y) == 0) ?
+                                 1 : 0;
+                  },
+                  samplerType);
+
+        for (size_t y = 0; y < tex.GetHeight(); ++y)
+            for (size_t x = 0; x < tex.GetWidth(); ++x)
+                tex.SetColor(x, y, buffer.GetColor(x - (x % blockSize), y - (y % blockSize)));
+        onPass(tex, blockSize);
     }
 }
 
 void Tracer::TraceFullImage(const Camera& cam, Texture2D& tex,
                             size_t nThreads, size_t maxBounces,
                             float verticalFOVDegrees, float aperture, float focusDist,
-                            size_t nSamples) const
+                            size_t nSamples, Sampler::Types samplerType,
+                            AOVBuffers* aovs) const
 {
     nThreads = (nThreads > 1 ? nThreads : 1);
     size_t span = tex.GetHeight() / nThreads;
@@ -225,12 +769,14 @@ void Tracer::TraceFullImage(const Camera& cam, Texture2D& tex,
     ThreadDat dat;
     dat.cam = &cam;
     dat.tex = &tex;
+    dat.aovs = aovs;
     dat.tracer = this;
     dat.verticalFOVDegrees = verticalFOVDegrees;
     dat.aperture = aperture;
     dat.focusDist = focusDist;
     dat.bounces = maxBounces;
     dat.samples = nSamples;
+    dat.samplerType = samplerType;
     
     std::vector<ThreadDat> dats;
     dats.resize(nThreads);
@@ -290,16 +836,73 @@ void Tracer::TraceFullImage(const Camera& cam, Texture2D& tex,
 void Tracer::WriteData(DataWriter& writer) const
 {
     SkyMaterial::WriteValue(*SkyMat, writer, "SkyMaterial");
+
+    //Geometry shared between instances is written once, and the instances refer to it by ID.
+    //That includes instances inside the shared geometry itself,
+    //    whose geometry always comes earlier in the list.
+    std::vector<SharedPtr<Shape>> instancedGeometry;
+    GetInstancedGeometry(Objects, instancedGeometry);
+    ConstShapeToID geometryIDs;
+    for (size_t i = 0; i < instancedGeometry.size(); ++i)
+        geometryIDs[instancedGeometry[i].Get()] = (unsigned int)i;
+
+    Instance::GeometryIDScope idScope(&geometryIDs, nullptr);
+    writer.WriteList<SharedPtr<Shape>>(instancedGeometry.data(), instancedGeometry.size(),
+                                       [](DataWriter& writer, const SharedPtr<Shape>& s, const String& name)
+                                          { Shape::WriteValue(*s, writer, name); },
+                                       "SharedGeometry");
     writer.WriteList<ShapeAndMat>(Objects.GetData(), Objects.GetSize(),
                                   [](DataWriter& writer, const ShapeAndMat& o, const String& name)
                                     { writer.WriteDataStructure(o, name); },
                                   "Objects");
 }
 void Tracer::ReadData(DataReader& reader)
+{
+    Objects.Clear();
+    ReadData(reader, false);
+}
+void Tracer::ReadDataInPlace(DataReader& reader)
+{
+    ReadData(reader, true);
+}
+void Tracer::ReadData(DataReader& reader, bool reuseShapes)
 {
     SkyMaterial::ReadValue(SkyMat, reader, "SkyMaterial");
 
-    Objects.Clear();
+    //Read the geometry shared between instances. Older files don't have any.
+    //When reusing shapes, the geometry is read into the existing geometry,
+    //    which is found in the same order that it was written in.
+    //Each piece of geometry can refer to the ones before it by ID, so they're added as they're read.
+    struct SharedGeometryList
+    {
+        std::vector<SharedPtr<Shape>> Geometry;
+        IDToShape ByID;
+    };
+    SharedGeometryList sharedGeometry;
+    if (reuseShapes)
+        GetInstancedGeometry(Objects, sharedGeometry.Geometry);
+    Instance::GeometryIDScope idScope(nullptr, &sharedGeometry.ByID);
+    try
+    {
+        reader.ReadList<SharedPtr<Shape>>(&sharedGeometry,
+                                          [](void* pList, size_t nElements)
+                                            { ((SharedGeometryList*)pList)->Geometry.resize(nElements); },
+                                          [](DataReader& rd, void* pList, size_t i, const String& name)
+                                            {
+                                                SharedGeometryList& list = *(SharedGeometryList*)pList;
+                                                Shape::ReadValue(list.Geometry[i], rd, name);
+                                                list.ByID[(unsigned int)i] = list.Geometry[i];
+                                            },
+                                          "SharedGeometry");
+    }
+    catch (int)
+    {
+        reader.ErrorMessage = "";
+        sharedGeometry.Geometry.clear();
+        sharedGeometry.ByID.Clear();
+    }
+
+    //Any objects that are already in the list get read into, reusing their shapes where possible.
     reader.ReadList<ShapeAndMat>(&Objects,
                                  [](void* pList, size_t nElements)
                                     { ((std::vector<ShapeAndMat>*)pList)->resize(nElements); },
@@ -32,11 +32,25 @@ void Transform::UpdateMats()
     rotM.SetAsRotate(rot);
     scaleM.SetAsScale(scale);
 
-    toWorld = Matrix4f(Matrix4f(scaleM, rotM), transM);
-    toWorld.GetInverse(toLocal);
+    Matrix4f world(Matrix4f(scaleM, rotM), transM),
+             local;
+    world.GetInverse(local);
 
-    toWorld.GetTranspose(toLocal_InverseTranspose);
-    toLocal.GetTranspose(toWorld_InverseTranspose);
+    toWorld = Matrix3x4f(world);
+    toLocal = Matrix3x4f(local);
+}
+
+Matrix4f Transform::GetMatToWorld_InverseTranspose() const
+{
+    Matrix4f m;
+    GetMatToLocal().GetTranspose(m);
+    return m;
+}
+Matrix4f Transform::GetWorldToLocal_InverseTranspose() const
+{
+    Matrix4f m;
+    GetMatToWorld().GetTranspose(m);
+    return m;
 }
 
 void Transform::WriteData(DataWriter& writer) const
@@ -1,5 +1,7 @@
 #include "../Headers/Triangle.h"
 
+#include <initializer_list>
+
 using namespace RT;
 
 
@@ -88,4 +90,29 @@ void Triangle::GetMoreData(Vertex& vert, const Transform& transf) const
     vert.UV = (Verts[0].UV * area0) + (Verts[1].UV * area1) + (Verts[2].UV * area2);
 
     vert.Pos = transf.Point_LocalToWorld(vert.Pos);
+}
+BoundingBox Triangle::GetClippedBounds(int axis, float min, float max) const
+{
+    //The clipped triangle's corners are its original corners inside the range,
+    //    plus wherever its edges cross the two planes.
+    BoundingBox bounds = BoundingBox::Empty();
+    for (int i = 0; i < 3; ++i)
+    {
+        const Vector3f &a = Verts[i].Pos,
+                       &b = Verts[(i + 1) % 3].Pos;
+        if (a[axis] >= min && a[axis] <= max)
+            bounds.Encapsulate(a);
+
+        for (float plane : { min, max })
+        {
+            if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane))
+            {
+                float t = (plane - a[axis]) / (b[axis] - a[axis]);
+                Vector3f crossing = a + ((b - a) * t);
+                crossing[axis] = plane;
+                bounds.Encapsulate(crossing);
+            }
+        }
+    }
+    return bounds;
 }
\ No newline at end of file
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <unordered_set>
+
+#include <RT.hpp>
+
+using namespace RT;
+
+
+//Compares the speed of casting rays through each BVH layout.
+//The BVH is built over every triangle in the scene's meshes (or over the scene's objects, if it has no meshes).
+//Each layout casts the same random rays, and each primitive is tested by its bounding box,
+//    so only the ray-box tests and the traversal itself are being measured.
+//If the scene has meshes, BVHs built with and without spatial splits are then compared
+//    using the actual triangles, since spatial splits only pay off in fewer triangle tests.
+class BVHBenchmark
+{
+public:
+
+    BVHBenchmark(const Tracer& scene, size_t nRays)
+    {
+        //Get the primitives.
+        std::unordered_set<const Mesh*> meshes;
+        for (size_t i = 0; i < scene.Objects.GetSize(); ++i)
+        {
+            const Shape* shape = scene.Objects[i].Shpe.Get();
+            const Instance* instance = dynamic_cast<const Instance*>(shape);
+            if (instance != nullptr)
+                shape = instance->Geometry.Get();
+
+            const Mesh* mesh = dynamic_cast<const Mesh*>(shape);
+            if (mesh != nullptr && meshes.insert(mesh).second)
+            {
+                for (size_t j = 0; j < mesh->Tris.GetSize(); ++j)
+                {
+                    BoundingBox bounds = BoundingBox::Empty();
+                    for (size_t k = 0; k < 3; ++k)
+                        bounds.Encapsulate(mesh->Tris[j].Verts[k].Pos);
+                    primBounds.push_back(bounds);
+
+                    tris.push_back(mesh->Tris[j]);
+                    tris.back().PrecalcData();
+                }
+            }
+        }
+        if (primBounds.empty())
+        {
+            primBounds.resize(scene.Objects.GetSize());
+            for (size_t i = 0; i < scene.Objects.GetSize(); ++i)
+                scene.Objects[i].Shpe->GetBoundingBox(primBounds[i]);
+        }
+
+        tree.Build(primBounds.data(), primBounds.size());
+
+        //Rays start anywhere inside the primitives' bounds and go in any direction.
+        //They're generated eight at a time, one per lane of the random number generator.
+        FastRand8 prng(12345);
+        BoundingBox bounds = (tree.IsEmpty() ? BoundingBox() : tree.GetBounds());
+        Vector3f size = bounds.GetSize();
+        rays.reserve(nRays);
+        const unsigned int nLanes = FastRand8::NLanes;
+        float values[5][nLanes];
+        for (size_t i = 0; i < nRays; ++i)
+        {
+            unsigned int lane = (unsigned int)(i % nLanes);
+            if (lane == 0)
+                for (unsigned int j = 0; j < 5; ++j)
+                    prng.NextFloats(values[j]);
+
+            Vector3f pos(bounds.Min.x + (size.x * values[0][lane]),
+                         bounds.Min.y + (size.y * values[1][lane]),
+                         bounds.Min.z + (size.z * values[2][lane]));
+
+            float theta = 2.0f * (float)M_PI * values[3][lane],
+                  z = -1.0f + (2.0f * values[4][lane]),
+                  radius = sqrt(1.0f - (z * z));
+            rays.push_back(Ray(pos, Vector3f(cosf(theta) * radius, sinf(theta) * radius, z)));
+        }
+    }
+
+    //Runs the benchmark for every layout and prints the results.
+    void Run(std::ostream& out)
+    {
+        out << "Benchmarking " << rays.size() << " rays through a BVH of " << primBounds.size() << " primitives\n";
+
+        size_t binaryBytes = tree.GetNodes().size() * sizeof(BVHTree::Node);
+        RunLayout(out, "Binary", binaryBytes,
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return tree.CastRayBinary(ray, 0.0f, tMax, testPrim, &nBoxTests); });
+
+        WideBVH<4, BVHTree::MaxDepth> tree4;
+        tree4.Build(tree.GetNodes());
+        RunLayout(out, "4-wide", tree4.GetNodes().size() * sizeof(WideBVH<4, BVHTree::MaxDepth>::Node),
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return tree4.CastRay(ray, 0.0f, tMax, tree.GetPrimIndices().data(), testPrim, &nBoxTests); });
+
+        WideBVH<8, BVHTree::MaxDepth> tree8;
+        tree8.Build(tree.GetNodes());
+        RunLayout(out, "8-wide", tree8.GetNodes().size() * sizeof(WideBVH<8, BVHTree::MaxDepth>::Node),
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return tree8.CastRay(ray, 0.0f, tMax, tree.GetPrimIndices().data(), testPrim, &nBoxTests); });
+
+        CompressedBVH<BVHTree::MaxDepth> compressedTree;
+        compressedTree.Build(tree4);
+        RunLayout(out, "Compressed 4-wide", compressedTree.GetNNodes() * sizeof(CompressedBVH<BVHTree::MaxDepth>::Node),
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return compressedTree.CastRay(ray, 0.0f, tMax, tree.GetPrimIndices().data(), testPrim, &nBoxTests); });
+
+        if (RT_BVH_COMPRESSED)
+            out << "Rays are cast through the compressed 4-wide layout when rendering.\n";
+        else
+            out << "Rays are cast through the " << RT_BVH_WIDTH << "-wide layout when rendering.\n";
+
+        if (tris.empty())
+            return;
+
+        out << "Comparing spatial splits (budget " << Mesh::SpatialSplitBudget << ") against the actual triangles\n";
+        RunLayout(out, "4-wide, object splits", tree4.GetNodes().size() * sizeof(WideBVH<4, BVHTree::MaxDepth>::Node),
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return tree4.CastRay(ray, 0.0f, tMax, tree.GetPrimIndices().data(), testPrim, &nBoxTests); },
+                  true);
+
+        auto startTime = std::chrono::steady_clock::now();
+        BVHTree spatialTree;
+        spatialTree.BuildSpatial(primBounds.data(), primBounds.size(),
+                                 [&](unsigned int tri, int axis, float min, float max)
+                                     { return tris[tri].GetClippedBounds(axis, min, max); },
+                                 Mesh::SpatialSplitBudget);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        out << "\tBuilt the spatial-split BVH in " << seconds << " seconds, with " <<
+               ((double)spatialTree.GetPrimIndices().size() / primBounds.size()) <<
+               " references per triangle\n";
+
+        WideBVH<4, BVHTree::MaxDepth> spatialTree4;
+        spatialTree4.Build(spatialTree.GetNodes());
+        RunLayout(out, "4-wide, spatial splits", spatialTree4.GetNodes().size() * sizeof(WideBVH<4, BVHTree::MaxDepth>::Node),
+                  [&](const Ray& ray, float tMax, const auto& testPrim, size_t& nBoxTests)
+                      { return spatialTree4.CastRay(ray, 0.0f, tMax, spatialTree.GetPrimIndices().data(), testPrim, &nBoxTests); },
+                  true);
+    }
+
+
+private:
+
+    std::vector<BoundingBox> primBounds;
+    std::vector<Triangle> tris;
+    BVHTree tree;
+    std::vector<Ray> rays;
+
+
+    //If "testTriangles" is true, the primitives are tested with the actual triangles instead of their bounds.
+    template<typename RayCaster>
+    void RunLayout(std::ostream& out, const char* name, size_t nodeBytes, RayCaster castRay,
+                   bool testTriangles = false)
+    {
+        size_t nBoxTests = 0,
+               nPrimTests = 0,
+               nHits = 0;
+
+        auto startTime = std::chrono::steady_clock::now();
+        for (const Ray& ray : rays)
+        {
+            Vector3f invDir = ray.GetDir().Reciprocal();
+            auto testPrim = [&](unsigned int prim, float& tMax)
+            {
+                nPrimTests += 1;
+                if (testTriangles)
+                {
+                    Vector3f hitPos;
+                    float hitDist;
+                    if (!tris[prim].RayIntersect(ray, hitPos, hitDist, 0.0f, tMax))
+                        return false;
+                    tMax = hitDist;
+                    return true;
+                }
+
+                nBoxTests += 1;
+                float tEnter;
+                if (!primBounds[prim].RayIntersects(ray.GetPos(), invDir, 0.0f, tMax, tEnter))
+                    return false;
+                tMax = tEnter;
+                return true;
+            };
+            if (castRay(ray, std::numeric_limits<float>::infinity(), testPrim, nBoxTests))
+                nHits += 1;
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        out << "\t" << name << ": " <<
+               (nodeBytes / 1024) << " KB of nodes, " <<
+               (rays.size() / seconds / 1000000.0) << " million rays/sec, " <<
+               (nBoxTests / seconds / 1000000.0) << " million box tests/sec, " <<
+               ((double)nBoxTests / rays.size()) << " box tests per ray, ";
+        if (testTriangles)
+            out << ((double)nPrimTests / rays.size()) << " triangle tests per ray, ";
+        out << nHits << " hits\n";
+    }
+};
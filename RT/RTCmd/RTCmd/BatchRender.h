@@ -0,0 +1,130 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <string>
+
+#include <RT.hpp>
+
+using namespace RT;
+
+
+//Renders one scene from many cameras, listed in a JSON file.
+//Every view's tiles go into one queue on one thread pool,
+//    so threads that finish the last tiles of one view move straight on to the next view.
+//Each view's image is saved as soon as its last tile is done.
+namespace BatchRender
+{
+    //The width and height of each tile.
+    static const size_t TileSize = 32;
+
+
+    //One camera to render the scene from, and where to save the image.
+    //Like "-cForward" and "-cUp", the forward and upward vectors are normalized after being read.
+    struct View : public IReadable
+    {
+        Vector3f Pos, Forward, Up;
+        String OutputPath;
+
+        virtual void ReadData(DataReader& reader) override
+        {
+            reader.ReadVec3f(Pos, "Pos");
+            reader.ReadVec3f(Forward, "Forward");
+            reader.ReadVec3f(Up, "Up");
+            reader.ReadString(OutputPath, "OutputPath");
+
+            Forward = Forward.Normalize();
+            Up = Up.Normalize();
+        }
+    };
+    //The contents of a views file.
+    struct ViewList : public IReadable
+    {
+        std::vector<View> Views;
+
+        virtual void ReadData(DataReader& reader) override
+        {
+            reader.ReadList<View>(&Views,
+                                  [](void* pList, size_t nElements)
+                                     { ((std::vector<View>*)pList)->resize(nElements); },
+                                  [](DataReader& rd, void* pList, size_t i, const String& name)
+                                     { rd.ReadDataStructure((*(std::vector<View>*)pList)[i], name); },
+                                  "Views");
+        }
+    };
+
+
+    //Renders the given scene from every view.
+    //"saveImage(tex, path, log)" saves an image and returns RTCmd's exit code;
+    //    it's called from whichever thread finishes the view.
+    //Returns 0 if every image was saved, or else the exit code of the first one that wasn't.
+    template<typename SaveImageFunc>
+    int Run(const Tracer& scene, const std::vector<View>& views,
+            size_t width, size_t height, size_t maxBounces, size_t nSamples,
+            float verticalFOVDegrees, float aperture, float focusDist,
+            ThreadPool& pool, SaveImageFunc saveImage, std::ostream& log)
+    {
+        size_t nTilesX = (width + TileSize - 1) / TileSize,
+               nTilesY = (height + TileSize - 1) / TileSize,
+               nTilesPerView = nTilesX * nTilesY;
+
+        //Each view's image only exists while its tiles are being rendered,
+        //    so a long list of views doesn't need all their images in memory at once.
+        struct ViewState
+        {
+            std::unique_ptr<Camera> Cam;
+            std::unique_ptr<Texture2D> Image;
+            std::once_flag StartFlag;
+            std::atomic<size_t> NTilesLeft;
+        };
+        std::unique_ptr<ViewState[]> states(new ViewState[views.size()]);
+        for (size_t i = 0; i < views.size(); ++i)
+            states[i].NTilesLeft = nTilesPerView;
+
+        //Saving images is done one at a time, so their log messages don't get mixed up.
+        std::mutex saveLock;
+        int firstError = 0;
+
+        //Tiles are numbered view by view, and handed out in order,
+        //    so views finish one after another instead of all at the end.
+        pool.ParallelFor(views.size() * nTilesPerView, [&](size_t i)
+        {
+            size_t viewI = i / nTilesPerView,
+                   tileI = i % nTilesPerView;
+            const View& view = views[viewI];
+            ViewState& state = states[viewI];
+
+            std::call_once(state.StartFlag, [&]()
+            {
+                state.Cam.reset(new Camera(view.Pos, view.Forward, view.Up, (float)width / (float)height));
+                state.Image.reset(new Texture2D(width, height));
+            });
+
+            size_t minX = (tileI % nTilesX) * TileSize,
+                   minY = (tileI / nTilesX) * TileSize;
+            RenderBuffer tile(std::min(TileSize, width - minX), std::min(TileSize, height - minY));
+            scene.TracePass(*state.Cam, tile, width, height, minX, minY, pool,
+                            maxBounces, verticalFOVDegrees, aperture, focusDist,
+                            [&](size_t x, size_t y) { return nSamples; });
+            for (size_t y = 0; y < tile.GetHeight(); ++y)
+                for (size_t x = 0; x < tile.GetWidth(); ++x)
+                    state.Image->SetColor(minX + x, minY + y, tile.GetColor(x, y));
+
+            if (--state.NTilesLeft == 0)
+            {
+                std::lock_guard<std::mutex> lock(saveLock);
+                int result = saveImage(*state.Image, std::string(view.OutputPath.CStr()), log);
+                if (result == 0)
+                    log << "Saved " << view.OutputPath.CStr() << " (" << (viewI + 1) << "/" << views.size() << ")\n";
+                else if (firstError == 0)
+                    firstError = result;
+                state.Image.reset();
+            }
+        });
+
+        return firstError;
+    }
+}
@@ -0,0 +1,349 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+#include <RT.hpp>
+
+#include "Socket.h"
+
+using namespace RT;
+
+
+//Splits a render across several RTCmd processes, which may be on other machines.
+//The coordinator splits the image into tiles and leases them out to workers that connect to it.
+//Each worker loads the scene itself, then repeatedly asks for a tile, renders it,
+//    and sends back the tile's final colors.
+//If a worker takes longer than the lease time or disconnects, its tile is leased to someone else.
+//Every pixel's samples only depend on the pixel, so the result is the same
+//    no matter which worker renders which tile.
+//All numbers are sent in the machine's own byte order, so every machine must have the same one.
+namespace DistributedRender
+{
+    //The width and height of each tile.
+    static const size_t TileSize = 32;
+    //Sent instead of a tile index when there's no work left.
+    static const uint32_t NoTile = 0xffffffff;
+
+    //Identifies the protocol, and must be changed whenever it changes.
+    static const char Magic[8] = { 'R', 'T', 'D', 'I', 'S', 'T', '0', '1' };
+
+    //The messages workers send.
+    enum MessageTypes : uint8_t
+    {
+        //Asks for a tile. The coordinator answers with its index, or "NoTile" once the image is done.
+        Message_Lease = 'L',
+        //A finished tile: its index, then its colors as three floats per pixel, row by row.
+        Message_Tile = 'T',
+    };
+
+    //The settings of a render, sent to each worker when it connects, followed by the scene path.
+    struct Job
+    {
+        Vector3f CamPos, CamForward, CamUp;
+        uint64_t Width, Height, NBounces, NSamples;
+        float VerticalFOVDegrees, Aperture, FocusDist;
+        uint32_t SamplerType;
+        uint64_t ScenePathLength;
+
+
+        size_t GetNTilesX() const { return (size_t)((Width + TileSize - 1) / TileSize); }
+        size_t GetNTilesY() const { return (size_t)((Height + TileSize - 1) / TileSize); }
+        size_t GetNTiles() const { return GetNTilesX() * GetNTilesY(); }
+
+        void GetTile(size_t index, size_t& outMinX, size_t& outMinY, size_t& outWidth, size_t& outHeight) const
+        {
+            outMinX = (index % GetNTilesX()) * TileSize;
+            outMinY = (index / GetNTilesX()) * TileSize;
+            outWidth = std::min(TileSize, (size_t)Width - outMinX);
+            outHeight = std::min(TileSize, (size_t)Height - outMinY);
+        }
+        size_t GetTileMessageSize(size_t index) const
+        {
+            size_t minX, minY, width, height;
+            GetTile(index, minX, minY, width, height);
+            return sizeof(uint32_t) + (width * height * 3 * sizeof(float));
+        }
+    };
+
+
+    //Hands out tiles to workers that connect on the given port, and puts their results in "outTex".
+    //Blocks until the whole image is done.
+    //Returns an error message, or the empty string if it succeeded.
+    inline std::string RunCoordinator(const Job& job, const std::string& scenePath,
+                                      unsigned short port, float leaseSeconds,
+                                      Texture2D& outTex, std::ostream& log)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        Socket listener = Socket::Listen(port);
+        if (!listener.IsValid())
+            return "couldn't listen on port " + std::to_string(port);
+
+        Job header = job;
+        header.ScenePathLength = scenePath.size();
+
+        struct Worker
+        {
+            Socket Connection;
+            size_t ID;
+            std::vector<char> Received;
+            bool IsWaitingForTile = false;
+        };
+        std::vector<Worker> workers;
+        size_t nextWorkerID = 0;
+
+        enum TileStates { Tile_Pending, Tile_Leased, Tile_Done };
+        struct Tile
+        {
+            TileStates State = Tile_Pending;
+            size_t WorkerID = 0;
+            Clock::time_point LeaseEnd;
+        };
+        std::vector<Tile> tiles(job.GetNTiles());
+        size_t nTilesDone = 0;
+
+        //Puts a received tile into the output image.
+        auto finishTile = [&](uint32_t index, const char* data)
+        {
+            if (tiles[index].State == Tile_Done)
+                return;
+
+            size_t minX, minY, width, height;
+            job.GetTile(index, minX, minY, width, height);
+            //The colors may not be aligned in the receive buffer, so copy them out.
+            const char* colors = data + sizeof(uint32_t);
+            for (size_t y = 0; y < height; ++y)
+                for (size_t x = 0; x < width; ++x)
+                {
+                    float color[3];
+                    memcpy(color, colors + ((x + (y * width)) * sizeof(color)), sizeof(color));
+                    outTex.SetColor(minX + x, minY + y, Vector3f(color[0], color[1], color[2]));
+                }
+
+            tiles[index].State = Tile_Done;
+            nTilesDone += 1;
+            log << "Finished tile " << nTilesDone << "/" << tiles.size() << "\n";
+        };
+
+        //Reads all the complete messages a worker has sent so far.
+        //Returns false if the worker sent something invalid.
+        auto readMessages = [&](Worker& worker)
+        {
+            size_t start = 0;
+            while (start < worker.Received.size())
+            {
+                const char* message = worker.Received.data() + start;
+                size_t nBytes = worker.Received.size() - start;
+                if (message[0] == Message_Lease)
+                {
+                    worker.IsWaitingForTile = true;
+                    start += 1;
+                }
+                else if (message[0] == Message_Tile)
+                {
+                    uint32_t index;
+                    if (nBytes < 1 + sizeof(uint32_t))
+                        break;
+                    memcpy(&index, message + 1, sizeof(uint32_t));
+                    if (index >= tiles.size())
+                        return false;
+
+                    size_t size = job.GetTileMessageSize(index);
+                    if (nBytes < 1 + size)
+                        break;
+                    finishTile(index, message + 1);
+                    start += 1 + size;
+                }
+                else
+                {
+                    return false;
+                }
+            }
+            worker.Received.erase(worker.Received.begin(), worker.Received.begin() + start);
+            return true;
+        };
+
+        //Gives up on a worker, and lets someone else have its tiles.
+        auto dropWorker = [&](size_t workerIndex)
+        {
+            for (Tile& tile : tiles)
+                if (tile.State == Tile_Leased && tile.WorkerID == workers[workerIndex].ID)
+                    tile.State = Tile_Pending;
+            workers.erase(workers.begin() + workerIndex);
+            log << "Lost a worker; " << workers.size() << " left\n";
+        };
+
+
+        log << "Waiting for workers on port " << port << "...\n";
+        std::vector<char> receiveBuffer(1 << 16);
+        while (nTilesDone < tiles.size())
+        {
+            //Take back any tiles whose lease ran out.
+            Clock::time_point now = Clock::now();
+            for (size_t i = 0; i < tiles.size(); ++i)
+            {
+                if (tiles[i].State == Tile_Leased && now >= tiles[i].LeaseEnd)
+                {
+                    tiles[i].State = Tile_Pending;
+                    log << "The lease on tile " << i << " expired\n";
+                }
+            }
+
+            //Give out tiles to any workers that want one.
+            for (size_t w = 0; w < workers.size(); ++w)
+            {
+                if (!workers[w].IsWaitingForTile)
+                    continue;
+
+                size_t tileI = 0;
+                while (tileI < tiles.size() && tiles[tileI].State != Tile_Pending)
+                    tileI += 1;
+                if (tileI == tiles.size())
+                    break;
+
+                if (workers[w].Connection.Send((uint32_t)tileI))
+                {
+                    tiles[tileI].State = Tile_Leased;
+                    tiles[tileI].WorkerID = workers[w].ID;
+                    tiles[tileI].LeaseEnd = now + std::chrono::duration_cast<Clock::duration>(
+                                                      std::chrono::duration<double>(leaseSeconds));
+                    workers[w].IsWaitingForTile = false;
+                }
+                else
+                {
+                    dropWorker(w);
+                    w -= 1;
+                }
+            }
+
+            //Wait for something to happen.
+            std::vector<const Socket*> sockets;
+            sockets.push_back(&listener);
+            for (const Worker& worker : workers)
+                sockets.push_back(&worker.Connection);
+            std::vector<bool> isReady;
+            if (!Socket::WaitForAny(sockets, 500, isReady))
+                continue;
+
+            //Read from the workers before accepting new ones, so "isReady" still lines up with them.
+            for (size_t w = workers.size(); w > 0; --w)
+            {
+                if (!isReady[w])
+                    continue;
+
+                Worker& worker = workers[w - 1];
+                int nReceived = worker.Connection.ReceiveSome(receiveBuffer.data(), receiveBuffer.size());
+                if (nReceived > 0)
+                    worker.Received.insert(worker.Received.end(),
+                                           receiveBuffer.begin(), receiveBuffer.begin() + nReceived);
+                if (nReceived <= 0 || !readMessages(worker))
+                    dropWorker(w - 1);
+            }
+
+            if (isReady[0])
+            {
+                Worker worker;
+                worker.Connection = listener.Accept();
+                worker.ID = nextWorkerID++;
+                if (worker.Connection.Send(Magic, sizeof(Magic)) &&
+                    worker.Connection.Send(header) &&
+                    worker.Connection.Send(scenePath.data(), scenePath.size()))
+                {
+                    workers.push_back(std::move(worker));
+                    log << "A worker connected; " << workers.size() << " total\n";
+                }
+            }
+        }
+
+        //Tell the workers that are waiting that there's nothing left.
+        //Any that are still working on a tile will find the connection closed when they finish.
+        for (Worker& worker : workers)
+            if (worker.IsWaitingForTile)
+                worker.Connection.Send(NoTile);
+        return "";
+    }
+
+
+    //Connects to the coordinator at the given address, then renders tiles for it until the image is done.
+    //Keeps trying to connect for a few seconds, in case the coordinator hasn't started yet.
+    //Returns an error message, or the empty string if it succeeded.
+    inline std::string RunWorker(const std::string& host, unsigned short port, size_t nThreads,
+                                 std::ostream& log)
+    {
+        Socket coordinator;
+        for (int attempt = 0; attempt < 20 && !coordinator.IsValid(); ++attempt)
+        {
+            if (attempt > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            coordinator = Socket::Connect(host, port);
+        }
+        if (!coordinator.IsValid())
+            return "couldn't connect to " + host + ":" + std::to_string(port);
+
+        char magic[sizeof(Magic)];
+        Job job;
+        if (!coordinator.Receive(magic, sizeof(magic)) || memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+            !coordinator.Receive(job))
+        {
+            return "the coordinator is using a different version of RTCmd";
+        }
+        std::string scenePath((size_t)job.ScenePathLength, ' ');
+        if (!coordinator.Receive(&scenePath[0], scenePath.size()))
+            return "lost the connection to the coordinator";
+
+        log << "Loading " << scenePath << "...\n";
+        Tracer tracer;
+        String err;
+        JsonSerialization::FromJSONFile(RT::String(scenePath.c_str()), tracer, err);
+        if (err.GetSize() > 0)
+            return std::string("couldn't read ") + scenePath + ": " + err.CStr();
+        tracer.PrecalcData();
+
+        Camera cam(job.CamPos, job.CamForward, job.CamUp, (float)job.Width / (float)job.Height);
+        ThreadPool pool(nThreads > 1 ? nThreads : 1);
+        std::vector<float> colors;
+        while (true)
+        {
+            uint32_t index;
+            if (!coordinator.Send(Message_Lease) || !coordinator.Receive(index) || index == NoTile)
+                break;
+            if (index >= job.GetNTiles())
+                return "the coordinator sent an invalid tile";
+
+            size_t minX, minY, width, height;
+            job.GetTile(index, minX, minY, width, height);
+            RenderBuffer buffer(width, height);
+            tracer.TracePass(cam, buffer, (size_t)job.Width, (size_t)job.Height, minX, minY, pool,
+                             (size_t)job.NBounces, job.VerticalFOVDegrees, job.Aperture, job.FocusDist,
+                             [&](size_t x, size_t y) { return (size_t)job.NSamples; },
+                             (Sampler::Types)job.SamplerType);
+
+            colors.resize(width * height * 3);
+            for (size_t y = 0; y < height; ++y)
+                for (size_t x = 0; x < width; ++x)
+                {
+                    Vector3f color = buffer.GetColor(x, y);
+                    float* outColor = colors.data() + ((x + (y * width)) * 3);
+                    outColor[0] = color.x;
+                    outColor[1] = color.y;
+                    outColor[2] = color.z;
+                }
+
+            //If the coordinator is gone, the image must already be done.
+            if (!coordinator.Send(Message_Tile) || !coordinator.Send(index) ||
+                !coordinator.Send(colors.data(), colors.size() * sizeof(float)))
+            {
+                break;
+            }
+            log << "Rendered tile " << index << "\n";
+        }
+
+        log << "The coordinator has no more work\n";
+        return "";
+    }
+}
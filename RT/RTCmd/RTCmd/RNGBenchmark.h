@@ -0,0 +1,328 @@
+#pragma once
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <cmath>
+
+#include <RT.hpp>
+
+using namespace RT;
+
+
+//Measures how fast each random number generator is, then runs statistical tests on them.
+//Every test turns its result into a z-score (how many standard deviations it is from what a perfect
+//    generator would give on average), and fails if that's too large to plausibly be bad luck.
+class RNGBenchmark
+{
+public:
+
+    //A test fails if its z-score is larger than this.
+    static constexpr double MaxZScore = 5.0;
+
+
+    RNGBenchmark(size_t nValues) : nValues(nValues < 100000 ? 100000 : nValues) { }
+
+
+    //Runs the benchmark and the tests, and prints the results.
+    //Returns whether every test passed.
+    bool Run(std::ostream& out)
+    {
+        out << "Benchmarking " << nValues << " random floats from each generator\n";
+        {
+            //The generator "FastRand" used to be, for comparison.
+            unsigned int seed = 1234567;
+            RunSpeed(out, "Old FastRand (XORshift, modulo and divide)", [&]()
+            {
+                seed = (seed ^ 61) ^ (seed >> 16);
+                seed += (seed << 3);
+                seed ^= (seed >> 4);
+                seed *= 0x27d4eb2d;
+                seed ^= (seed >> 15);
+                const unsigned int b = 9999999;
+                return (float)(seed % b) / (float)b;
+            });
+        }
+        {
+            FastRand prng;
+            RunSpeed(out, "FastRand (PCG32)", [&]() { return prng.NextFloat(); });
+        }
+        {
+            FastRand8 prng;
+            float values[FastRand8::NLanes];
+            unsigned int lane = FastRand8::NLanes;
+            RunSpeed(out, (RT_RAND_SIMD ? "FastRand8 (SSE2)" : "FastRand8 (no SIMD)"), [&]()
+            {
+                if (lane == FastRand8::NLanes)
+                {
+                    prng.NextFloats(values);
+                    lane = 0;
+                }
+                return values[lane++];
+            });
+        }
+        {
+            Sampler_Sobol sampler;
+            unsigned int sample = 0;
+            sampler.StartSample(0, 0, 0);
+            RunSpeed(out, "Sampler_Sobol", [&]()
+            {
+                if (sampler.GetDimension() >= 64)
+                    sampler.StartSample(0, 0, ++sample);
+                return sampler.NextFloat();
+            });
+        }
+
+        out << "Testing FastRand\n";
+        bool passed = true;
+        {
+            FastRand prng(5);
+            passed &= RunDistributionTests(out, [&]() { return prng.NextFloat(); });
+
+            prng = FastRand(6);
+            passed &= TestBits(out, [&]() { return prng.NextUInt(); });
+        }
+        {
+            //Noise is made by seeding a generator with a position and taking its first number,
+            //    so nearby seeds must give unrelated first numbers.
+            int x = 0, y = 0;
+            passed &= Report(out, "First numbers of neighboring seeds",
+                             ChiSquareZScore([&]()
+                             {
+                                 float f = FastRand(x, y).NextFloat();
+                                 if (++x == 1024)
+                                 {
+                                     x = 0;
+                                     y += 1;
+                                 }
+                                 return f;
+                             }));
+        }
+        {
+            //Neighboring pixels' streams must not be correlated with each other.
+            unsigned int pixel = 0, dimension = 0;
+            passed &= Report(out, "Correlation between neighboring pixel streams",
+                             CorrelationZScore([&](float& outA, float& outB)
+                             {
+                                 outA = FastRand::ForSample(pixel, 7, 3, dimension).NextFloat();
+                                 outB = FastRand::ForSample(pixel + 1, 7, 3, dimension).NextFloat();
+                                 if (++dimension == 16)
+                                 {
+                                     dimension = 0;
+                                     pixel += 1;
+                                 }
+                             }));
+            unsigned int sample = 0;
+            passed &= Report(out, "Correlation between consecutive sample streams",
+                             CorrelationZScore([&](float& outA, float& outB)
+                             {
+                                 outA = FastRand::ForSample(11, 7, sample, 0).NextFloat();
+                                 outB = FastRand::ForSample(11, 7, sample + 1, 0).NextFloat();
+                                 sample += 1;
+                             }));
+        }
+
+        out << "Testing FastRand8\n";
+        {
+            FastRand8 prng(5);
+            float values[FastRand8::NLanes];
+            unsigned int lane = FastRand8::NLanes;
+            passed &= RunDistributionTests(out, [&]()
+            {
+                if (lane == FastRand8::NLanes)
+                {
+                    prng.NextFloats(values);
+                    lane = 0;
+                }
+                return values[lane++];
+            });
+
+            //Each lane should match the scalar version of it.
+            FastRand8 prng2(6);
+            unsigned int uints[FastRand8::NLanes];
+            float floats[FastRand8::NLanes];
+            size_t nMismatches = 0;
+            for (unsigned int counter = 0; counter < 100000; ++counter)
+            {
+                prng2.Counter = counter;
+                prng2.NextUInts(uints);
+                prng2.Counter = counter;
+                prng2.NextFloats(floats);
+                for (unsigned int i = 0; i < FastRand8::NLanes; ++i)
+                {
+                    unsigned int expected = FastRand8::Get(prng2.GetKey(i), counter);
+                    if (uints[i] != expected || floats[i] != FastRand::ToFloat(expected))
+                        nMismatches += 1;
+                }
+            }
+            out << "\t" << (nMismatches == 0 ? "PASS" : "FAIL") << "  Lanes match the scalar version (" <<
+                   nMismatches << " mismatches)\n";
+            passed &= (nMismatches == 0);
+
+            //Neighboring lanes must not be correlated with each other.
+            lane = FastRand8::NLanes;
+            passed &= Report(out, "Correlation between neighboring lanes",
+                             CorrelationZScore([&](float& outA, float& outB)
+                             {
+                                 if (lane >= FastRand8::NLanes)
+                                 {
+                                     prng.NextFloats(values);
+                                     lane = 0;
+                                 }
+                                 outA = values[lane];
+                                 outB = values[lane + 1];
+                                 lane += 2;
+                             }));
+        }
+
+        out << (passed ? "All tests passed.\n" : "Some tests FAILED.\n");
+        return passed;
+    }
+
+
+private:
+
+    size_t nValues;
+
+
+    template<typename Generator>
+    void RunSpeed(std::ostream& out, const char* name, Generator generate)
+    {
+        //Sum the values so the compiler can't skip generating them.
+        double sum = 0.0;
+        auto startTime = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < nValues; ++i)
+            sum += generate();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+        out << "\t" << name << ": " <<
+               (nValues / seconds / 1000000.0) << " million floats/sec, " <<
+               (seconds * 1000000000.0 / nValues) << " ns each (mean " << (sum / nValues) << ")\n";
+    }
+
+    bool Report(std::ostream& out, const char* name, double zScore)
+    {
+        bool passed = (std::abs(zScore) <= MaxZScore);
+        out << "\t" << (passed ? "PASS" : "FAIL") << "  " << name << " (z = " << zScore << ")\n";
+        return passed;
+    }
+
+    //Runs the tests that only need a stream of floats in [0, 1).
+    template<typename Generator>
+    bool RunDistributionTests(std::ostream& out, Generator generate)
+    {
+        bool passed = true;
+
+        //Every value should be in range, and their mean and variance should be those of a uniform distribution.
+        double sum = 0.0,
+               sumSqr = 0.0;
+        size_t nOutOfRange = 0;
+        for (size_t i = 0; i < nValues; ++i)
+        {
+            double f = generate();
+            if (!(f >= 0.0 && f < 1.0))
+                nOutOfRange += 1;
+            sum += f;
+            sumSqr += f * f;
+        }
+        out << "\t" << (nOutOfRange == 0 ? "PASS" : "FAIL") << "  Values are in [0, 1) (" <<
+               nOutOfRange << " weren't)\n";
+        passed &= (nOutOfRange == 0);
+
+        double n = (double)nValues,
+               mean = sum / n,
+               variance = (sumSqr / n) - (mean * mean);
+        passed &= Report(out, "Mean", (mean - 0.5) / sqrt((1.0 / 12.0) / n));
+        //The variance of the sample variance of a uniform distribution is (1/80 - 1/144) / n.
+        passed &= Report(out, "Variance", (variance - (1.0 / 12.0)) / sqrt(((1.0 / 80.0) - (1.0 / 144.0)) / n));
+
+        passed &= Report(out, "Chi-square of 256 buckets", ChiSquareZScore(generate));
+
+        //Pairs of consecutive values should cover the unit square evenly.
+        const size_t nSide = 16;
+        std::vector<size_t> counts(nSide * nSide, 0);
+        size_t nPairs = nValues / 2;
+        for (size_t i = 0; i < nPairs; ++i)
+        {
+            size_t x = (size_t)(generate() * nSide),
+                   y = (size_t)(generate() * nSide);
+            counts[std::min(x, nSide - 1) + (std::min(y, nSide - 1) * nSide)] += 1;
+        }
+        passed &= Report(out, "Chi-square of consecutive pairs in a 16x16 grid", ChiSquareZScore(counts, nPairs));
+
+        passed &= Report(out, "Correlation between consecutive values",
+                         CorrelationZScore([&](float& outA, float& outB) { outA = generate(); outB = generate(); }));
+
+        return passed;
+    }
+
+    //Tests that every bit of the integers is a 1 half the time.
+    template<typename Generator>
+    bool TestBits(std::ostream& out, Generator generate)
+    {
+        size_t counts[32] = { 0 };
+        for (size_t i = 0; i < nValues; ++i)
+        {
+            unsigned int x = generate();
+            for (unsigned int bit = 0; bit < 32; ++bit)
+                counts[bit] += (x >> bit) & 1;
+        }
+
+        double worstZScore = 0.0;
+        for (unsigned int bit = 0; bit < 32; ++bit)
+        {
+            double zScore = ((double)counts[bit] - (nValues * 0.5)) / sqrt(nValues * 0.25);
+            if (std::abs(zScore) > std::abs(worstZScore))
+                worstZScore = zScore;
+        }
+        return Report(out, "Balance of the least balanced bit", worstZScore);
+    }
+
+    //Sorts the generated values into 256 buckets and compares how even they are to chance.
+    template<typename Generator>
+    double ChiSquareZScore(Generator generate)
+    {
+        const size_t nBuckets = 256;
+        std::vector<size_t> counts(nBuckets, 0);
+        for (size_t i = 0; i < nValues; ++i)
+            counts[std::min((size_t)(generate() * nBuckets), nBuckets - 1)] += 1;
+        return ChiSquareZScore(counts, nValues);
+    }
+    double ChiSquareZScore(const std::vector<size_t>& counts, size_t nSamples)
+    {
+        double expected = (double)nSamples / counts.size(),
+               chiSquare = 0.0;
+        for (size_t count : counts)
+            chiSquare += ((count - expected) * (count - expected)) / expected;
+
+        //With many samples, chi-square is roughly normal with a mean of "k" and a variance of "2k".
+        double degreesOfFreedom = (double)(counts.size() - 1);
+        return (chiSquare - degreesOfFreedom) / sqrt(2.0 * degreesOfFreedom);
+    }
+
+    //Gets the correlation of pairs of values, scaled by its standard deviation when they're independent.
+    template<typename PairGenerator>
+    double CorrelationZScore(PairGenerator generatePair)
+    {
+        size_t nPairs = nValues / 2;
+        double sumA = 0.0, sumB = 0.0,
+               sumAA = 0.0, sumBB = 0.0, sumAB = 0.0;
+        for (size_t i = 0; i < nPairs; ++i)
+        {
+            float a, b;
+            generatePair(a, b);
+            sumA += a;
+            sumB += b;
+            sumAA += (double)a * a;
+            sumBB += (double)b * b;
+            sumAB += (double)a * b;
+        }
+
+        double n = (double)nPairs;
+        double covariance = (sumAB / n) - ((sumA / n) * (sumB / n)),
+               varianceA = (sumAA / n) - ((sumA / n) * (sumA / n)),
+               varianceB = (sumBB / n) - ((sumB / n) * (sumB / n));
+        double correlation = covariance / sqrt(varianceA * varianceB);
+        return correlation * sqrt(n);
+    }
+};
\ No newline at end of file
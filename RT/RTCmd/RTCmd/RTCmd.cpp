@@ -11,6 +11,8 @@ Parameters (mandatory unless said otherwise):
 -cForward 1.0 1.0 1.0    The camera's forward vector. Automatically normalized by the program.
 -cUp 0.0 1.0 0.0         The camera's upward vector. Automatically normalized by the program.
 -nSamples 100            The number of rays/samples per pixel.
+                             When rendering adaptively, this is the number every pixel starts with.
+                             Not needed when rendering with a time budget.
 -nBounces 50             The maximum number of times each ray can bounce/scatter.
 -outputPath "MyImg.bmp"  The path of the output image. Must end in either .bmp or .png.
 -outputSize 800 600      The width/height of the output image.
@@ -19,6 +21,97 @@ Parameters (mandatory unless said otherwise):
 -fov 60.0                OPTIONAL (default 60.0): The vertical Field of View, in degrees.
 -aperture 0.0            OPTIONAL (default 0.0): The aperture of the camera lens.
 -focusDist 1.0           OPTIONAL (default 1.0): The focus distance of the camera.
+-bvhCache "MyCache"      OPTIONAL: An existing folder to cache built BVHs in, so unchanged geometry isn't rebuilt next time.
+-frames 1 100            OPTIONAL: Renders an animation, one scene file per frame, from the first frame to the last.
+                             The first run of '#' in the scene and output paths is replaced with the frame number,
+                                 padded with zeroes to the same length (e.x. "Scene_###.json" -> "Scene_007.json").
+                             After the first frame, shapes are updated in place and their BVHs are refit
+                                 instead of rebuilt, as long as each frame has the same objects in the same order.
+-spatialSplits 0.5       OPTIONAL: Builds mesh BVHs with spatial splits, which are much faster to trace
+                             for long, thin triangles but slower to build.
+                             The number is how many extra triangle references may be made,
+                                 as a fraction of each mesh's triangle count.
+                             Meshes that choose their own split mode aren't affected.
+-adaptive 0.01 1000      OPTIONAL: Spends more samples on the pixels that need them.
+                             After "-nSamples" samples, pixels keep getting more samples in passes
+                                 until their estimated error (relative to their brightness) is below the first number,
+                                 or they reach the second number of samples.
+-timeBudget 60.0         OPTIONAL: Renders for roughly this many seconds instead of a fixed number of samples,
+                             adding samples to every pixel in passes until there isn't time for another one.
+                             With "-frames", each frame gets this budget.
+-checkpoint "MyRender.rtc" 600.0
+                         OPTIONAL: Every this many seconds, saves the samples rendered so far to the given file,
+                             so that the render can be continued with "-resume" if it's interrupted.
+                             The file is also saved when the render finishes,
+                                 so a finished render can be resumed with a larger "-nSamples".
+                             Not used with "-adaptive" or "-timeBudget".
+                             With "-frames", the first run of '#' in the path is replaced with the frame number.
+-resume                  OPTIONAL: Continues the render from the file given by "-checkpoint",
+                             giving exactly the same image as if it had never stopped.
+                             The settings and scene file must be the same as when the checkpoint was saved.
+                             Frames with no checkpoint file are rendered from the start.
+-coordinator 5000 60.0   OPTIONAL: Instead of rendering, splits the image into tiles and hands them out
+                             to worker processes that connect on the given TCP port.
+                             A worker that hasn't returned its tile after the given number of seconds,
+                                 or that disconnects, loses it to another worker.
+                             The result is the same as rendering with "-checkpoint".
+                             Can't be used with "-frames", "-adaptive" or "-timeBudget".
+-worker localhost 5000   OPTIONAL: Renders tiles for the coordinator at the given host and port until the image is done.
+                             The scene and all the render settings come from the coordinator,
+                                 so only "-nThreads" is needed.
+                             The scene path must point to the same scene on the worker's machine.
+-server 5200 8           OPTIONAL: Instead of rendering, runs until killed as a server
+                             that renders jobs sent to the given TCP port with "-submit".
+                             Only accepts jobs from the same machine.
+                             Up to the given number of scenes are kept loaded, and reused by later jobs
+                                 as long as their files haven't changed.
+                             Only "-nThreads", "-bvhCache" and "-spatialSplits" are needed;
+                                 everything else comes from each job.
+-submit localhost 5200   OPTIONAL: Sends the render to the server at the given host and port
+                             instead of rendering it here, and waits for it to finish.
+                             The scene and output paths are used by the server as-is,
+                                 so relative paths are relative to the server's folder.
+                             Can't be used with "-frames", "-adaptive", "-timeBudget" or "-checkpoint".
+-views "MyViews.json"     OPTIONAL: Renders the scene from every camera in the given file, loading the scene only once.
+                             "-cPos", "-cForward", "-cUp" and "-outputPath" aren't needed;
+                                 the file has a "Views" list whose elements each have
+                                 a "Pos", "Forward", "Up" and "OutputPath".
+                             All the views' tiles share one thread pool,
+                                 and each image is saved as soon as it's finished.
+                             The result is the same as rendering each view with "-checkpoint".
+                             Can't be used with "-frames", "-adaptive", "-timeBudget" or "-checkpoint".
+-aovs                    OPTIONAL: Also saves the albedo, normal, depth and object index of the first surface
+                             each pixel sees, next to the output image
+                             (e.x. "MyImg.png" gets "MyImg_albedo.png", "MyImg_normal.png",
+                                 "MyImg_depth.png" and "MyImg_object.png").
+                             They're gathered during the same pass as the image itself.
+                             Only used when rendering a fixed number of samples without "-checkpoint" or "-crop".
+-denoise                 OPTIONAL: Removes noise from the image after rendering it, using the same buffers as "-aovs"
+                             to keep edges and textures sharp. Gives a clean image from far fewer samples
+                                 (e.x. 8 instead of 128), at the cost of some fine detail.
+                             Only used when rendering a fixed number of samples without "-checkpoint" or "-crop".
+-preview                 OPTIONAL: Renders a quick one-sample-per-pixel preview from coarse to fine,
+                             tracing one pixel per 8x8 block first, then 4x4, 2x2 and finally every pixel,
+                             and prints how long each pass took. "-nSamples" isn't needed.
+                             "-adaptive", "-timeBudget", "-checkpoint" and "-crop" are ignored.
+-crop 100 50 64 32       OPTIONAL: Only renders the rectangle with the given min X, min Y, width and height,
+                             keeping the camera's view of the whole "-outputSize" image,
+                             and saves just that rectangle as the output image.
+                             "-adaptive", "-timeBudget" and "-checkpoint" are ignored.
+-cropInto                OPTIONAL: With "-crop", renders the rectangle into the existing image at "-outputPath"
+                             instead, leaving the rest of it alone.
+                             The existing image must be the size given by "-outputSize".
+-sampler sobol           OPTIONAL (default sobol): How the random numbers for each pixel's samples are picked.
+                             "random" uses independent random numbers.
+                             "sobol" uses Owen-scrambled Sobol points, which converge faster.
+                             "blueNoise" uses Sobol points shifted by a blue-noise pattern per pixel,
+                                 so that the noise left at low sample counts is finer and less clumpy.
+-benchmarkBVH 1000000    OPTIONAL: Instead of rendering, casts this many random rays through the scene's geometry
+                             with each BVH layout and prints how fast they were.
+                             Only the scene is needed in this mode.
+-benchmarkRNG 10000000   OPTIONAL: Instead of rendering, generates this many random numbers with each generator,
+                             prints how fast they were, and runs statistical tests on them.
+                             Nothing else is needed in this mode.
 
 Bad or unrecognized arguments will just be ignored and the program will attempt to continue.
 
@@ -27,18 +120,153 @@ Exit codes:
 1: output file type wasn't .bmp or .png.
 2: couldn't parse scene JSON file.
 3: couldn't save output image file.
+4: a random number generator failed its statistical tests.
+5: couldn't resume from a checkpoint file.
+6: distributed rendering failed (e.x. couldn't listen on the port, or connect to the coordinator or server).
+7: couldn't load the existing image for "-cropInto".
 
 */
 
 #include <RT.hpp>
 
 #include "RTCmdIO.h"
+#include "BVHBenchmark.h"
+#include "RNGBenchmark.h"
+#include "DistributedRender.h"
+#include "RenderServer.h"
+#include "BatchRender.h"
 
 using namespace RT;
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <chrono>
 
 
+namespace
+{
+    //Replaces the first run of '#' in the given path with the given frame number.
+    std::string GetFramePath(const std::string& pattern, size_t frame)
+    {
+        size_t start = pattern.find('#');
+        if (start == std::string::npos)
+            return pattern;
+        size_t end = pattern.find_first_not_of('#', start);
+        if (end == std::string::npos)
+            end = pattern.size();
+
+        std::string frameStr = std::to_string(frame);
+        if (frameStr.size() < end - start)
+            frameStr.insert(0, (end - start) - frameStr.size(), '0');
+
+        return pattern.substr(0, start) + frameStr + pattern.substr(end);
+    }
+
+    //Hashes everything that affects the samples of a render,
+    //    so that a checkpoint can't be resumed with different settings.
+    unsigned long long GetSettingsHash(const CmdArgs& cmdArgs, const std::string& scenePath)
+    {
+        std::ifstream sceneFile(scenePath, std::ios_base::binary);
+        std::string sceneData((std::istreambuf_iterator<char>(sceneFile)), std::istreambuf_iterator<char>());
+
+        BVHCache::Hasher hasher;
+        hasher.AddBytes(sceneData.data(), sceneData.size());
+        hasher.Add(cmdArgs.CamPos.GetValue());
+        hasher.Add(cmdArgs.CamForward.GetValue());
+        hasher.Add(cmdArgs.CamUp.GetValue());
+        hasher.Add(cmdArgs.OutImgWidth.GetValue());
+        hasher.Add(cmdArgs.OutImgHeight.GetValue());
+        hasher.Add(cmdArgs.NBounces.GetValue());
+        hasher.Add(cmdArgs.VertFOVDegrees.GetValue());
+        hasher.Add(cmdArgs.Aperture.GetValue());
+        hasher.Add(cmdArgs.FocusDist.GetValue());
+        hasher.Add(Sampler::DefaultType);
+        return hasher.Value;
+    }
+
+    //Saves the given image as a BMP or PNG file, depending on the path's extension.
+    //Returns 0 if it succeeded, or else the program's exit code.
+    //Any errors are written to "log".
+    int SaveImage(const Texture2D& tex, const std::string& outputPath, std::ostream& log)
+    {
+        String err;
+        std::string extension = outputPath.substr(outputPath.size() - 3, 3);
+        if (extension == "bmp")
+        {
+            err = tex.SaveBMP(outputPath.c_str());
+        }
+        else if (extension == "png")
+        {
+            err = tex.SavePNG(outputPath.c_str());
+        }
+        else
+        {
+            log << "Unrecognized output image type " << extension << "\n";
+            return 1;
+        }
+
+        if (!err.IsEmpty())
+        {
+            log << "Error saving file: " << err.CStr() << "\n";
+            return 3;
+        }
+        return 0;
+    }
+
+    //Saves each of the given AOV buffers next to the given output image,
+    //    e.x. "MyImg.png" gets "MyImg_albedo.png", "MyImg_normal.png", "MyImg_depth.png" and "MyImg_object.png".
+    //Returns 0 if they were all saved, or else the program's exit code.
+    int SaveAOVImages(const AOVBuffers& aovs, const std::string& outputPath, std::ostream& log)
+    {
+        size_t extensionStart = outputPath.find_last_of('.');
+        std::string pathStart = outputPath.substr(0, extensionStart),
+                    extension = outputPath.substr(extensionStart);
+
+        Texture2D tex(aovs.GetWidth(), aovs.GetHeight());
+        int result;
+
+        aovs.CopyAlbedoTo(tex);
+        if ((result = SaveImage(tex, pathStart + "_albedo" + extension, log)) != 0)
+            return result;
+        aovs.CopyNormalsTo(tex);
+        if ((result = SaveImage(tex, pathStart + "_normal" + extension, log)) != 0)
+            return result;
+        aovs.CopyDepthTo(tex);
+        if ((result = SaveImage(tex, pathStart + "_depth" + extension, log)) != 0)
+            return result;
+        aovs.CopyObjectIndicesTo(tex);
+        return SaveImage(tex, pathStart + "_object" + extension, log);
+    }
+
+    //Gets the render settings to send to another RTCmd process.
+    DistributedRender::Job MakeJob(const CmdArgs& cmdArgs)
+    {
+        DistributedRender::Job job;
+        job.CamPos = cmdArgs.CamPos;
+        job.CamForward = cmdArgs.CamForward;
+        job.CamUp = cmdArgs.CamUp;
+        job.Width = cmdArgs.OutImgWidth.GetValue();
+        job.Height = cmdArgs.OutImgHeight.GetValue();
+        job.NBounces = cmdArgs.NBounces.GetValue();
+        job.NSamples = cmdArgs.NSamples.GetValue();
+        job.VerticalFOVDegrees = cmdArgs.VertFOVDegrees;
+        job.Aperture = cmdArgs.Aperture;
+        job.FocusDist = cmdArgs.FocusDist;
+        job.SamplerType = (uint32_t)Sampler::DefaultType;
+        job.ScenePathLength = 0;
+        return job;
+    }
+
+    //Reads a new frame's data into a scene that has already been loaded.
+    struct FrameReader : public IReadable
+    {
+        Tracer& Scene;
+        FrameReader(Tracer& scene) : Scene(scene) { }
+        virtual void ReadData(DataReader& reader) override { Scene.ReadDataInPlace(reader); }
+    };
+}
+
 
 int main(int argc, const char* argv[])
 {
@@ -50,58 +278,314 @@ int main(int argc, const char* argv[])
         std::cout << "Error parsing command-line arguments:\n" << errorMsg <<
                      "\nIgnoring failed arguments and trying to continue...\n";
     }
-    Camera cam(cmdArgs.CamPos, cmdArgs.CamForward, cmdArgs.CamUp,
-               (float)cmdArgs.OutImgWidth / (float)cmdArgs.OutImgHeight);
 
-    //Read the scene data from the file.
-    Tracer tracer;
-    String err;
-    //TODO: This can't parse json unless it's line-broken properly?
-    JsonSerialization::FromJSONFile(RT::String(cmdArgs.InputSceneFile.GetValue().c_str()),
-                                    tracer,
-                                    err);
-    if (err.GetSize() > 0)
+    if (cmdArgs.SpatialSplitBudget.HasValue())
     {
-        std::cout << "Error reading " << cmdArgs.InputSceneFile.GetValue() << ": " << err.CStr() << "\n";
-        char dummy;
-        std::cin >> dummy;
-        return 2;
+        Mesh::UseSpatialSplitsByDefault = true;
+        Mesh::SpatialSplitBudget = cmdArgs.SpatialSplitBudget;
     }
 
+    if (cmdArgs.SamplerType.HasValue())
+        Sampler::DefaultType = cmdArgs.SamplerType;
 
-    //Run the tracer.
+    if (cmdArgs.BenchmarkRNGValues.HasValue())
+        return (RNGBenchmark(cmdArgs.BenchmarkRNGValues).Run(std::cout) ? 0 : 4);
 
-    Texture2D tex(cmdArgs.OutImgWidth, cmdArgs.OutImgHeight);
-    tracer.PrecalcData();
+    if (cmdArgs.BenchmarkBVHRays.HasValue())
+    {
+        Tracer tracer;
+        String err;
+        JsonSerialization::FromJSONFile(RT::String(cmdArgs.InputSceneFile.GetValue().c_str()), tracer, err);
+        if (err.GetSize() > 0)
+        {
+            std::cout << "Error reading " << cmdArgs.InputSceneFile.GetValue() << ": " << err.CStr() << "\n";
+            return 2;
+        }
+
+        BVHBenchmark(tracer, cmdArgs.BenchmarkBVHRays).Run(std::cout);
+        return 0;
+    }
 
-    std::cout << "Rendering...\n";
+    if (cmdArgs.BVHCacheFolder.HasValue())
+        BVHCache::SetFolder(cmdArgs.BVHCacheFolder.GetValue().c_str());
 
-    tracer.TraceFullImage(cam, tex, cmdArgs.NThreads, cmdArgs.NBounces,
-                          cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
-                          cmdArgs.NSamples);
+    if (cmdArgs.ServerPort.HasValue())
+    {
+        std::string err;
+        if (!Socket::Initialize())
+            err = "couldn't start up networking";
+        else
+            err = RenderServer::Run((unsigned short)cmdArgs.ServerPort, cmdArgs.ServerMaxScenes,
+                                    cmdArgs.NThreads, SaveImage, std::cout);
+        std::cout << "Error: " << err << "\n";
+        return 6;
+    }
 
+    if (cmdArgs.WorkerHost.HasValue())
+    {
+        std::string err;
+        if (!Socket::Initialize())
+            err = "couldn't start up networking";
+        else
+            err = DistributedRender::RunWorker(cmdArgs.WorkerHost.GetValue(), (unsigned short)cmdArgs.WorkerPort,
+                                               cmdArgs.NThreads, std::cout);
+        if (!err.empty())
+        {
+            std::cout << "Error: " << err << "\n";
+            return 6;
+        }
+        return 0;
+    }
 
-    //Generate an image file.
-    err = "";
-    std::string extension = cmdArgs.OutputImgPath.GetValue().substr(cmdArgs.OutputImgPath.GetValue().size() - 3, 3);
-    if (extension == "bmp")
+    if (cmdArgs.ViewsFile.HasValue())
     {
-        err = tex.SaveBMP(cmdArgs.OutputImgPath.GetValue().c_str());
+        String err;
+        BatchRender::ViewList viewList;
+        JsonSerialization::FromJSONFile(RT::String(cmdArgs.ViewsFile.GetValue().c_str()), viewList, err);
+        if (err.GetSize() > 0)
+        {
+            std::cout << "Error reading " << cmdArgs.ViewsFile.GetValue() << ": " << err.CStr() << "\n";
+            return 2;
+        }
+
+        Tracer tracer;
+        JsonSerialization::FromJSONFile(RT::String(cmdArgs.InputSceneFile.GetValue().c_str()), tracer, err);
+        if (err.GetSize() > 0)
+        {
+            std::cout << "Error reading " << cmdArgs.InputSceneFile.GetValue() << ": " << err.CStr() << "\n";
+            return 2;
+        }
+        tracer.PrecalcData();
+
+        std::cout << "Rendering " << viewList.Views.size() << " views...\n";
+        ThreadPool pool(cmdArgs.NThreads.GetValue() > 1 ? cmdArgs.NThreads.GetValue() : 1);
+        int result = BatchRender::Run(tracer, viewList.Views,
+                                      cmdArgs.OutImgWidth, cmdArgs.OutImgHeight, cmdArgs.NBounces, cmdArgs.NSamples,
+                                      cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                      pool, SaveImage, std::cout);
+        if (result != 0)
+            return result;
+        std::cout << "Done!\n\n";
+        return 0;
     }
-    else if (extension == "png")
+
+    Camera cam(cmdArgs.CamPos, cmdArgs.CamForward, cmdArgs.CamUp,
+               (float)cmdArgs.OutImgWidth / (float)cmdArgs.OutImgHeight);
+
+    if (cmdArgs.SubmitHost.HasValue())
     {
-        err = tex.SavePNG(cmdArgs.OutputImgPath.GetValue().c_str());
+        uint32_t exitCode;
+        std::string message;
+        if (!Socket::Initialize() ||
+            !RenderServer::Submit(cmdArgs.SubmitHost.GetValue(), (unsigned short)cmdArgs.SubmitPort,
+                                  MakeJob(cmdArgs), cmdArgs.InputSceneFile.GetValue(),
+                                  cmdArgs.OutputImgPath.GetValue(), exitCode, message))
+        {
+            std::cout << "Error: couldn't reach the server at " << cmdArgs.SubmitHost.GetValue() <<
+                         ":" << cmdArgs.SubmitPort.GetValue() << "\n";
+            return 6;
+        }
+
+        std::cout << message << "\n";
+        return (int)exitCode;
     }
-    else
+
+    if (cmdArgs.CoordinatorPort.HasValue())
     {
-        std::cout << "Unrecognized output image type " << extension << "\n";
-        return 1;
+        DistributedRender::Job job = MakeJob(cmdArgs);
+        Texture2D tex(cmdArgs.OutImgWidth, cmdArgs.OutImgHeight);
+        std::string err;
+        if (!Socket::Initialize())
+            err = "couldn't start up networking";
+        else
+            err = DistributedRender::RunCoordinator(job, cmdArgs.InputSceneFile.GetValue(),
+                                                    (unsigned short)cmdArgs.CoordinatorPort,
+                                                    cmdArgs.LeaseSeconds, tex, std::cout);
+        if (!err.empty())
+        {
+            std::cout << "Error: " << err << "\n";
+            return 6;
+        }
+
+        int saveResult = SaveImage(tex, cmdArgs.OutputImgPath.GetValue(), std::cout);
+        if (saveResult != 0)
+            return saveResult;
+        std::cout << "Done!\n\n";
+        return 0;
     }
 
-    if (!err.IsEmpty())
+    //If no frames were given, just render the scene once.
+    bool isAnimated = cmdArgs.FirstFrame.HasValue();
+    size_t firstFrame = (isAnimated ? cmdArgs.FirstFrame.GetValue() : 0),
+           lastFrame = (isAnimated ? cmdArgs.LastFrame.GetValue() : 0);
+
+    //When only a crop is rendered, the output image is just the crop
+    //    unless it's going into the existing image.
+    bool isCropOnly = (cmdArgs.CropWidth.HasValue() && !cmdArgs.CropInto && !cmdArgs.Preview);
+
+    Tracer tracer;
+    Texture2D tex(isCropOnly ? cmdArgs.CropWidth : cmdArgs.OutImgWidth,
+                  isCropOnly ? cmdArgs.CropHeight : cmdArgs.OutImgHeight);
+    AOVBuffers aovs;
+    for (size_t frame = firstFrame; frame <= lastFrame; ++frame)
     {
-        std::cout << "Error saving file: " << err.CStr() << "\n";
-        return 3;
+        std::string scenePath = cmdArgs.InputSceneFile.GetValue(),
+                    outputPath = cmdArgs.OutputImgPath.GetValue(),
+                    checkpointPath = (cmdArgs.CheckpointPath.HasValue() ? cmdArgs.CheckpointPath.GetValue() : "");
+        if (isAnimated)
+        {
+            scenePath = GetFramePath(scenePath, frame);
+            outputPath = GetFramePath(outputPath, frame);
+            checkpointPath = GetFramePath(checkpointPath, frame);
+            std::cout << "Frame " << frame << ":\n";
+        }
+
+        //Read the scene data from the file.
+        //After the first frame, the scene's shapes are read into so they can keep their BVHs.
+        String err;
+        FrameReader frameReader(tracer);
+        //TODO: This can't parse json unless it's line-broken properly?
+        if (frame == firstFrame)
+            JsonSerialization::FromJSONFile(RT::String(scenePath.c_str()), tracer, err);
+        else
+            JsonSerialization::FromJSONFile(RT::String(scenePath.c_str()), frameReader, err);
+        if (err.GetSize() > 0)
+        {
+            std::cout << "Error reading " << scenePath << ": " << err.CStr() << "\n";
+            char dummy;
+            std::cin >> dummy;
+            return 2;
+        }
+
+
+        //Run the tracer.
+
+        if (frame == firstFrame)
+            tracer.PrecalcData();
+        else
+            tracer.UpdatePrecalcData();
+
+        std::cout << "Rendering...\n";
+
+        if (cmdArgs.Preview)
+        {
+            typedef std::chrono::steady_clock Clock;
+            Clock::time_point startTime = Clock::now();
+            tracer.TracePreviewImage(cam, tex, cmdArgs.NThreads, cmdArgs.NBounces,
+                                     cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                     [&](const Texture2D& passTex, size_t blockSize)
+                                     {
+                                         double ms = std::chrono::duration<double, std::milli>(
+                                                         Clock::now() - startTime).count();
+                                         std::cout << blockSize << "x" << blockSize << " blocks after " << ms << " ms\n";
+                                     });
+        }
+        else if (cmdArgs.CropWidth.HasValue())
+        {
+            if (cmdArgs.CropInto)
+            {
+                err = tex.Reload(outputPath.c_str());
+                if (err.IsEmpty() &&
+                    (tex.GetWidth() != cmdArgs.OutImgWidth || tex.GetHeight() != cmdArgs.OutImgHeight))
+                {
+                    err = "it isn't the size given by -outputSize";
+                }
+                if (!err.IsEmpty())
+                {
+                    std::cout << "Error loading " << outputPath << " to crop into: " << err.CStr() << "\n";
+                    return 7;
+                }
+            }
+
+            tracer.TraceCropImage(cam, tex, cmdArgs.OutImgWidth, cmdArgs.OutImgHeight,
+                                  cmdArgs.CropMinX, cmdArgs.CropMinY, cmdArgs.CropWidth, cmdArgs.CropHeight,
+                                  cmdArgs.NThreads, cmdArgs.NBounces,
+                                  cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                  cmdArgs.NSamples);
+        }
+        else if (cmdArgs.TimeBudget.HasValue())
+        {
+            size_t nSamples = tracer.TraceTimedImage(cam, tex, cmdArgs.NThreads, cmdArgs.NBounces,
+                                                     cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                                     cmdArgs.TimeBudget);
+            std::cout << "Took " << nSamples << " samples per pixel\n";
+        }
+        else if (cmdArgs.TargetError.HasValue())
+        {
+            size_t nSamples = tracer.TraceAdaptiveImage(cam, tex, cmdArgs.NThreads, cmdArgs.NBounces,
+                                                        cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                                        cmdArgs.NSamples, cmdArgs.MaxSamples, cmdArgs.TargetError);
+            std::cout << "Took an average of " << ((double)nSamples / (tex.GetWidth() * tex.GetHeight())) <<
+                         " samples per pixel\n";
+        }
+        else if (cmdArgs.CheckpointPath.HasValue())
+        {
+            unsigned long long settingsHash = GetSettingsHash(cmdArgs, scenePath);
+            RenderBuffer buffer(tex.GetWidth(), tex.GetHeight());
+            if (cmdArgs.Resume)
+            {
+                if (!std::ifstream(checkpointPath).is_open())
+                {
+                    std::cout << "No checkpoint at " << checkpointPath << "; starting from the beginning\n";
+                }
+                else
+                {
+                    err = buffer.LoadCheckpoint(checkpointPath.c_str(), settingsHash);
+                    if (!err.IsEmpty())
+                    {
+                        std::cout << "Error resuming from checkpoint: " << err.CStr() << "\n";
+                        return 5;
+                    }
+                    std::cout << "Resuming with " <<
+                                 ((double)buffer.GetTotalSamples() / (tex.GetWidth() * tex.GetHeight())) <<
+                                 " samples per pixel\n";
+                }
+            }
+
+            tracer.TraceCheckpointedImage(cam, buffer, cmdArgs.NThreads, cmdArgs.NBounces,
+                                          cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                          cmdArgs.NSamples, cmdArgs.CheckpointInterval,
+                                          [&](const RenderBuffer& checkpoint)
+                                          {
+                                              String saveErr = checkpoint.SaveCheckpoint(checkpointPath.c_str(),
+                                                                                         settingsHash);
+                                              if (!saveErr.IsEmpty())
+                                                  std::cout << "Error saving checkpoint: " << saveErr.CStr() << "\n";
+                                          });
+            buffer.CopyTo(tex);
+        }
+        else
+        {
+            bool needsAOVs = (cmdArgs.SaveAOVs || cmdArgs.Denoise);
+            if (needsAOVs)
+                aovs.Resize(tex.GetWidth(), tex.GetHeight());
+            tracer.TraceFullImage(cam, tex, cmdArgs.NThreads, cmdArgs.NBounces,
+                                  cmdArgs.VertFOVDegrees, cmdArgs.Aperture, cmdArgs.FocusDist,
+                                  cmdArgs.NSamples, Sampler::DefaultType,
+                                  (needsAOVs ? &aovs : nullptr));
+
+            if (cmdArgs.Denoise)
+            {
+                typedef std::chrono::steady_clock Clock;
+                Clock::time_point startTime = Clock::now();
+                ThreadPool pool(cmdArgs.NThreads.GetValue() > 1 ? cmdArgs.NThreads.GetValue() : 1);
+                Denoiser().Denoise(tex, aovs, tex, pool);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - startTime).count();
+                std::cout << "Denoised in " << ms << " ms\n";
+            }
+        }
+
+
+        //Generate an image file.
+        int saveResult = SaveImage(tex, outputPath, std::cout);
+        if (saveResult != 0)
+            return saveResult;
+        if (cmdArgs.SaveAOVs && aovs.GetWidth() > 0)
+        {
+            saveResult = SaveAOVImages(aovs, outputPath, std::cout);
+            if (saveResult != 0)
+                return saveResult;
+        }
     }
 
     std::cout << "Done!\n\n";
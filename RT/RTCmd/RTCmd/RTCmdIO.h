@@ -4,6 +4,7 @@
 #include <fstream>
 
 #include <Camera.h>
+#include <Sampler.h>
 
 using namespace RT;
 
@@ -40,10 +41,22 @@ struct CmdArgs
 {
 public:
     OptionalValue<size_t> NThreads, NBounces, NSamples,
-                            OutImgWidth, OutImgHeight;
+                            OutImgWidth, OutImgHeight,
+                            FirstFrame, LastFrame,
+                            MaxSamples,
+                            BenchmarkBVHRays, BenchmarkRNGValues,
+                            CoordinatorPort, WorkerPort,
+                            ServerPort, ServerMaxScenes, SubmitPort,
+                            CropMinX, CropMinY, CropWidth, CropHeight;
     OptionalValue<Vector3f> CamPos, CamForward, CamUp;
-    OptionalValue<float> VertFOVDegrees, Aperture, FocusDist;
-    OptionalValue<std::string> InputSceneFile, OutputImgPath;
+    OptionalValue<float> VertFOVDegrees, Aperture, FocusDist,
+                         SpatialSplitBudget, TargetError, TimeBudget,
+                         CheckpointInterval, LeaseSeconds;
+    OptionalValue<std::string> InputSceneFile, OutputImgPath, BVHCacheFolder,
+                               CheckpointPath, WorkerHost, SubmitHost,
+                               ViewsFile;
+    OptionalValue<Sampler::Types> SamplerType;
+    bool Resume = false, CropInto = false, Preview = false, SaveAOVs = false, Denoise = false;
 
 
     CmdArgs() { }
@@ -224,6 +237,273 @@ public:
                     i += 1;
                 }
             }
+            else if (arg == "-bvhCache")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -bvhCache";
+                    i = nArgs;
+                }
+                else
+                {
+                    BVHCacheFolder = std::string(args[i + 1]);
+                    i += 1;
+                }
+            }
+            else if (arg == "-frames")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -frames";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], FirstFrame, outErrorMsg);
+                    TryParse(args[i + 2], LastFrame, outErrorMsg);
+                    if (!FirstFrame.HasValue() || !LastFrame.HasValue())
+                    {
+                        FirstFrame.RemoveValue();
+                        LastFrame.RemoveValue();
+                    }
+                    i += 2;
+                }
+            }
+            else if (arg == "-adaptive")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -adaptive";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], TargetError, outErrorMsg);
+                    TryParse(args[i + 2], MaxSamples, outErrorMsg);
+                    if (!TargetError.HasValue() || !MaxSamples.HasValue())
+                    {
+                        TargetError.RemoveValue();
+                        MaxSamples.RemoveValue();
+                    }
+                    i += 2;
+                }
+            }
+            else if (arg == "-timeBudget")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -timeBudget";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], TimeBudget, outErrorMsg);
+                    i += 1;
+                }
+            }
+            else if (arg == "-checkpoint")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -checkpoint";
+                    i = nArgs;
+                }
+                else
+                {
+                    CheckpointPath = std::string(args[i + 1]);
+                    TryParse(args[i + 2], CheckpointInterval, outErrorMsg);
+                    if (!CheckpointInterval.HasValue())
+                        CheckpointPath.RemoveValue();
+                    i += 2;
+                }
+            }
+            else if (arg == "-resume")
+            {
+                Resume = true;
+            }
+            else if (arg == "-coordinator")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -coordinator";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], CoordinatorPort, outErrorMsg);
+                    TryParse(args[i + 2], LeaseSeconds, outErrorMsg);
+                    if (!CoordinatorPort.HasValue() || !LeaseSeconds.HasValue())
+                    {
+                        CoordinatorPort.RemoveValue();
+                        LeaseSeconds.RemoveValue();
+                    }
+                    i += 2;
+                }
+            }
+            else if (arg == "-worker")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -worker";
+                    i = nArgs;
+                }
+                else
+                {
+                    WorkerHost = std::string(args[i + 1]);
+                    TryParse(args[i + 2], WorkerPort, outErrorMsg);
+                    if (!WorkerPort.HasValue())
+                        WorkerHost.RemoveValue();
+                    i += 2;
+                }
+            }
+            else if (arg == "-server")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -server";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], ServerPort, outErrorMsg);
+                    TryParse(args[i + 2], ServerMaxScenes, outErrorMsg);
+                    if (!ServerPort.HasValue() || !ServerMaxScenes.HasValue())
+                    {
+                        ServerPort.RemoveValue();
+                        ServerMaxScenes.RemoveValue();
+                    }
+                    i += 2;
+                }
+            }
+            else if (arg == "-submit")
+            {
+                if (i > nArgs - 3)
+                {
+                    outErrorMsg += "\nNot enough arguments after -submit";
+                    i = nArgs;
+                }
+                else
+                {
+                    SubmitHost = std::string(args[i + 1]);
+                    TryParse(args[i + 2], SubmitPort, outErrorMsg);
+                    if (!SubmitPort.HasValue())
+                        SubmitHost.RemoveValue();
+                    i += 2;
+                }
+            }
+            else if (arg == "-views")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -views";
+                    i = nArgs;
+                }
+                else
+                {
+                    ViewsFile = std::string(args[i + 1]);
+                    i += 1;
+                }
+            }
+            else if (arg == "-crop")
+            {
+                if (i > nArgs - 5)
+                {
+                    outErrorMsg += "\nNot enough arguments after -crop";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], CropMinX, outErrorMsg);
+                    TryParse(args[i + 2], CropMinY, outErrorMsg);
+                    TryParse(args[i + 3], CropWidth, outErrorMsg);
+                    TryParse(args[i + 4], CropHeight, outErrorMsg);
+                    if (!CropMinX.HasValue() || !CropMinY.HasValue() ||
+                        !CropWidth.HasValue() || !CropHeight.HasValue())
+                    {
+                        CropMinX.RemoveValue();
+                        CropMinY.RemoveValue();
+                        CropWidth.RemoveValue();
+                        CropHeight.RemoveValue();
+                    }
+                    i += 4;
+                }
+            }
+            else if (arg == "-cropInto")
+            {
+                CropInto = true;
+            }
+            else if (arg == "-aovs")
+            {
+                SaveAOVs = true;
+            }
+            else if (arg == "-denoise")
+            {
+                Denoise = true;
+            }
+            else if (arg == "-preview")
+            {
+                Preview = true;
+            }
+            else if (arg == "-spatialSplits")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -spatialSplits";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], SpatialSplitBudget, outErrorMsg);
+                    i += 1;
+                }
+            }
+            else if (arg == "-sampler")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -sampler";
+                    i = nArgs;
+                }
+                else
+                {
+                    std::string name = args[i + 1];
+                    if (name == "random")
+                        SamplerType = Sampler::Random;
+                    else if (name == "sobol")
+                        SamplerType = Sampler::Sobol;
+                    else if (name == "blueNoise")
+                        SamplerType = Sampler::BlueNoiseSobol;
+                    else
+                        outErrorMsg += "\nUnknown sampler \"" + name + "\"";
+                    i += 1;
+                }
+            }
+            else if (arg == "-benchmarkBVH")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -benchmarkBVH";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], BenchmarkBVHRays, outErrorMsg);
+                    i += 1;
+                }
+            }
+            else if (arg == "-benchmarkRNG")
+            {
+                if (i > nArgs - 2)
+                {
+                    outErrorMsg += "\nNot enough arguments after -benchmarkRNG";
+                    i = nArgs;
+                }
+                else
+                {
+                    TryParse(args[i + 1], BenchmarkRNGValues, outErrorMsg);
+                    i += 1;
+                }
+            }
             else if (arg == "-nThreads")
             {
                 if (i > nArgs - 2)
@@ -243,6 +523,17 @@ public:
             }
         }
 
+        if (Resume && !CheckpointPath.HasValue())
+        {
+            outErrorMsg += "\n-resume needs a checkpoint file from -checkpoint";
+            Resume = false;
+        }
+        if (CropInto && !CropWidth.HasValue())
+        {
+            outErrorMsg += "\n-cropInto needs a rectangle from -crop";
+            CropInto = false;
+        }
+
         #pragma endregion
 
         #pragma region Ask the user for any missing options
@@ -253,6 +544,25 @@ public:
         auto isValidFile = [](const std::string& s) { return std::ifstream(s).is_open(); };
         auto isValidName = [](const std::string& s) { return !s.empty() && s.find('.') != std::string::npos; };
         auto alwaysValid = [](const std::string& s) { return true; };
+
+        //Benchmarking the random number generators doesn't need anything else.
+        if (BenchmarkRNGValues.HasValue())
+            return;
+        //Benchmarking BVHs only needs a scene.
+        if (BenchmarkBVHRays.HasValue())
+        {
+            if (!InputSceneFile.HasValue())
+                InputSceneFile = KeepTryingForValue("\nEnter the input scene file path: >", isValidFile);
+            return;
+        }
+        //Workers get everything else from the coordinator, and servers get it from each job.
+        if (WorkerHost.HasValue() || ServerPort.HasValue())
+        {
+            if (!NThreads.HasValue())
+                NThreads = 4;
+            return;
+        }
+
         if (!NThreads.HasValue())
             if (isInteractive)
                 TryParse(KeepTryingForValue("\nEnter the number of threads to use (Default 4): >", isValidUInt).c_str(),
@@ -262,7 +572,8 @@ public:
         if (!NBounces.HasValue())
             TryParse(KeepTryingForValue("\nEnter the number of bounces for each ray: >", isValidUInt).c_str(),
                         NBounces, outErrorMsg);
-        if (!NSamples.HasValue())
+        //A time budget decides the number of samples by itself, and a preview only takes one.
+        if (!NSamples.HasValue() && !TimeBudget.HasValue() && !Preview)
             TryParse(KeepTryingForValue("\nEnter the number of samples per pixel: >", isValidUInt).c_str(),
                         NSamples, outErrorMsg);
         if (!OutImgWidth.HasValue())
@@ -271,7 +582,20 @@ public:
         if (!OutImgHeight.HasValue())
             TryParse(KeepTryingForValue("\nEnter the height of the output image: >", isValidUInt).c_str(),
                         OutImgHeight, outErrorMsg);
-        if (!CamPos.HasValue())
+        if (CropWidth.HasValue() && OutImgWidth.HasValue() && OutImgHeight.HasValue() &&
+            (CropWidth.GetValue() == 0 || CropHeight.GetValue() == 0 ||
+             CropMinX.GetValue() + CropWidth.GetValue() > OutImgWidth.GetValue() ||
+             CropMinY.GetValue() + CropHeight.GetValue() > OutImgHeight.GetValue()))
+        {
+            outErrorMsg += "\nThe -crop rectangle must be non-empty and fit inside the image";
+            CropMinX.RemoveValue();
+            CropMinY.RemoveValue();
+            CropWidth.RemoveValue();
+            CropHeight.RemoveValue();
+            CropInto = false;
+        }
+        //A views file has its own cameras and output paths.
+        if (!CamPos.HasValue() && !ViewsFile.HasValue())
         {
             OptionalValue<float> x, y, z;
             TryParse(KeepTryingForValue("\nEnter the camera's X pos: >", isValidFloat).c_str(), x, outErrorMsg);
@@ -279,7 +603,7 @@ public:
             TryParse(KeepTryingForValue("\nEnter the camera's Z pos: >", isValidFloat).c_str(), z, outErrorMsg);
             CamPos.MakeValue(Vector3f(x.GetValue(), y.GetValue(), z.GetValue()));
         }
-        if (!CamForward.HasValue())
+        if (!CamForward.HasValue() && !ViewsFile.HasValue())
         {
             OptionalValue<float> x, y, z;
             TryParse(KeepTryingForValue("\nEnter the camera's forward vector X: >", isValidFloat).c_str(), x, outErrorMsg);
@@ -287,7 +611,7 @@ public:
             TryParse(KeepTryingForValue("\nEnter the camera's forward vector Z: >", isValidFloat).c_str(), z, outErrorMsg);
             CamForward.MakeValue(Vector3f(x.GetValue(), y.GetValue(), z.GetValue()).Normalize());
         }
-        if (!CamUp.HasValue())
+        if (!CamUp.HasValue() && !ViewsFile.HasValue())
         {
             OptionalValue<float> x, y, z;
             TryParse(KeepTryingForValue("\nEnter the camera's upwards vector X: >", isValidFloat).c_str(), x, outErrorMsg);
@@ -311,8 +635,11 @@ public:
             else
                 Aperture = 0.0f;
         if (!InputSceneFile.HasValue())
-            InputSceneFile = KeepTryingForValue("\nEnter the input scene file path: >", isValidFile);
-        if (!OutputImgPath.HasValue())
+            if (FirstFrame.HasValue())
+                InputSceneFile = KeepTryingForValue("\nEnter the input scene file path pattern: >", alwaysValid);
+            else
+                InputSceneFile = KeepTryingForValue("\nEnter the input scene file path: >", isValidFile);
+        if (!OutputImgPath.HasValue() && !ViewsFile.HasValue())
             OutputImgPath = KeepTryingForValue("\nEnter the output image file's path: >", isValidName);
 
         #pragma endregion
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <RT.hpp>
+
+#include "Socket.h"
+#include "DistributedRender.h"
+
+using namespace RT;
+
+
+//A long-running RTCmd process that renders jobs sent to it over a socket,
+//    keeping the most recently used scenes loaded so that repeated jobs on them start right away.
+//Each connection sends one job and gets back one response, and jobs are rendered one at a time.
+//Paths are used as-is by the server, so relative paths are relative to the server's folder.
+//Since any client can make the server read and write files, it only accepts connections from the same machine.
+namespace RenderServer
+{
+    //Identifies the protocol, and must be changed whenever it changes.
+    static const char Magic[8] = { 'R', 'T', 'S', 'R', 'V', '0', '0', '1' };
+    //Jobs with paths longer than this are rejected, so a bad client can't make the server allocate a huge string.
+    static const uint64_t MaxPathLength = 1 << 16;
+    //A client that goes this long without sending or receiving anything is dropped,
+    //    so one that connects and then stalls doesn't hold up every other job.
+    static const unsigned int ClientTimeoutMS = 10000;
+    //Jobs with images bigger than this are rejected, instead of running the server out of memory.
+    static const uint64_t MaxImagePixels = (uint64_t)1 << 26;
+
+    //A job is sent as "Magic", then a "DistributedRender::Job" followed by the scene path,
+    //    then the length of the output path followed by the output path.
+    //The response is one of these, followed by a message for the user.
+    struct Response
+    {
+        //The exit code RTCmd would have given if it rendered the job itself.
+        uint32_t ExitCode;
+        uint64_t MessageLength;
+    };
+
+
+    //The most recently used scenes, fully loaded and precalculated.
+    //A scene is reloaded if its file has been modified since it was loaded.
+    class SceneCache
+    {
+    public:
+
+        SceneCache(size_t maxScenes) : maxScenes(maxScenes < 1 ? 1 : maxScenes) { }
+
+        //Gets the scene from the given file, loading it if it isn't already.
+        //Returns null and outputs an error message if the scene couldn't be loaded.
+        Tracer* Get(const std::string& path, bool& outWasLoaded, std::string& outError)
+        {
+            struct stat fileInfo;
+            if (stat(path.c_str(), &fileInfo) != 0)
+            {
+                outError = "couldn't find " + path;
+                return nullptr;
+            }
+
+            //Move the scene to the front of the list when it's used, so the back is always the oldest.
+            for (auto it = entries.begin(); it != entries.end(); ++it)
+            {
+                if (it->Path == path)
+                {
+                    if (it->ModifiedTime == (long long)fileInfo.st_mtime && it->FileSize == (long long)fileInfo.st_size)
+                    {
+                        entries.splice(entries.begin(), entries, it);
+                        outWasLoaded = true;
+                        return entries.front().Scene.get();
+                    }
+
+                    entries.erase(it);
+                    break;
+                }
+            }
+
+            std::unique_ptr<Tracer> scene(new Tracer());
+            String err;
+            JsonSerialization::FromJSONFile(RT::String(path.c_str()), *scene, err);
+            if (err.GetSize() > 0)
+            {
+                outError = std::string("couldn't read ") + path + ": " + err.CStr();
+                return nullptr;
+            }
+            scene->PrecalcData();
+
+            if (entries.size() >= maxScenes)
+                entries.pop_back();
+            Entry entry;
+            entry.Path = path;
+            entry.ModifiedTime = (long long)fileInfo.st_mtime;
+            entry.FileSize = (long long)fileInfo.st_size;
+            entry.Scene = std::move(scene);
+            entries.push_front(std::move(entry));
+
+            outWasLoaded = false;
+            return entries.front().Scene.get();
+        }
+
+
+    private:
+
+        struct Entry
+        {
+            std::string Path;
+            long long ModifiedTime, FileSize;
+            std::unique_ptr<Tracer> Scene;
+        };
+
+        size_t maxScenes;
+        std::list<Entry> entries;
+    };
+
+
+    //Returns an error message if the given job's settings can't be rendered, or an empty string if they can.
+    inline std::string ValidateJob(const DistributedRender::Job& job)
+    {
+        if (job.Width < 1 || job.Height < 1 || job.Width > MaxImagePixels / job.Height)
+            return "the image size " + std::to_string(job.Width) + "x" + std::to_string(job.Height) + " isn't allowed";
+        if (job.NSamples < 1)
+            return "there must be at least one sample per pixel";
+        if (job.SamplerType > (uint32_t)Sampler::BlueNoiseSobol)
+            return "unknown sampler type " + std::to_string(job.SamplerType);
+        return "";
+    }
+
+    //Renders a job with the given scene, and saves the image.
+    //"saveImage(tex, path, log)" saves the image, writes any errors to "log", and returns RTCmd's exit code.
+    //Returns the exit code and outputs a message for the user.
+    template<typename SaveImageFunc>
+    uint32_t RenderJob(const DistributedRender::Job& job, const Tracer& scene, const std::string& outputPath,
+                       ThreadPool& pool, SaveImageFunc saveImage, std::string& outMessage)
+    {
+        Camera cam(job.CamPos, job.CamForward, job.CamUp, (float)job.Width / (float)job.Height);
+        RenderBuffer buffer((size_t)job.Width, (size_t)job.Height);
+        scene.TracePass(cam, buffer, pool,
+                        (size_t)job.NBounces, job.VerticalFOVDegrees, job.Aperture, job.FocusDist,
+                        [&](size_t x, size_t y) { return (size_t)job.NSamples; },
+                        (Sampler::Types)job.SamplerType);
+
+        Texture2D tex((size_t)job.Width, (size_t)job.Height);
+        buffer.CopyTo(tex);
+
+        std::ostringstream errorLog;
+        uint32_t exitCode = (uint32_t)saveImage(tex, outputPath, errorLog);
+        outMessage = (exitCode == 0 ? "Rendered " + outputPath : errorLog.str());
+        while (!outMessage.empty() && outMessage.back() == '\n')
+            outMessage.pop_back();
+        return exitCode;
+    }
+
+    //Sends a job's response back to the client that sent it.
+    inline void SendResponse(Socket& client, uint32_t exitCode, const std::string& message)
+    {
+        Response response;
+        response.ExitCode = exitCode;
+        response.MessageLength = message.size();
+        if (client.Send(response))
+            client.Send(message.data(), message.size());
+    }
+
+    //Renders jobs from clients connecting on the given port, forever.
+    //Returns an error message if the server couldn't start.
+    template<typename SaveImageFunc>
+    std::string Run(unsigned short port, size_t maxScenes, size_t nThreads,
+                    SaveImageFunc saveImage, std::ostream& log)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        Socket listener = Socket::Listen(port, INADDR_LOOPBACK);
+        if (!listener.IsValid())
+            return "couldn't listen on port " + std::to_string(port);
+
+        SceneCache scenes(maxScenes);
+        ThreadPool pool(nThreads > 1 ? nThreads : 1);
+
+        log << "Listening for jobs on port " << port << "...\n";
+        while (true)
+        {
+            Socket client = listener.Accept();
+            if (!client.IsValid() || !client.SetTimeout(ClientTimeoutMS))
+                continue;
+
+            //Read the job.
+            char magic[sizeof(Magic)];
+            DistributedRender::Job job;
+            uint64_t outputPathLength;
+            if (!client.Receive(magic, sizeof(magic)) || memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+                !client.Receive(job))
+            {
+                log << "Ignored a client using a different version of RTCmd\n";
+                continue;
+            }
+            //A path that's too long can't be skipped safely, since the rest of the job comes after it,
+            //    so the connection is dropped.
+            const std::string pathTooLong = "Error: paths can't be longer than " + std::to_string(MaxPathLength) +
+                                            " characters";
+            if (job.ScenePathLength > MaxPathLength)
+            {
+                log << pathTooLong << "\n";
+                SendResponse(client, 6, pathTooLong);
+                continue;
+            }
+            std::string scenePath((size_t)job.ScenePathLength, ' ');
+            if (!client.Receive(&scenePath[0], scenePath.size()) || !client.Receive(outputPathLength))
+                continue;
+            if (outputPathLength > MaxPathLength)
+            {
+                log << pathTooLong << "\n";
+                SendResponse(client, 6, pathTooLong);
+                continue;
+            }
+            std::string outputPath((size_t)outputPathLength, ' ');
+            if (!client.Receive(&outputPath[0], outputPath.size()))
+                continue;
+
+            //Run it.
+            Clock::time_point startTime = Clock::now();
+            std::string message, err;
+            bool wasLoaded = false;
+            uint32_t exitCode;
+            double loadSeconds = 0.0;
+            err = ValidateJob(job);
+            if (!err.empty())
+            {
+                exitCode = 6;
+                message = "Error: " + err;
+            }
+            else
+            {
+                //A job that fails in an unexpected way (e.x. running out of memory)
+                //    shouldn't take the whole server down with it.
+                try
+                {
+                    Tracer* scene = scenes.Get(scenePath, wasLoaded, err);
+                    loadSeconds = std::chrono::duration<double>(Clock::now() - startTime).count();
+                    if (scene == nullptr)
+                    {
+                        exitCode = 2;
+                        message = "Error: " + err;
+                    }
+                    else
+                    {
+                        exitCode = RenderJob(job, *scene, outputPath, pool, saveImage, message);
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    exitCode = 6;
+                    message = std::string("Error: the job failed: ") + e.what();
+                }
+            }
+            if (exitCode == 0)
+            {
+                std::ostringstream timing;
+                timing << " in " << std::chrono::duration<double>(Clock::now() - startTime).count() << " seconds";
+                if (wasLoaded)
+                    timing << " (the scene was already loaded)";
+                else
+                    timing << " (" << loadSeconds << " of them loading the scene)";
+                message += timing.str();
+            }
+            log << message << "\n";
+            SendResponse(client, exitCode, message);
+        }
+    }
+
+    //Sends a job to the server at the given address and waits for it to finish.
+    //Returns false if the server couldn't be reached;
+    //    otherwise outputs the exit code and message that the server gave.
+    inline bool Submit(const std::string& host, unsigned short port, const DistributedRender::Job& job,
+                       const std::string& scenePath, const std::string& outputPath,
+                       uint32_t& outExitCode, std::string& outMessage)
+    {
+        Socket server = Socket::Connect(host, port);
+        if (!server.IsValid())
+            return false;
+
+        DistributedRender::Job header = job;
+        header.ScenePathLength = scenePath.size();
+        uint64_t outputPathLength = outputPath.size();
+        Response response;
+        if (!server.Send(Magic, sizeof(Magic)) || !server.Send(header) ||
+            !server.Send(scenePath.data(), scenePath.size()) ||
+            !server.Send(outputPathLength) || !server.Send(outputPath.data(), outputPath.size()) ||
+            !server.Receive(response))
+        {
+            return false;
+        }
+
+        outExitCode = response.ExitCode;
+        outMessage.resize((size_t)response.MessageLength);
+        return outMessage.empty() || server.Receive(&outMessage[0], outMessage.size());
+    }
+}
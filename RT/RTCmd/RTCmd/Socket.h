@@ -0,0 +1,250 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+    #pragma comment(lib, "Ws2_32.lib")
+#else
+    #include <sys/types.h>
+    #include <sys/socket.h>
+    #include <sys/select.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
+    #include <netdb.h>
+    #include <unistd.h>
+    #include <signal.h>
+#endif
+
+
+//A blocking TCP socket, with just enough features for RTCmd's distributed rendering.
+//Closes itself when destroyed; can be moved but not copied.
+class Socket
+{
+public:
+
+#ifdef _WIN32
+    typedef SOCKET Handle;
+    static const Handle InvalidHandle = INVALID_SOCKET;
+#else
+    typedef int Handle;
+    static const Handle InvalidHandle = -1;
+#endif
+
+
+    //Must be called before using any sockets.
+    //Returns whether it succeeded.
+    static bool Initialize()
+    {
+#ifdef _WIN32
+        WSADATA data;
+        return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+#else
+        //Writing to a socket whose other end closed should be an error, not kill the process.
+        signal(SIGPIPE, SIG_IGN);
+        return true;
+#endif
+    }
+
+    //Starts listening for connections on the given port of the given IPv4 address (in host byte order).
+    //By default, listens on every network interface;
+    //    pass "INADDR_LOOPBACK" to only accept connections from this machine.
+    //Returns an invalid socket if it failed.
+    static Socket Listen(unsigned short port, unsigned long address = INADDR_ANY)
+    {
+        Socket s(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+        if (!s.IsValid())
+            return s;
+
+        int reuse = 1;
+        setsockopt(s.handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+        sockaddr_in socketAddress;
+        memset(&socketAddress, 0, sizeof(socketAddress));
+        socketAddress.sin_family = AF_INET;
+        socketAddress.sin_addr.s_addr = htonl((uint32_t)address);
+        socketAddress.sin_port = htons(port);
+        if (bind(s.handle, (const sockaddr*)&socketAddress, sizeof(socketAddress)) != 0 ||
+            listen(s.handle, SOMAXCONN) != 0)
+        {
+            s.Close();
+        }
+        return s;
+    }
+    //Connects to the given host and port.
+    //Returns an invalid socket if it failed.
+    static Socket Connect(const std::string& host, unsigned short port)
+    {
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0)
+            return Socket();
+
+        Socket s;
+        for (addrinfo* a = addresses; a != nullptr && !s.IsValid(); a = a->ai_next)
+        {
+            s = Socket(socket(a->ai_family, a->ai_socktype, a->ai_protocol));
+            if (s.IsValid() && connect(s.handle, a->ai_addr, (int)a->ai_addrlen) != 0)
+                s.Close();
+        }
+        freeaddrinfo(addresses);
+
+        if (s.IsValid())
+            s.DisableNagle();
+        return s;
+    }
+
+    //Waits up to the given number of milliseconds for any of the given sockets to have data to read
+    //    (or, for listening sockets, a connection to accept).
+    //Outputs whether each one is ready. Returns false if nothing is ready.
+    static bool WaitForAny(const std::vector<const Socket*>& sockets, unsigned int timeoutMS,
+                           std::vector<bool>& outIsReady)
+    {
+        fd_set readable;
+        FD_ZERO(&readable);
+        Handle maxHandle = 0;
+        for (const Socket* s : sockets)
+        {
+            FD_SET(s->handle, &readable);
+            if (s->handle > maxHandle)
+                maxHandle = s->handle;
+        }
+
+        timeval timeout;
+        timeout.tv_sec = (long)(timeoutMS / 1000);
+        timeout.tv_usec = (long)((timeoutMS % 1000) * 1000);
+        int nReady = select((int)maxHandle + 1, &readable, nullptr, nullptr, &timeout);
+
+        outIsReady.resize(sockets.size());
+        for (size_t i = 0; i < sockets.size(); ++i)
+            outIsReady[i] = (nReady > 0 && FD_ISSET(sockets[i]->handle, &readable));
+        return nReady > 0;
+    }
+
+
+    Socket() : handle(InvalidHandle) { }
+    ~Socket() { Close(); }
+
+    Socket(Socket&& other) : handle(other.handle) { other.handle = InvalidHandle; }
+    Socket& operator=(Socket&& other)
+    {
+        if (this != &other)
+        {
+            Close();
+            handle = other.handle;
+            other.handle = InvalidHandle;
+        }
+        return *this;
+    }
+
+    Socket(const Socket& cpy) = delete;
+    Socket& operator=(const Socket& cpy) = delete;
+
+
+    bool IsValid() const { return handle != InvalidHandle; }
+
+    void Close()
+    {
+        if (!IsValid())
+            return;
+#ifdef _WIN32
+        closesocket(handle);
+#else
+        close(handle);
+#endif
+        handle = InvalidHandle;
+    }
+
+    //Accepts a connection on this listening socket. Blocks until there is one.
+    Socket Accept()
+    {
+        Socket s(accept(handle, nullptr, nullptr));
+        if (s.IsValid())
+            s.DisableNagle();
+        return s;
+    }
+
+    //Makes sending and receiving fail if they're stuck for more than the given number of milliseconds,
+    //    instead of blocking forever. Returns whether it succeeded.
+    bool SetTimeout(unsigned int timeoutMS)
+    {
+#ifdef _WIN32
+        DWORD timeout = (DWORD)timeoutMS;
+#else
+        timeval timeout;
+        timeout.tv_sec = (long)(timeoutMS / 1000);
+        timeout.tv_usec = (long)((timeoutMS % 1000) * 1000);
+#endif
+        return setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout)) == 0 &&
+               setsockopt(handle, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout)) == 0;
+    }
+
+    //Sends all of the given bytes. Returns whether it succeeded.
+    bool Send(const void* data, size_t nBytes)
+    {
+        const char* bytes = (const char*)data;
+        while (nBytes > 0)
+        {
+            int nSent = send(handle, bytes, (int)std::min(nBytes, (size_t)(1 << 20)), 0);
+            if (nSent <= 0)
+                return false;
+            bytes += nSent;
+            nBytes -= (size_t)nSent;
+        }
+        return true;
+    }
+    template<typename T>
+    bool Send(const T& value) { return Send(&value, sizeof(T)); }
+
+    //Receives exactly the given number of bytes, blocking until they all arrive.
+    //Returns false if the connection closed or failed first.
+    bool Receive(void* outData, size_t nBytes)
+    {
+        char* bytes = (char*)outData;
+        while (nBytes > 0)
+        {
+            int nReceived = ReceiveSome(bytes, nBytes);
+            if (nReceived <= 0)
+                return false;
+            bytes += nReceived;
+            nBytes -= (size_t)nReceived;
+        }
+        return true;
+    }
+    template<typename T>
+    bool Receive(T& outValue) { return Receive(&outValue, sizeof(T)); }
+
+    //Receives whatever bytes have arrived, up to the given amount, blocking until there's at least one.
+    //Returns the number received, or 0 or less if the connection closed or failed.
+    int ReceiveSome(void* outData, size_t maxBytes)
+    {
+        return recv(handle, (char*)outData, (int)std::min(maxBytes, (size_t)(1 << 20)), 0);
+    }
+
+
+private:
+
+    Handle handle;
+
+    explicit Socket(Handle handle) : handle(handle) { }
+
+    //Sends small messages right away instead of waiting to batch them up.
+    void DisableNagle()
+    {
+        int noDelay = 1;
+        setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    }
+};
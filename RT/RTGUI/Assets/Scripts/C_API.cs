@@ -21,11 +21,119 @@ public static class C_API
 										   float vertFOVDegrees, float aperture, float focusDist,
 										   Vector3 camPos, Vector3 camForward, Vector3 camUp,
 										   string sceneJSONPath)
+		{
+			return GenerateImageRegion(outTex, 0, 0, outTex.width, outTex.height,
+									   samplesPerPixel, maxBounces, nThreads,
+									   vertFOVDegrees, aperture, focusDist,
+									   camPos, camForward, camUp, sceneJSONPath);
+		}
+		/// <summary>
+		/// Re-renders only the given rectangle of "outTex", leaving the rest of it alone.
+		/// The camera still covers the whole texture, so the rectangle lines up with the rest of the image.
+		/// Returns an error message, or an empty string if everything went fine.
+		/// </summary>
+		public static string GenerateImageRegion(Texture2D outTex, int minX, int minY, int width, int height,
+												 uint samplesPerPixel, uint maxBounces, uint nThreads,
+												 float vertFOVDegrees, float aperture, float focusDist,
+												 Vector3 camPos, Vector3 camForward, Vector3 camUp,
+												 string sceneJSONPath)
 		{
 			uint imgWidth = (uint)outTex.width,
 				 imgHeight = (uint)outTex.height;
+			if (minX < 0 || minY < 0 || width <= 0 || height <= 0 ||
+				minX + width > outTex.width || minY + height > outTex.height)
+			{
+				return "The region doesn't fit inside the texture";
+			}
+
+			//RT's X axis is flipped relative to Unity's.
+			bool isWholeImage = (width == outTex.width && height == outTex.height);
+			if (isWholeImage)
+				rt_SetCropWindow(0, 0, 0, 0);
+			else
+				rt_SetCropWindow((uint)(outTex.width - (minX + width)), (uint)minY, (uint)width, (uint)height);
 
 			//Error-checking.
+			string errMsg = GetError(imgWidth, imgHeight, samplesPerPixel, maxBounces, nThreads,
+									 vertFOVDegrees, aperture, focusDist,
+									 camPos, camForward, camUp, sceneJSONPath);
+			if (errMsg != "")
+			{
+				rt_SetCropWindow(0, 0, 0, 0);
+				return errMsg;
+			}
+
+			//Do the ray-tracing and copy the resulting texture data into a managed .NET array.
+			IntPtr arrayPtr = rt_GenerateImage(imgWidth, imgHeight, samplesPerPixel,
+											   maxBounces, nThreads,
+											   vertFOVDegrees, aperture, focusDist,
+											   camPos.x, camPos.y, camPos.z,
+											   camForward.x, camForward.y, camForward.z,
+											   camUp.x, camUp.y, camUp.z,
+											   sceneJSONPath);
+			rt_SetCropWindow(0, 0, 0, 0);
+			float[] floatArr = new float[width * height * 3];
+			Marshal.Copy(arrayPtr, floatArr, 0, floatArr.Length);
+			rt_ReleaseImage(arrayPtr);
+
+			//Output the colors into the texture.
+			outTex.SetPixels(minX, minY, width, height, ToColors(floatArr, width, height));
+			outTex.Apply(true, false);
+
+			return "";
+		}
+		/// <summary>
+		/// Quickly renders a preview of the image with one sample per pixel, for interactive camera moves.
+		/// The image is traced from coarse to fine: first one pixel in every 8x8 block, then 4x4, 2x2,
+		///     and finally every pixel, reusing the pixels traced by earlier passes.
+		/// After each pass, "outTex" is updated with every block filled in by its traced pixel,
+		///     then "onPass" is called with the size of the blocks, so the texture can be shown right away.
+		/// Returns an error message, or an empty string if everything went fine.
+		/// </summary>
+		public static string GeneratePreviewImage(Texture2D outTex, uint maxBounces, uint nThreads,
+												  float vertFOVDegrees, float aperture, float focusDist,
+												  Vector3 camPos, Vector3 camForward, Vector3 camUp,
+												  string sceneJSONPath, Action<int> onPass)
+		{
+			uint imgWidth = (uint)outTex.width,
+				 imgHeight = (uint)outTex.height;
+
+			//Error-checking.
+			string errMsg = GetError(imgWidth, imgHeight, 1, maxBounces, nThreads,
+									 vertFOVDegrees, aperture, focusDist,
+									 camPos, camForward, camUp, sceneJSONPath);
+			if (errMsg != "")
+				return errMsg;
+
+			float[] floatArr = new float[imgWidth * imgHeight * 3];
+			PreviewPassCallback callback = (IntPtr arrayPtr, uint blockSize) =>
+			{
+				Marshal.Copy(arrayPtr, floatArr, 0, floatArr.Length);
+				outTex.SetPixels(ToColors(floatArr, outTex.width, outTex.height));
+				outTex.Apply(true, false);
+				onPass((int)blockSize);
+			};
+			rt_GeneratePreviewImage(imgWidth, imgHeight, maxBounces, nThreads,
+									vertFOVDegrees, aperture, focusDist,
+									camPos.x, camPos.y, camPos.z,
+									camForward.x, camForward.y, camForward.z,
+									camUp.x, camUp.y, camUp.z,
+									sceneJSONPath, callback);
+			//The delegate mustn't be garbage-collected while RT is still using it.
+			GC.KeepAlive(callback);
+
+			return "";
+		}
+
+		/// <summary>
+		/// Returns an error message for the given render settings, or an empty string if they're fine.
+		/// </summary>
+		private static string GetError(uint imgWidth, uint imgHeight, uint samplesPerPixel,
+									   uint maxBounces, uint nThreads,
+									   float vertFOVDegrees, float aperture, float focusDist,
+									   Vector3 camPos, Vector3 camForward, Vector3 camUp,
+									   string sceneJSONPath)
+		{
 			byte err = rt_GetError(imgWidth, imgHeight, samplesPerPixel, maxBounces, nThreads,
 								   vertFOVDegrees, aperture, focusDist,
 								   camPos.x, camPos.y, camPos.z,
@@ -39,35 +147,69 @@ public static class C_API
 				return "Make sure samplesPerPixel and nThreads are greater than 0, and vertFOVDegrees is positive";
 			else if (err != rt_ERRORCODE_SUCCESS())
 				return "Unknown error " + err;
-
-			//Do the ray-tracing and copy the resulting texture data into a managed .NET array.
-			IntPtr arrayPtr = rt_GenerateImage(imgWidth, imgHeight, samplesPerPixel,
-											   maxBounces, nThreads,
-											   vertFOVDegrees, aperture, focusDist,
-											   camPos.x, camPos.y, camPos.z,
-											   camForward.x, camForward.y, camForward.z,
-											   camUp.x, camUp.y, camUp.z,
-											   sceneJSONPath);
-			float[] floatArr = new float[imgWidth * imgHeight * 3];
-			Marshal.Copy(arrayPtr, floatArr, 0, floatArr.Length);
-			rt_ReleaseImage(arrayPtr);
-
-			//Convert the data to a color array.
-			Color[] cols = new Color[imgWidth * imgHeight];
-			for (uint y = 0; y < imgHeight; ++y)
-				for (uint x = 0; x < imgWidth; ++x)
+			return "";
+		}
+		/// <summary>
+		/// Converts image data from RT into Unity colors.
+		/// </summary>
+		private static Color[] ToColors(float[] floatArr, int width, int height)
+		{
+			Color[] cols = new Color[width * height];
+			for (int y = 0; y < height; ++y)
+				for (int x = 0; x < width; ++x)
 				{
 					//Flip the X value.
-					uint flippedX = imgWidth - x - 1;
-					uint i = (flippedX * 3) + (y * imgWidth * 3);
-					cols[x + (y * imgWidth)] = new Color(floatArr[i], floatArr[i + 1], floatArr[i + 2], 1.0f);
+					int flippedX = width - x - 1;
+					int i = (flippedX * 3) + (y * width * 3);
+					cols[x + (y * width)] = new Color(floatArr[i], floatArr[i + 1], floatArr[i + 2], 1.0f);
 				}
+			return cols;
+		}
 
-			//Output the color array into the texture.
-			outTex.SetPixels(cols);
-			outTex.Apply(true, false);
+		/// <summary>
+		/// Sets the folder that RT caches built BVHs in,
+		///     so that unchanged geometry doesn't need to be processed again next time.
+		/// The folder must already exist. Pass null or "" to disable the cache.
+		/// </summary>
+		public static void SetBVHCacheFolder(string folderPath)
+		{
+			rt_SetBVHCacheFolder(folderPath);
+		}
 
-			return "";
+		/// <summary>
+		/// Sets whether meshes build their BVHs with spatial splits, unless a mesh picks for itself.
+		/// Spatial splits make meshes with long, thin triangles much faster to trace, but take longer to build.
+		/// "budget" is how many extra triangle references may be made, as a fraction of each mesh's triangle count.
+		/// </summary>
+		public static void SetSpatialSplits(bool enabled, float budget = 0.5f)
+		{
+			rt_SetSpatialSplits(enabled ? 1 : 0, budget);
+		}
+
+		public enum Samplers
+		{
+			Random = 0,
+			Sobol = 1,
+			BlueNoiseSobol = 2,
+		}
+		/// <summary>
+		/// Sets how the random numbers for each pixel's samples are picked.
+		/// Sobol is the default; BlueNoiseSobol gives finer-grained noise at low sample counts.
+		/// </summary>
+		public static void SetSampler(Samplers sampler)
+		{
+			rt_SetSampler((int)sampler);
+		}
+
+		/// <summary>
+		/// Makes GenerateImage() spend more samples on the pixels that need them.
+		/// Every pixel starts with "samplesPerPixel" samples, then keeps getting more until its estimated error
+		///     (relative to its brightness, e.x. 0.01 for 1%) is below "targetError", or it has "maxSamplesPerPixel" samples.
+		/// Pass 0 for "targetError" to disable adaptive sampling.
+		/// </summary>
+		public static void SetAdaptiveSampling(float targetError, uint maxSamplesPerPixel)
+		{
+			rt_SetAdaptiveSampling(targetError, maxSamplesPerPixel);
 		}
 
 		
@@ -97,7 +239,27 @@ public static class C_API
 													  float camForwardX, float camForwardY, float camForwardZ,
 													  float camUpX, float camUpY, float camUpZ,
 													  string sceneJSONPath);
+		[UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+		private delegate void PreviewPassCallback(IntPtr img, uint blockSize);
+		[DllImport("RT")]
+		private static extern void rt_GeneratePreviewImage(uint imgWidth, uint imgHeight,
+														   uint maxBounces, uint nThreads,
+														   float vertFOVDegrees, float aperture, float focusDist,
+														   float camPosX, float camPosY, float camPosZ,
+														   float camForwardX, float camForwardY, float camForwardZ,
+														   float camUpX, float camUpY, float camUpZ,
+														   string sceneJSONPath, PreviewPassCallback onPass);
 		[DllImport("RT")]
 		private static extern void rt_ReleaseImage(IntPtr img);
+		[DllImport("RT")]
+		private static extern void rt_SetBVHCacheFolder(string folderPath);
+		[DllImport("RT")]
+		private static extern void rt_SetSpatialSplits(int enabled, float budget);
+		[DllImport("RT")]
+		private static extern void rt_SetSampler(int samplerType);
+		[DllImport("RT")]
+		private static extern void rt_SetAdaptiveSampling(float targetError, uint maxSamplesPerPixel);
+		[DllImport("RT")]
+		private static extern void rt_SetCropWindow(uint minX, uint minY, uint width, uint height);
 	}
 }
\ No newline at end of file
@@ -50,17 +50,16 @@ public override void WriteData(Serialization.DataWriter writer)
 				tangents[i] = (Vector3)_tangents[i];
 				bitangents[i] = _tangents[i].w * Vector3.Cross(normals[i], tangents[i]);
 			}
-			List<Vertex> verts = new List<Vertex>(indices.Length);
+			//Write the vertices as a flat block of floats: pos, normal, tangent, bitangent, then UV.
+			float[] vertData = new float[indices.Length * NFloatsPerVertex];
 			for (int i = 0; i < indices.Length; ++i)
 			{
 				int vertI = indices[i];
-				verts.Add(new Vertex(poses[vertI], normals[vertI],
-									 tangents[vertI], bitangents[vertI],
-									 uvs[vertI]));
+				new Vertex(poses[vertI], normals[vertI],
+						   tangents[vertI], bitangents[vertI],
+						   uvs[vertI]).ToFloats(vertData, i * NFloatsPerVertex);
 			}
-
-			//Write out the vertices.
-			writer.List(verts, "Vertices", (wr, vert, name) => wr.Structure(vert, name));
+			writer.Floats(vertData, "VertexData");
 		}
 		public override void ReadData(Serialization.DataReader reader)
 		{
@@ -81,12 +80,31 @@ public override void ReadData(Serialization.DataReader reader)
 			{
 				Debug.LogError("Mesh doesn't have a valid GUID, so a new mesh file will be generated with the data");
 
-				List<Vertex> verts = reader.List("Vertices",
-					(Serialization.DataReader rd, ref Vertex vert, string name) =>
+				List<Vertex> verts;
+				if (reader.HasElement("VertexData"))
+				{
+					float[] vertData = reader.Floats("VertexData");
+					if (vertData.Length % NFloatsPerVertex != 0)
 					{
-						vert = new Vertex();
-						rd.Structure(vert, name);
-					});
+						throw new Serialization.DataReader.ReadException(
+							"Mesh vertex data should have " + NFloatsPerVertex +
+							" floats per vertex, but it had " + vertData.Length + " floats");
+					}
+
+					verts = new List<Vertex>(vertData.Length / NFloatsPerVertex);
+					for (int i = 0; i < vertData.Length; i += NFloatsPerVertex)
+						verts.Add(Vertex.FromFloats(vertData, i));
+				}
+				else
+				{
+					//Older files store each vertex as its own data structure.
+					verts = reader.List("Vertices",
+						(Serialization.DataReader rd, ref Vertex vert, string name) =>
+						{
+							vert = new Vertex();
+							rd.Structure(vert, name);
+						});
+				}
 
 				//Convert the vertices to actual mesh data.
 				Vector3[] poses = new Vector3[verts.Count],
@@ -144,6 +162,7 @@ public override void ReadData(Serialization.DataReader reader)
 			}
 		}
 		#region Helper struct for serialization
+		private const int NFloatsPerVertex = 14;
 		//TODO: Actually store vertex as a struct and make one class that is reused for every vertex.
 		private class Vertex : Serialization.ISerializableRT
 		{
@@ -152,6 +171,22 @@ private class Vertex : Serialization.ISerializableRT
 			public Vertex() { }
 			public Vertex(Vector3 pos, Vector3 norm, Vector3 tangent, Vector3 bitangent, Vector2 uv)
 				{ Pos = pos; Normal = norm; Tangent = tangent; Bitangent = bitangent; UV = uv; }
+			public void ToFloats(float[] outData, int startI)
+			{
+				outData[startI] = Pos.x; outData[startI + 1] = Pos.y; outData[startI + 2] = Pos.z;
+				outData[startI + 3] = Normal.x; outData[startI + 4] = Normal.y; outData[startI + 5] = Normal.z;
+				outData[startI + 6] = Tangent.x; outData[startI + 7] = Tangent.y; outData[startI + 8] = Tangent.z;
+				outData[startI + 9] = Bitangent.x; outData[startI + 10] = Bitangent.y; outData[startI + 11] = Bitangent.z;
+				outData[startI + 12] = UV.x; outData[startI + 13] = UV.y;
+			}
+			public static Vertex FromFloats(float[] data, int startI)
+			{
+				return new Vertex(new Vector3(data[startI], data[startI + 1], data[startI + 2]),
+								  new Vector3(data[startI + 3], data[startI + 4], data[startI + 5]),
+								  new Vector3(data[startI + 6], data[startI + 7], data[startI + 8]),
+								  new Vector3(data[startI + 9], data[startI + 10], data[startI + 11]),
+								  new Vector2(data[startI + 12], data[startI + 13]));
+			}
 			public void WriteData(Serialization.DataWriter writer)
 			{
 				writer.Vec3f(Pos, "Pos");
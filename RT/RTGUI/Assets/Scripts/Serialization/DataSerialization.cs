@@ -35,6 +35,13 @@ public class WriteException : Exception { public WriteException(string msg) : ba
 		public abstract void Structure(ISerializableRT value, string name);
 		
 
+		//Writes a large block of floats (e.x. mesh vertex data) as raw bytes.
+		public virtual void Floats(float[] values, string name)
+		{
+			byte[] bytes = new byte[values.Length * sizeof(float)];
+			System.Buffer.BlockCopy(values, 0, bytes, 0, bytes.Length);
+			Bytes(bytes, name);
+		}
 		public virtual void Vec2f(UnityEngine.Vector2 v, string name)
 		{
 			FloatSerializerWrapper floats = new FloatSerializerWrapper();
@@ -95,7 +102,10 @@ public class ReadException : Exception { public ReadException(string msg) : base
 
 		public string ErrorMessage = "";
 
-		
+
+		//Gets whether an element with the given name exists at the current level of the data.
+		public abstract bool HasElement(string name);
+
 		public abstract bool Bool(string name);
 		public abstract byte Byte(string name);
 		public abstract int Int(string name);
@@ -109,6 +119,19 @@ public class ReadException : Exception { public ReadException(string msg) : base
 		public abstract void Structure(ISerializableRT outValue, string name);
 		
 
+		//Reads a block of floats that was written with "DataWriter.Floats()".
+		public virtual float[] Floats(string name)
+		{
+			byte[] bytes = Bytes(name);
+			if (bytes == null)
+				throw new ReadException("Couldn't find float data \"" + name + "\"");
+			if (bytes.Length % sizeof(float) != 0)
+				throw new ReadException("Float data \"" + name + "\" has an invalid byte count: " + bytes.Length);
+
+			float[] values = new float[bytes.Length / sizeof(float)];
+			System.Buffer.BlockCopy(bytes, 0, values, 0, bytes.Length);
+			return values;
+		}
 		public virtual UnityEngine.Vector2 Vec2f(string name)
 		{
 			FloatSerializerWrapper floats = new FloatSerializerWrapper();
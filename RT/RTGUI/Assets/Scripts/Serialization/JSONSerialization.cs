@@ -138,6 +138,10 @@ public JSONReader(System.IO.TextReader jsonStream)
 		}
 		private JSONReader(Newtonsoft.Json.Linq.JObject _root) { root = _root; }
 
+		public override bool HasElement(string name)
+		{
+			return root.Property(name) != null;
+		}
 		public override bool Bool(string name)
 		{
 			return root.Value<bool>(name);